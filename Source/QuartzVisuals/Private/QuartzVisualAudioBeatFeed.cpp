@@ -0,0 +1,197 @@
+// Copyright Zuko Media 2023 all rights reserved.
+
+#include "QuartzVisualAudioBeatFeed.h"
+
+void FQuartzVisualAudioBeatFeed::SetStepsPerSecond(float InStepsPerSecond)
+{
+	const double NewStepsPerSecond = static_cast<double>(InStepsPerSecond);
+	if(StepsPerSecond == NewStepsPerSecond)
+	{
+		return;
+	}
+	StepsPerSecond = NewStepsPerSecond;
+	NumLateness = 0;
+
+	FCommand Command;
+	Command.Type = ECommand::SetRate;
+	Command.Value = NewStepsPerSecond;
+	SendCommand(Command);
+}
+
+void FQuartzVisualAudioBeatFeed::Anchor(int32 Step)
+{
+	Generation++;
+	NumLateness = 0;
+
+	FCommand Command;
+	Command.Type = ECommand::Anchor;
+	Command.Step = Step;
+	Command.Generation = Generation;
+	SendCommand(Command);
+}
+
+void FQuartzVisualAudioBeatFeed::Correct(int32 Step, float MaxDriftSteps)
+{
+	// Only compared once the grid has applied everything sent, an earlier shift would otherwise be counted twice.
+	const FGridSnapshot Snapshot = ReadSnapshot();
+	if(Generation == 0 || Snapshot.NumCommands != NumCommandsSent || Snapshot.RenderedClock < 0.0 || Snapshot.StepsPerSecond <= 0.0)
+	{
+		return;
+	}
+
+	// How far past Step the grid had rendered when the event arrived. Quartz had rendered Step by then, so anything below 0 is the grid being late.
+	const float StepLateness = static_cast<float>((Snapshot.RenderedClock - Snapshot.StepZeroClock) * Snapshot.StepsPerSecond - static_cast<double>(Step));
+	Lateness[NumLateness % NumLatenessSamples] = StepLateness;
+	NumLateness++;
+
+	float Drift = StepLateness;
+	if(StepLateness >= -MaxDriftSteps)
+	{
+		// Early grids only show in the delay never dropping, which takes a few events to tell from a slow frame.
+		if(NumLateness < NumLatenessSamples)
+		{
+			return;
+		}
+		for(int32 Index = 0; Index < NumLatenessSamples; Index++)
+		{
+			Drift = FMath::Min(Drift, Lateness[Index]);
+		}
+		if(Drift <= MaxDriftSteps)
+		{
+			return;
+		}
+	}
+
+	FCommand Command;
+	Command.Type = ECommand::Shift;
+	Command.Value = static_cast<double>(Drift);
+	SendCommand(Command);
+	for(int32 Index = 0; Index < FMath::Min(NumLateness, NumLatenessSamples); Index++)
+	{
+		Lateness[Index] -= Drift;
+	}
+}
+
+void FQuartzVisualAudioBeatFeed::SendCommand(const FCommand& Command)
+{
+	// Only fills up when no buffers are rendered, as for a replayed feed, and nothing would apply the commands then anyway.
+	if(Commands.Enqueue(Command))
+	{
+		NumCommandsSent++;
+	}
+}
+
+FQuartzVisualAudioBeatFeed::FGridSnapshot FQuartzVisualAudioBeatFeed::ReadSnapshot() const
+{
+	FGridSnapshot Snapshot;
+	uint32 Sequence = 0;
+	do
+	{
+		Sequence = SnapshotSequence.load(std::memory_order_acquire);
+		Snapshot.RenderedClock = SnapshotRenderedClock.load(std::memory_order_relaxed);
+		Snapshot.StepZeroClock = SnapshotStepZeroClock.load(std::memory_order_relaxed);
+		Snapshot.StepsPerSecond = SnapshotStepsPerSecond.load(std::memory_order_relaxed);
+		Snapshot.NumCommands = SnapshotNumCommands.load(std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_acquire);
+	}
+	// Written a few stores at a time once per buffer, a torn read is retried straight away.
+	while((Sequence & 1) != 0 || Sequence != SnapshotSequence.load(std::memory_order_relaxed));
+	return Snapshot;
+}
+
+bool FQuartzVisualAudioBeatFeed::DequeueDue(double NowSeconds, FQuartzVisualAudioBeat& OutBeat)
+{
+	FQuartzVisualAudioBeat Beat;
+	while(Beats.Peek(Beat))
+	{
+		if(Beat.Generation != Generation)
+		{
+			Beats.Dequeue();
+			continue;
+		}
+		// Audio is rendered ahead, boundaries wait here until their time comes.
+		return Beat.PlatformSeconds <= NowSeconds && Beats.Dequeue(OutBeat);
+	}
+	return false;
+}
+
+void FQuartzVisualAudioBeatFeed::OnNewSubmixBuffer(const USoundSubmix* OwningSubmix, float* AudioData, int32 NumSamples, int32 NumChannels, const int32 SampleRate, double AudioClock)
+{
+	// Callbacks only ever run late, the earliest one seen maps the render clock closest to platform time.
+	PlatformOffset = FMath::Min(PlatformOffset + PlatformOffsetRelaxSeconds, FPlatformTime::Seconds() - AudioClock);
+	const double BufferSeconds = NumChannels > 0 && SampleRate > 0 ? static_cast<double>(NumSamples / NumChannels) / static_cast<double>(SampleRate) : 0.0;
+
+	// Everything the game thread sent takes effect at the start of this buffer.
+	FCommand Command;
+	while(Commands.Dequeue(Command))
+	{
+		ApplyCommand(Command, AudioClock);
+	}
+	if(Grid.bPlacePending && Grid.StepsPerSecond > 0.0)
+	{
+		// The anchoring event's boundary is already stepped, the grid continues from it.
+		Grid.StepZeroClock = AudioClock - static_cast<double>(Grid.AnchorStep) / Grid.StepsPerSecond;
+		Grid.bPlacePending = false;
+	}
+
+	if(Grid.Generation != 0 && Grid.bPlacePending == false && Grid.StepsPerSecond > 0.0)
+	{
+		// Steps a correction moved the grid past are sent late rather than skipped, those it moved back over aren't sent twice.
+		const double EndPosition = (AudioClock + BufferSeconds - Grid.StepZeroClock) * Grid.StepsPerSecond;
+		for(int32 Step = LastEmittedStep + 1; static_cast<double>(Step) <= EndPosition; Step++)
+		{
+			FQuartzVisualAudioBeat Beat;
+			Beat.Step = Step;
+			Beat.Generation = Grid.Generation;
+			Beat.PlatformSeconds = Grid.StepZeroClock + static_cast<double>(Step) / Grid.StepsPerSecond + PlatformOffset;
+			if(Beats.Enqueue(Beat) == false)
+			{
+				NumDropped.fetch_add(1, std::memory_order_relaxed);
+			}
+			LastEmittedStep = Step;
+		}
+	}
+
+	PublishSnapshot(AudioClock + BufferSeconds);
+}
+
+void FQuartzVisualAudioBeatFeed::ApplyCommand(const FCommand& Command, double AudioClock)
+{
+	switch(Command.Type)
+	{
+	case ECommand::SetRate:
+		if(Grid.Generation != 0 && Grid.bPlacePending == false && Grid.StepsPerSecond > 0.0 && Command.Value > 0.0)
+		{
+			// Keeps the position at the start of the buffer, later steps come at the new rate.
+			const double Position = (AudioClock - Grid.StepZeroClock) * Grid.StepsPerSecond;
+			Grid.StepZeroClock = AudioClock - Position / Command.Value;
+		}
+		Grid.StepsPerSecond = Command.Value;
+		break;
+	case ECommand::Anchor:
+		Grid.AnchorStep = Command.Step;
+		Grid.Generation = Command.Generation;
+		Grid.bPlacePending = true;
+		LastEmittedStep = Command.Step;
+		break;
+	case ECommand::Shift:
+		if(Grid.StepsPerSecond > 0.0)
+		{
+			Grid.StepZeroClock += Command.Value / Grid.StepsPerSecond;
+		}
+		break;
+	}
+	NumCommandsApplied++;
+}
+
+void FQuartzVisualAudioBeatFeed::PublishSnapshot(double RenderedClock)
+{
+	const uint32 Sequence = SnapshotSequence.load(std::memory_order_relaxed);
+	SnapshotSequence.store(Sequence + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	SnapshotRenderedClock.store(RenderedClock, std::memory_order_relaxed);
+	SnapshotStepZeroClock.store(Grid.StepZeroClock, std::memory_order_relaxed);
+	SnapshotStepsPerSecond.store(Grid.bPlacePending ? 0.0 : Grid.StepsPerSecond, std::memory_order_relaxed);
+	SnapshotNumCommands.store(NumCommandsApplied, std::memory_order_relaxed);
+	SnapshotSequence.store(Sequence + 2, std::memory_order_release);
+}
@@ -0,0 +1,40 @@
+// Copyright Zuko Media 2023 all rights reserved.
+
+#include "QuartzVisualBeatPhase.h"
+
+void FQuartzVisualBeatPhaseEstimator::OnStep(int32 Step, float InStepsPerSecond, float AgeSeconds)
+{
+	StepsPerSecond = FMath::Max(InStepsPerSecond, 0.0f);
+	// Where the clock is now. Ages past a step are missed steps and snap below.
+	const double Target = static_cast<double>(Step) + FMath::Clamp(static_cast<double>(AgeSeconds * StepsPerSecond), 0.0, 0.99);
+	const double Error = Target - Position;
+	if(LastStep == INDEX_NONE || FMath::Abs(Error) >= 1.0)
+	{
+		// First event or a missed step (hitch, tempo jump), nothing to smooth towards.
+		Position = Target;
+		RateCorrection = 0.0f;
+	}
+	else
+	{
+		// Catch up or fall back over the next step. Ahead happens when the event came late and the estimate ran on without it.
+		RateCorrection = FMath::Clamp(static_cast<float>(Error), -0.5f, 0.5f);
+	}
+	LastStep = Step;
+}
+
+void FQuartzVisualBeatPhaseEstimator::Advance(float DeltaSeconds, int32 MaxStepsAhead)
+{
+	if(LastStep != INDEX_NONE)
+	{
+		// Predicts on through a late event, holds once it's later than the slack and a step was likely missed.
+		Position = FMath::Min(Position + static_cast<double>(DeltaSeconds * StepsPerSecond * (1.0f + RateCorrection)), static_cast<double>(LastStep + MaxStepsAhead + LateStepSlack));
+	}
+}
+
+void FQuartzVisualBeatPhaseEstimator::Reset()
+{
+	Position = 0.0;
+	StepsPerSecond = 0.0f;
+	RateCorrection = 0.0f;
+	LastStep = INDEX_NONE;
+}
@@ -0,0 +1,162 @@
+// Copyright Zuko Media 2023 all rights reserved.
+
+#include "QuartzVisualCurveCache.h"
+#include "Curves/CurveFloat.h"
+#include "QuartzVisualSubsystem.h"
+
+int32 GQuartzVisualsCurveTableResolution = 256;
+static FAutoConsoleVariableRef CVarQuartzVisualsCurveTableResolution(
+	TEXT("QuartzVisuals.CurveTableResolution"),
+	GQuartzVisualsCurveTableResolution,
+	TEXT("Number of samples baked for each value curve over the 0 - 1 pulse progress. Changing it rebakes every curve"),
+	ECVF_Default);
+
+void FQuartzVisualCurveTable::Bake(const UCurveFloat* Curve, int32 Resolution)
+{
+	Resolution = FMath::Max(Resolution, 2);
+	Samples.SetNumUninitialized(Resolution);
+	const float Step = 1.0f / static_cast<float>(Resolution - 1);
+	for(int32 SampleIndex = 0; SampleIndex < Resolution; SampleIndex++)
+	{
+		Samples[SampleIndex] = Curve ? Curve->GetFloatValue(static_cast<float>(SampleIndex) * Step) : 0.0f;
+	}
+}
+
+float FQuartzVisualCurveTable::MeasureMaxError(const UCurveFloat* Curve) const
+{
+	float MaxError = 0.0f;
+	if(Curve)
+	{
+		const float Step = 1.0f / static_cast<float>(Samples.Num() - 1);
+		for(int32 SampleIndex = 0; SampleIndex < Samples.Num() - 1; SampleIndex++)
+		{
+			const float Time = (static_cast<float>(SampleIndex) + 0.5f) * Step;
+			MaxError = FMath::Max(MaxError, FMath::Abs(Evaluate(Time) - Curve->GetFloatValue(Time)));
+		}
+	}
+	return MaxError;
+}
+
+FQuartzVisualCurveCache::~FQuartzVisualCurveCache()
+{
+	Reset();
+}
+
+int32 FQuartzVisualCurveCache::FindOrBake(const UCurveFloat* Curve)
+{
+	if(Curve == nullptr)
+	{
+		return INDEX_NONE;
+	}
+
+	const TObjectKey<UCurveFloat> CurveKey(Curve);
+	if(const int32* TableIndex = TableLookup.Find(CurveKey))
+	{
+		return *TableIndex;
+	}
+
+	if(BakedResolution == 0)
+	{
+		BakedResolution = GQuartzVisualsCurveTableResolution;
+	}
+
+	const int32 TableIndex = FreeTables.Num() > 0 ? FreeTables.Pop(false) : Tables.AddDefaulted();
+	if(TableIndex == TableCurves.Num())
+	{
+		TableCurves.AddDefaulted();
+#if WITH_EDITOR
+		CurveUpdatedHandles.AddDefaulted();
+#endif
+	}
+	TableCurves[TableIndex] = CurveKey;
+	TableLookup.Add(CurveKey, TableIndex);
+#if WITH_EDITOR
+	// Bound on a const curve, only used to know when to rebake.
+	CurveUpdatedHandles[TableIndex] = const_cast<UCurveFloat*>(Curve)->OnUpdateCurve.AddRaw(this, &FQuartzVisualCurveCache::OnCurveUpdated);
+#endif
+	Rebake(TableIndex);
+	return TableIndex;
+}
+
+void FQuartzVisualCurveCache::Refresh()
+{
+	if(BakedResolution != 0 && BakedResolution != GQuartzVisualsCurveTableResolution)
+	{
+		BakedResolution = GQuartzVisualsCurveTableResolution;
+		for(int32 TableIndex = 0; TableIndex < Tables.Num(); TableIndex++)
+		{
+			if(TableCurves[TableIndex] != TObjectKey<UCurveFloat>())
+			{
+				Rebake(TableIndex);
+			}
+		}
+	}
+}
+
+void FQuartzVisualCurveCache::Prune(const TBitArray<>& UsedTables)
+{
+	for(int32 TableIndex = 0; TableIndex < Tables.Num(); TableIndex++)
+	{
+		if(TableCurves[TableIndex] != TObjectKey<UCurveFloat>() && (UsedTables.IsValidIndex(TableIndex) == false || UsedTables[TableIndex] == false))
+		{
+			Release(TableIndex);
+		}
+	}
+}
+
+void FQuartzVisualCurveCache::Release(int32 TableIndex)
+{
+#if WITH_EDITOR
+	if(UCurveFloat* Curve = TableCurves[TableIndex].ResolveObjectPtr())
+	{
+		Curve->OnUpdateCurve.Remove(CurveUpdatedHandles[TableIndex]);
+	}
+	CurveUpdatedHandles[TableIndex].Reset();
+#endif
+	// The curve may be gone already, the key still finds its lookup entry.
+	TableLookup.Remove(TableCurves[TableIndex]);
+	TableCurves[TableIndex] = TObjectKey<UCurveFloat>();
+	Tables[TableIndex].Samples.Empty();
+	FreeTables.Add(TableIndex);
+}
+
+void FQuartzVisualCurveCache::Reset()
+{
+#if WITH_EDITOR
+	for(int32 TableIndex = 0; TableIndex < TableCurves.Num(); TableIndex++)
+	{
+		if(UCurveFloat* Curve = TableCurves[TableIndex].ResolveObjectPtr())
+		{
+			Curve->OnUpdateCurve.Remove(CurveUpdatedHandles[TableIndex]);
+		}
+	}
+	CurveUpdatedHandles.Reset();
+#endif
+	Tables.Reset();
+	TableCurves.Reset();
+	TableLookup.Reset();
+	FreeTables.Reset();
+	BakedResolution = 0;
+}
+
+void FQuartzVisualCurveCache::Rebake(int32 TableIndex)
+{
+	const UCurveFloat* Curve = TableCurves[TableIndex].ResolveObjectPtr();
+	FQuartzVisualCurveTable& Table = Tables[TableIndex];
+	Table.Bake(Curve, BakedResolution);
+
+	if(GQuartzVisualsEnableLogs)
+	{
+		UE_LOG(LogQuartzVisuals, Log, TEXT("Baked curve %s with %d samples, max error %f"), *GetNameSafe(Curve), Table.Samples.Num(), Table.MeasureMaxError(Curve));
+	}
+}
+
+#if WITH_EDITOR
+void FQuartzVisualCurveCache::OnCurveUpdated(UCurveBase* Curve, EPropertyChangeType::Type ChangeType)
+{
+	if(const int32* TableIndex = TableLookup.Find(TObjectKey<UCurveFloat>(Cast<UCurveFloat>(Curve))))
+	{
+		Rebake(*TableIndex);
+	}
+}
+#endif
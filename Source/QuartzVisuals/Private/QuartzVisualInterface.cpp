@@ -4,4 +4,13 @@
 
 void IQuartzVisualsInterface::OnQuartzVisualUpdate_Implementation(const FQuartzVisualPulseEntry& PulseData)
 {
+}
+
+bool IQuartzVisualsInterface::WantsBatchedQuartzVisualUpdates_Implementation() const
+{
+	return false;
+}
+
+void IQuartzVisualsInterface::OnQuartzVisualUpdateBatch_Implementation(const TArray<FQuartzVisualPulseUpdate>& PulseUpdates)
+{
 }
\ No newline at end of file
@@ -0,0 +1,285 @@
+// Copyright Zuko Media 2023 all rights reserved.
+
+#include "QuartzVisualMidiImporter.h"
+#include "QuartzVisualSubsystem.h"
+#include "Algo/StableSort.h"
+#include "HAL/PlatformFileManager.h"
+#include "Misc/FileHelper.h"
+
+namespace QuartzVisualMidiImporterPrivate
+{
+	constexpr uint32 HeaderChunkId = 0x4D546864; // MThd
+	constexpr uint32 TrackChunkId = 0x4D54726B; // MTrk
+
+	// Big endian reads. Reading past the end sets bError and returns zeros.
+	struct FMidiReader
+	{
+		const uint8* Data = nullptr;
+		int64 Size = 0;
+		int64 Position = 0;
+		bool bError = false;
+
+		bool CanRead(const int64 Num)
+		{
+			bError |= Position + Num > Size;
+			return bError == false;
+		}
+
+		uint8 ReadByte()
+		{
+			return CanRead(1) ? Data[Position++] : 0;
+		}
+
+		uint8 PeekByte() const
+		{
+			return Position < Size ? Data[Position] : 0;
+		}
+
+		uint16 ReadUInt16()
+		{
+			uint16 Value = static_cast<uint16>(ReadByte()) << 8;
+			Value |= ReadByte();
+			return Value;
+		}
+
+		uint32 ReadUInt32()
+		{
+			uint32 Value = static_cast<uint32>(ReadUInt16()) << 16;
+			Value |= ReadUInt16();
+			return Value;
+		}
+
+		// Variable length quantity, four bytes at most.
+		uint32 ReadVarLen()
+		{
+			uint32 Value = 0;
+			for(int32 ByteIndex = 0; ByteIndex < 4; ByteIndex++)
+			{
+				const uint8 Byte = ReadByte();
+				Value = (Value << 7) | (Byte & 0x7F);
+				if((Byte & 0x80) == 0)
+				{
+					return Value;
+				}
+			}
+			bError = true;
+			return Value;
+		}
+
+		void Skip(const int64 Num)
+		{
+			if(CanRead(Num))
+			{
+				Position += Num;
+			}
+		}
+	};
+
+	struct FOpenNote
+	{
+		uint64 Tick = 0;
+		uint8 Velocity = 0;
+	};
+
+	struct FMidiNote
+	{
+		uint64 StartTick = 0;
+		uint64 EndTick = 0;
+		uint8 Note = 0;
+		uint8 Channel = 0;
+		uint8 Velocity = 0;
+	};
+}
+
+bool QuartzVisualMidiImporter::ConvertMidi(const TArray<uint8>& MidiData, int32 StepsPerBeat, TArray<FQuartzVisualTrackPulse>& OutPulses, FString& OutError)
+{
+	using namespace QuartzVisualMidiImporterPrivate;
+	OutPulses.Reset();
+	if(StepsPerBeat <= 0)
+	{
+		OutError = TEXT("StepsPerBeat has to be at least 1");
+		return false;
+	}
+
+	FMidiReader Reader;
+	Reader.Data = MidiData.GetData();
+	Reader.Size = MidiData.Num();
+
+	const uint32 HeaderId = Reader.ReadUInt32();
+	const uint32 HeaderLength = Reader.ReadUInt32();
+	if(HeaderId != HeaderChunkId || HeaderLength < 6)
+	{
+		OutError = TEXT("Not a standard MIDI file");
+		return false;
+	}
+	const uint16 Format = Reader.ReadUInt16();
+	Reader.ReadUInt16(); // Number of tracks, the chunks are read until the end of the file instead.
+	const uint16 Division = Reader.ReadUInt16();
+	Reader.Skip(HeaderLength - 6);
+	if(Format > 1)
+	{
+		OutError = TEXT("Format 2 MIDI files (independent sequences) are not supported");
+		return false;
+	}
+	if(Division == 0 || (Division & 0x8000) != 0)
+	{
+		OutError = TEXT("SMPTE timing is not supported, export the MIDI file with beat based timing");
+		return false;
+	}
+
+	TArray<FMidiNote> Notes;
+	TMap<uint16, TArray<FOpenNote>> OpenNotes;
+	int32 NumUnclosed = 0;
+	while(Reader.bError == false && Reader.Position + 8 <= Reader.Size)
+	{
+		const uint32 ChunkId = Reader.ReadUInt32();
+		const uint32 ChunkLength = Reader.ReadUInt32();
+		const int64 ChunkEnd = Reader.Position + ChunkLength;
+		if(ChunkEnd > Reader.Size)
+		{
+			Reader.bError = true;
+			break;
+		}
+		if(ChunkId != TrackChunkId)
+		{
+			Reader.Position = ChunkEnd;
+			continue;
+		}
+
+		uint64 Tick = 0;
+		uint8 RunningStatus = 0;
+		OpenNotes.Reset();
+		while(Reader.Position < ChunkEnd && Reader.bError == false)
+		{
+			Tick += Reader.ReadVarLen();
+			uint8 Status = Reader.PeekByte();
+			if((Status & 0x80) != 0)
+			{
+				Reader.Position++;
+			}
+			else if(RunningStatus != 0)
+			{
+				Status = RunningStatus;
+			}
+			else
+			{
+				Reader.bError = true;
+				break;
+			}
+
+			if(Status == 0xFF)
+			{
+				// Meta events, only the end of the track matters.
+				const uint8 MetaType = Reader.ReadByte();
+				Reader.Skip(Reader.ReadVarLen());
+				RunningStatus = 0;
+				if(MetaType == 0x2F)
+				{
+					break;
+				}
+				continue;
+			}
+			if(Status == 0xF0 || Status == 0xF7)
+			{
+				Reader.Skip(Reader.ReadVarLen());
+				RunningStatus = 0;
+				continue;
+			}
+			if(Status > 0xF0)
+			{
+				// System common and real time messages don't belong in a file.
+				Reader.bError = true;
+				break;
+			}
+
+			RunningStatus = Status;
+			const uint8 MessageType = Status & 0xF0;
+			const uint8 Channel = Status & 0x0F;
+			const uint8 Data1 = Reader.ReadByte() & 0x7F;
+			const uint8 Data2 = MessageType == 0xC0 || MessageType == 0xD0 ? 0 : Reader.ReadByte() & 0x7F;
+			const uint16 NoteKey = static_cast<uint16>(Channel) << 7 | Data1;
+			if(MessageType == 0x90 && Data2 > 0)
+			{
+				OpenNotes.FindOrAdd(NoteKey).Add({ Tick, Data2 });
+			}
+			else if(MessageType == 0x80 || MessageType == 0x90)
+			{
+				// Overlapping notes of the same key are closed first in, first out.
+				TArray<FOpenNote>* Open = OpenNotes.Find(NoteKey);
+				if(Open && Open->Num() > 0)
+				{
+					Notes.Add({ (*Open)[0].Tick, Tick, Data1, Channel, (*Open)[0].Velocity });
+					Open->RemoveAt(0, 1, false);
+				}
+			}
+		}
+
+		// Notes that are never released end with their track.
+		for(const TPair<uint16, TArray<FOpenNote>>& Pair : OpenNotes)
+		{
+			for(const FOpenNote& Open : Pair.Value)
+			{
+				Notes.Add({ Open.Tick, Tick, static_cast<uint8>(Pair.Key & 0x7F), static_cast<uint8>(Pair.Key >> 7), Open.Velocity });
+				NumUnclosed++;
+			}
+		}
+		Reader.Position = ChunkEnd;
+	}
+
+	if(Reader.bError)
+	{
+		OutError = FString::Printf(TEXT("MIDI file is truncated or corrupt at byte %lld"), Reader.Position);
+		return false;
+	}
+	if(NumUnclosed > 0)
+	{
+		UE_LOG(LogQuartzVisuals, Warning, TEXT("%d notes have no note off, they last until the end of their track"), NumUnclosed);
+	}
+
+	const double StepsPerTick = static_cast<double>(StepsPerBeat) / static_cast<double>(Division);
+	OutPulses.Reserve(Notes.Num());
+	for(const FMidiNote& Note : Notes)
+	{
+		const int64 StartStep = FMath::RoundToInt64(static_cast<double>(Note.StartTick) * StepsPerTick);
+		const int64 EndStep = FMath::RoundToInt64(static_cast<double>(Note.EndTick) * StepsPerTick);
+		if(EndStep > MAX_int32 / 2)
+		{
+			OutError = TEXT("MIDI file is too long for the step resolution");
+			return false;
+		}
+		FQuartzVisualTrackPulse& Pulse = OutPulses.AddDefaulted_GetRef();
+		Pulse.StartStep = static_cast<int32>(StartStep);
+		Pulse.DurationSteps = FMath::Max(static_cast<int32>(EndStep - StartStep), 1);
+		Pulse.Note = Note.Note;
+		Pulse.Channel = Note.Channel;
+		Pulse.Velocity = Note.Velocity;
+	}
+	// Tracks are appended one after the other, ties keep the order of the file.
+	Algo::StableSortBy(OutPulses, &FQuartzVisualTrackPulse::StartStep);
+	return true;
+}
+
+bool QuartzVisualMidiImporter::ImportMidiFile(const FString& MidiFilePath, const FString& TrackFilePath, int32 StepsPerBeat, FString& OutError)
+{
+	TArray<uint8> MidiData;
+	if(FFileHelper::LoadFileToArray(MidiData, *MidiFilePath) == false)
+	{
+		OutError = FString::Printf(TEXT("Can't read %s"), *MidiFilePath);
+		return false;
+	}
+
+	TArray<FQuartzVisualTrackPulse> Pulses;
+	if(ConvertMidi(MidiData, StepsPerBeat, Pulses, OutError) == false)
+	{
+		return false;
+	}
+
+	FPlatformFileManager::Get().GetPlatformFile().CreateDirectoryTree(*FPaths::GetPath(TrackFilePath));
+	if(FQuartzVisualMappedPulseTrack::Write(TrackFilePath, StepsPerBeat, Pulses) == false)
+	{
+		OutError = FString::Printf(TEXT("Can't write %s"), *TrackFilePath);
+		return false;
+	}
+	UE_LOG(LogQuartzVisuals, Log, TEXT("Imported %d pulses from %s to %s"), Pulses.Num(), *MidiFilePath, *TrackFilePath);
+	return true;
+}
@@ -0,0 +1,126 @@
+// Copyright Zuko Media 2023 all rights reserved.
+
+#include "QuartzVisualPulseKernels.h"
+
+namespace QuartzVisualPulseKernelsPrivate
+{
+	/**
+	 * One instance per value variant. bCurve and bRemap are known at compile time, so each instance only does
+	 * the math its pulses need and none of the per-pulse settings checks of FQuartzVisualPulseEntry::UpdateValue.
+	 */
+	template<bool bCurve, bool bRemap>
+	void EvaluateVariant(
+		const int32* RESTRICT CurrentStep,
+		const int32* RESTRICT StartStep,
+		const int32* RESTRICT BeatDuration,
+		const float* RESTRICT SubStep,
+		const int32* RESTRICT CurveTable,
+		const FQuartzVisualCurveTable* RESTRICT Tables,
+		const float* RESTRICT OutValueMin,
+		const float* RESTRICT OutValueMax,
+		const float* RESTRICT InterpSpeed,
+		const float* CurrentValue,
+		float* RESTRICT OutNormalized,
+		float* OutValue,
+		const float* RESTRICT DeltaSeconds,
+		const int32 Num)
+	{
+		const VectorRegister4Float SmallNumberVec = VectorSetFloat1(UE_SMALL_NUMBER);
+
+		int32 Index = 0;
+		for(; Index + 4 <= Num; Index += 4)
+		{
+			// GetBeatProgress
+			const VectorRegister4Float Duration = VectorIntToFloat(VectorIntLoad(BeatDuration + Index));
+			const VectorRegister4Float Elapsed = VectorAdd(VectorIntToFloat(VectorIntSubtract(VectorIntLoad(CurrentStep + Index), VectorIntLoad(StartStep + Index))), VectorLoad(SubStep + Index));
+			const VectorRegister4Float Clamped = VectorMin(VectorMax(Elapsed, VectorZeroFloat()), Duration);
+			const VectorRegister4Float Progress = VectorDivide(Clamped, Duration);
+			VectorStore(Progress, OutNormalized + Index);
+
+			// Curves are looked up below, one lane at a time.
+			if constexpr(bCurve == false)
+			{
+				VectorRegister4Float Target = Progress;
+				if constexpr(bRemap)
+				{
+					const VectorRegister4Float Min = VectorLoad(OutValueMin + Index);
+					const VectorRegister4Float Max = VectorLoad(OutValueMax + Index);
+					Target = VectorMultiplyAdd(VectorSubtract(Max, Min), Progress, Min);
+				}
+
+				// FMath::FInterpTo
+				const VectorRegister4Float Speed = VectorLoad(InterpSpeed + Index);
+				const VectorRegister4Float Current = VectorLoad(CurrentValue + Index);
+				const VectorRegister4Float Dist = VectorSubtract(Target, Current);
+				const VectorRegister4Float Alpha = VectorMin(VectorMax(VectorMultiply(VectorLoad(DeltaSeconds + Index), Speed), VectorZeroFloat()), VectorOneFloat());
+				const VectorRegister4Float Interpolated = VectorMultiplyAdd(Dist, Alpha, Current);
+				const VectorRegister4Float SnapMask = VectorBitwiseOr(
+					VectorCompareLE(Speed, VectorZeroFloat()),
+					VectorCompareLT(VectorMultiply(Dist, Dist), SmallNumberVec));
+				VectorStore(VectorSelect(SnapMask, Target, Interpolated), OutValue + Index);
+			}
+		}
+
+		// Remainder, same progress one lane at a time.
+		for(; Index < Num; Index++)
+		{
+			const float Duration = static_cast<float>(BeatDuration[Index]);
+			OutNormalized[Index] = FMath::Clamp(static_cast<float>(CurrentStep[Index] - StartStep[Index]) + SubStep[Index], 0.0f, Duration) / Duration;
+		}
+
+		const int32 FirstScalar = bCurve ? 0 : Num & ~3;
+		for(Index = FirstScalar; Index < Num; Index++)
+		{
+			float Target = OutNormalized[Index];
+			if constexpr(bCurve)
+			{
+				Target = Tables[CurveTable[Index]].Evaluate(Target);
+			}
+			if constexpr(bRemap)
+			{
+				Target = (OutValueMax[Index] - OutValueMin[Index]) * Target + OutValueMin[Index];
+			}
+			OutValue[Index] = FMath::FInterpTo(CurrentValue[Index], Target, DeltaSeconds[Index], InterpSpeed[Index]);
+		}
+	}
+}
+
+namespace QuartzVisualPulseKernels
+{
+	void EvaluateValues(
+		const EQuartzVisualValueVariant Variant,
+		const int32* RESTRICT CurrentStep,
+		const int32* RESTRICT StartStep,
+		const int32* RESTRICT BeatDuration,
+		const float* RESTRICT SubStep,
+		const int32* RESTRICT CurveTable,
+		const FQuartzVisualCurveTable* RESTRICT Tables,
+		const float* RESTRICT OutValueMin,
+		const float* RESTRICT OutValueMax,
+		const float* RESTRICT InterpSpeed,
+		const float* CurrentValue,
+		float* RESTRICT OutNormalized,
+		float* OutValue,
+		const float* RESTRICT DeltaSeconds,
+		const int32 Num)
+	{
+		using namespace QuartzVisualPulseKernelsPrivate;
+		switch(Variant)
+		{
+		case EQuartzVisualValueVariant::Linear:
+			EvaluateVariant<false, false>(CurrentStep, StartStep, BeatDuration, SubStep, CurveTable, Tables, OutValueMin, OutValueMax, InterpSpeed, CurrentValue, OutNormalized, OutValue, DeltaSeconds, Num);
+			break;
+		case EQuartzVisualValueVariant::Remap:
+			EvaluateVariant<false, true>(CurrentStep, StartStep, BeatDuration, SubStep, CurveTable, Tables, OutValueMin, OutValueMax, InterpSpeed, CurrentValue, OutNormalized, OutValue, DeltaSeconds, Num);
+			break;
+		case EQuartzVisualValueVariant::Curve:
+			EvaluateVariant<true, false>(CurrentStep, StartStep, BeatDuration, SubStep, CurveTable, Tables, OutValueMin, OutValueMax, InterpSpeed, CurrentValue, OutNormalized, OutValue, DeltaSeconds, Num);
+			break;
+		case EQuartzVisualValueVariant::CurveRemap:
+			EvaluateVariant<true, true>(CurrentStep, StartStep, BeatDuration, SubStep, CurveTable, Tables, OutValueMin, OutValueMax, InterpSpeed, CurrentValue, OutNormalized, OutValue, DeltaSeconds, Num);
+			break;
+		default:
+			break;
+		}
+	}
+}
@@ -0,0 +1,76 @@
+// Copyright Zuko Media 2023 all rights reserved.
+
+#include "QuartzVisualPulsePattern.h"
+#include "Algo/Reverse.h"
+#include "Algo/StableSort.h"
+
+#define LOCTEXT_NAMESPACE "QuartzVisualPulsePattern"
+
+void UQuartzVisualPulsePattern::Compile()
+{
+	bCompileDirty = false;
+	CompiledPulses.Reset(Pulses.Num());
+	PatternLength = 0;
+
+	// Walk backwards so the last pulse of each key and offset wins, the same as adding them one by one would.
+	// The same key at another offset is another hit of it and is kept.
+	TSet<FIntVector> SeenHits;
+	SeenHits.Reserve(Pulses.Num());
+	for(int32 PulseIndex = Pulses.Num() - 1; PulseIndex >= 0; PulseIndex--)
+	{
+		const FQuartzVisualPatternPulse& Pulse = Pulses[PulseIndex];
+		bool bAlreadySeen = false;
+		SeenHits.Add(FIntVector(Pulse.Settings.Index, Pulse.Settings.IndexFilter, FMath::Max(Pulse.BeatOffset, 0)), &bAlreadySeen);
+		if(bAlreadySeen)
+		{
+			continue;
+		}
+		FQuartzVisualPatternPulse& Compiled = CompiledPulses.Add_GetRef(Pulse);
+		Compiled.BeatOffset = FMath::Max(Compiled.BeatOffset, 0);
+		Compiled.BeatDuration = FMath::Max(Compiled.BeatDuration, 1);
+		PatternLength = FMath::Max(PatternLength, Compiled.BeatOffset + Compiled.BeatDuration);
+	}
+
+	// Scheduled in time order, ties keep the authored order. Repeats of a key are numbered in this order when added.
+	Algo::Reverse(CompiledPulses);
+	Algo::StableSortBy(CompiledPulses, &FQuartzVisualPatternPulse::BeatOffset);
+}
+
+void UQuartzVisualPulsePattern::PostLoad()
+{
+	Super::PostLoad();
+	MarkPulsesDirty();
+}
+
+#if WITH_EDITOR
+void UQuartzVisualPulsePattern::PostEditChangeProperty(FPropertyChangedEvent& PropertyChangedEvent)
+{
+	Super::PostEditChangeProperty(PropertyChangedEvent);
+	MarkPulsesDirty();
+}
+
+EDataValidationResult UQuartzVisualPulsePattern::IsDataValid(TArray<FText>& ValidationErrors)
+{
+	EDataValidationResult Result = Super::IsDataValid(ValidationErrors);
+	TSet<FIntVector> SeenHits;
+	for(int32 PulseIndex = 0; PulseIndex < Pulses.Num(); PulseIndex++)
+	{
+		const FQuartzVisualPatternPulse& Pulse = Pulses[PulseIndex];
+		if(Pulse.BeatDuration < 1 || Pulse.BeatOffset < 0)
+		{
+			ValidationErrors.Add(FText::Format(LOCTEXT("InvalidTiming", "Pulse {0} needs an offset of at least 0 and a duration of at least 1"), PulseIndex));
+			Result = EDataValidationResult::Invalid;
+		}
+		bool bAlreadySeen = false;
+		SeenHits.Add(FIntVector(Pulse.Settings.Index, Pulse.Settings.IndexFilter, FMath::Max(Pulse.BeatOffset, 0)), &bAlreadySeen);
+		if(bAlreadySeen)
+		{
+			ValidationErrors.Add(FText::Format(LOCTEXT("DuplicateKey", "Pulse {0} has the same Index, IndexFilter and BeatOffset as an earlier pulse and replaces it"), PulseIndex));
+			Result = EDataValidationResult::Invalid;
+		}
+	}
+	return Result;
+}
+#endif
+
+#undef LOCTEXT_NAMESPACE
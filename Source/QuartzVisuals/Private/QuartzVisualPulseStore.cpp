@@ -0,0 +1,636 @@
+// Copyright Zuko Media 2023 all rights reserved.
+
+#include "QuartzVisualPulseStore.h"
+
+void FQuartzVisualPulseHotData::Add(const FQuartzVisualPulseEntry& Entry)
+{
+	Actor.Add(Entry.Data.Actor);
+	Clock.Add(INDEX_NONE);
+	ClockBucketPosition.Add(INDEX_NONE);
+	StartStep.Add(0);
+	BeatDuration.Add(Entry.Data.BeatDuration);
+	State.Add(Entry.State);
+	Variant.Add(Entry.Settings.GetValueVariant());
+	ValueCurve.Add(Entry.Settings.ValueCurve);
+	CurveTable.Add(INDEX_NONE);
+	OutValueMin.Add(Entry.Settings.OutValueMinMax.X);
+	OutValueMax.Add(Entry.Settings.OutValueMinMax.Y);
+	InterpSpeed.Add(Entry.Settings.InterpSpeed);
+	OutValueNormalized.Add(Entry.OutValueNormalized);
+	OutValue.Add(Entry.OutValue);
+	Batched.Add(false);
+	NativeInterface.Add(nullptr);
+	InstanceSink.Add(INDEX_NONE);
+	Significance.Add(EQuartzVisualSignificance::Full);
+	Group.Add(INDEX_NONE);
+}
+
+void FQuartzVisualPulseHotData::RemoveAtSwap(int32 Index)
+{
+	Actor.RemoveAtSwap(Index, 1, false);
+	Clock.RemoveAtSwap(Index, 1, false);
+	ClockBucketPosition.RemoveAtSwap(Index, 1, false);
+	StartStep.RemoveAtSwap(Index, 1, false);
+	BeatDuration.RemoveAtSwap(Index, 1, false);
+	State.RemoveAtSwap(Index, 1, false);
+	Variant.RemoveAtSwap(Index, 1, false);
+	ValueCurve.RemoveAtSwap(Index, 1, false);
+	CurveTable.RemoveAtSwap(Index, 1, false);
+	OutValueMin.RemoveAtSwap(Index, 1, false);
+	OutValueMax.RemoveAtSwap(Index, 1, false);
+	InterpSpeed.RemoveAtSwap(Index, 1, false);
+	OutValueNormalized.RemoveAtSwap(Index, 1, false);
+	OutValue.RemoveAtSwap(Index, 1, false);
+	Batched.RemoveAtSwap(Index, 1, false);
+	NativeInterface.RemoveAtSwap(Index, 1, false);
+	InstanceSink.RemoveAtSwap(Index, 1, false);
+	Significance.RemoveAtSwap(Index, 1, false);
+	Group.RemoveAtSwap(Index, 1, false);
+}
+
+void FQuartzVisualPulseHotData::Swap(int32 IndexA, int32 IndexB)
+{
+	Actor.Swap(IndexA, IndexB);
+	Clock.Swap(IndexA, IndexB);
+	ClockBucketPosition.Swap(IndexA, IndexB);
+	StartStep.Swap(IndexA, IndexB);
+	BeatDuration.Swap(IndexA, IndexB);
+	State.Swap(IndexA, IndexB);
+	Variant.Swap(IndexA, IndexB);
+	ValueCurve.Swap(IndexA, IndexB);
+	CurveTable.Swap(IndexA, IndexB);
+	OutValueMin.Swap(IndexA, IndexB);
+	OutValueMax.Swap(IndexA, IndexB);
+	InterpSpeed.Swap(IndexA, IndexB);
+	OutValueNormalized.Swap(IndexA, IndexB);
+	OutValue.Swap(IndexA, IndexB);
+	Batched.Swap(IndexA, IndexB);
+	NativeInterface.Swap(IndexA, IndexB);
+	InstanceSink.Swap(IndexA, IndexB);
+	Significance.Swap(IndexA, IndexB);
+	Group.Swap(IndexA, IndexB);
+}
+
+void FQuartzVisualPulseHotData::Reserve(int32 Number)
+{
+	Actor.Reserve(Number);
+	Clock.Reserve(Number);
+	ClockBucketPosition.Reserve(Number);
+	StartStep.Reserve(Number);
+	BeatDuration.Reserve(Number);
+	State.Reserve(Number);
+	Variant.Reserve(Number);
+	ValueCurve.Reserve(Number);
+	CurveTable.Reserve(Number);
+	OutValueMin.Reserve(Number);
+	OutValueMax.Reserve(Number);
+	InterpSpeed.Reserve(Number);
+	OutValueNormalized.Reserve(Number);
+	OutValue.Reserve(Number);
+	Batched.Reserve(Number);
+	NativeInterface.Reserve(Number);
+	InstanceSink.Reserve(Number);
+	Significance.Reserve(Number);
+	Group.Reserve(Number);
+}
+
+void FQuartzVisualPulseHotData::Reset()
+{
+	Actor.Reset();
+	Clock.Reset();
+	ClockBucketPosition.Reset();
+	StartStep.Reset();
+	BeatDuration.Reset();
+	State.Reset();
+	Variant.Reset();
+	ValueCurve.Reset();
+	CurveTable.Reset();
+	OutValueMin.Reset();
+	OutValueMax.Reset();
+	InterpSpeed.Reset();
+	OutValueNormalized.Reset();
+	OutValue.Reset();
+	Batched.Reset();
+	NativeInterface.Reset();
+	InstanceSink.Reset();
+	Significance.Reset();
+	Group.Reset();
+}
+
+FQuartzVisualPulseHandle FQuartzVisualPulseStore::Add(const FQuartzVisualPulseEntry& NewEntry, int32 ClockIndex, const FQuartzVisualPulseKey& Key, int32 GroupIndex)
+{
+	check(Lookup.Contains(Key) == false);
+
+	int32 SlotIndex;
+	if(FreeSlots.Num() > 0)
+	{
+		SlotIndex = FreeSlots.Pop(false);
+	}
+	else
+	{
+		SlotIndex = Slots.AddDefaulted();
+	}
+
+	FSlot& Slot = Slots[SlotIndex];
+	Slot.DenseIndex = Cold.Add(NewEntry);
+	Hot.Add(NewEntry);
+	Keys.Add(Key);
+	DenseToSlot.Add(SlotIndex);
+
+	const FQuartzVisualPulseHandle Handle(SlotIndex, Slot.Generation);
+	Lookup.Add(Key, Handle);
+	Hot.Group.Last() = GroupIndex;
+	if(GroupIndex == INDEX_NONE)
+	{
+		FQuartzVisualListener& Listener = FindOrAddListener(NewEntry.Data.Actor);
+		Listener.Pulses.Add(Handle);
+		Hot.Batched.Last() = Listener.bWantsBatchedUpdates;
+		Hot.NativeInterface.Last() = Listener.NativeInterface;
+		Hot.Significance.Last() = Listener.Significance;
+	}
+	else
+	{
+		GroupMembers.Add(Handle);
+	}
+
+	AddClock(ClockIndex);
+	Hot.Clock.Last() = ClockIndex;
+	Hot.ClockBucketPosition.Last() = ClockBuckets[ClockIndex].Add(Handle);
+
+	// Same counting as before: the entry's beat count goes up by one on every step, it starts once that reaches its offset.
+	Hot.StartStep.Last() = ClockSchedules[ClockIndex].Step + 1 + NewEntry.Data.BeatOffset - NewEntry.Data.CurrentBeatCount;
+	Schedule(Slot.DenseIndex);
+
+	// Into its variant's range, the first entry of every later variant moves to the end of its own range to make room.
+	const int32 NewVariant = static_cast<int32>(Hot.Variant.Last());
+	int32 DenseIndex = Slot.DenseIndex;
+	for(int32 Variant = static_cast<int32>(EQuartzVisualValueVariant::Num) - 1; Variant > NewVariant; Variant--)
+	{
+		const int32 VariantStart = VariantEnd[Variant - 1];
+		SwapDense(VariantStart, DenseIndex);
+		DenseIndex = VariantStart;
+		VariantEnd[Variant]++;
+	}
+	VariantEnd[NewVariant]++;
+	return Handle;
+}
+
+void FQuartzVisualPulseStore::SwapDense(int32 DenseIndexA, int32 DenseIndexB)
+{
+	if(DenseIndexA == DenseIndexB)
+	{
+		return;
+	}
+	Cold.Swap(DenseIndexA, DenseIndexB);
+	Hot.Swap(DenseIndexA, DenseIndexB);
+	Keys.Swap(DenseIndexA, DenseIndexB);
+	DenseToSlot.Swap(DenseIndexA, DenseIndexB);
+	Slots[DenseToSlot[DenseIndexA]].DenseIndex = DenseIndexA;
+	Slots[DenseToSlot[DenseIndexB]].DenseIndex = DenseIndexB;
+}
+
+void FQuartzVisualPulseStore::AddClock(int32 ClockIndex)
+{
+	if(ClockBuckets.Num() <= ClockIndex)
+	{
+		ClockBuckets.SetNum(ClockIndex + 1);
+		ClockSchedules.SetNum(ClockIndex + 1);
+	}
+	if(ClockSchedules[ClockIndex].Wheel.Num() == 0)
+	{
+		ClockSchedules[ClockIndex].Wheel.SetNum(TimingWheelSize);
+	}
+}
+
+void FQuartzVisualPulseStore::Schedule(int32 DenseIndex)
+{
+	FClockSchedule& ClockSchedule = ClockSchedules[Hot.Clock[DenseIndex]];
+	const FQuartzVisualPulseHandle Handle = GetHandle(DenseIndex);
+	const int32 StartStep = Hot.StartStep[DenseIndex];
+	if(StartStep > ClockSchedule.Step)
+	{
+		ClockSchedule.Wheel[StartStep & (TimingWheelSize - 1)].Add({Handle, StartStep, false});
+	}
+	// Pulses already past their end finish on the next step.
+	const int32 FinishStep = FMath::Max(StartStep + Hot.BeatDuration[DenseIndex], ClockSchedule.Step + 1);
+	ClockSchedule.Wheel[FinishStep & (TimingWheelSize - 1)].Add({Handle, FinishStep, true});
+}
+
+void FQuartzVisualPulseStore::SetClockStep(int32 ClockIndex, int32 Step)
+{
+	AddClock(ClockIndex);
+	ClockSchedules[ClockIndex].Step = Step;
+}
+
+void FQuartzVisualPulseStore::RebaseClock(int32 ClockIndex, int32 Step)
+{
+	AddClock(ClockIndex);
+	FClockSchedule& ClockSchedule = ClockSchedules[ClockIndex];
+	const int32 Delta = Step - ClockSchedule.Step;
+	ClockSchedule.Step = Step;
+	for(TArray<FScheduledPulse>& WheelSlot : ClockSchedule.Wheel)
+	{
+		WheelSlot.Reset();
+	}
+	for(const FQuartzVisualPulseHandle& Handle : ClockBuckets[ClockIndex])
+	{
+		const int32 DenseIndex = GetDenseIndex(Handle);
+		Hot.StartStep[DenseIndex] += Delta;
+		Schedule(DenseIndex);
+	}
+}
+
+void FQuartzVisualPulseStore::CollectDuePulses(int32 ClockIndex, int32 Step, FQuartzVisualDuePulses& OutStarting, FQuartzVisualDuePulses& OutFinishing)
+{
+	if(ClockSchedules.IsValidIndex(ClockIndex) == false || ClockSchedules[ClockIndex].Wheel.Num() == 0)
+	{
+		return;
+	}
+
+	// Compacted in place so the pulses left for later turns keep their order. Removed pulses are dropped on the first
+	// turn that passes them, not carried until their own step.
+	TArray<FScheduledPulse>& WheelSlot = ClockSchedules[ClockIndex].Wheel[Step & (TimingWheelSize - 1)];
+	int32 NumKept = 0;
+	for(int32 EntryIndex = 0; EntryIndex < WheelSlot.Num(); EntryIndex++)
+	{
+		const FScheduledPulse& Scheduled = WheelSlot[EntryIndex];
+		if(GetDenseIndex(Scheduled.Handle) == INDEX_NONE)
+		{
+			continue;
+		}
+		if(Scheduled.Step > Step)
+		{
+			WheelSlot[NumKept++] = Scheduled;
+			continue;
+		}
+		if(Scheduled.Step == Step)
+		{
+			(Scheduled.bFinish ? OutFinishing : OutStarting).Add(Scheduled.Handle);
+		}
+	}
+	WheelSlot.SetNum(NumKept, false);
+}
+
+void FQuartzVisualPulseStore::AddGroupMember(const FQuartzVisualPulseHandle& Handle, const AActor* Actor)
+{
+	TArray<TObjectKey<AActor>>* Members = GroupMembers.Find(Handle);
+	check(Members);
+	Members->Add(TObjectKey<AActor>(Actor));
+	GroupMemberships.FindOrAdd(TObjectKey<AActor>(Actor)).Add(Handle);
+}
+
+void FQuartzVisualPulseStore::RemoveGroupMember(const FQuartzVisualPulseHandle& Handle, const AActor* Actor)
+{
+	const TObjectKey<AActor> ActorKey(Actor);
+	if(TArray<TObjectKey<AActor>>* Members = GroupMembers.Find(Handle))
+	{
+		Members->RemoveSingleSwap(ActorKey, false);
+	}
+	if(TArray<FQuartzVisualPulseHandle>* Memberships = GroupMemberships.Find(ActorKey))
+	{
+		Memberships->RemoveSingleSwap(Handle, false);
+		if(Memberships->Num() == 0)
+		{
+			GroupMemberships.Remove(ActorKey);
+		}
+	}
+}
+
+FQuartzVisualListener& FQuartzVisualPulseStore::FindOrAddListener(AActor* Actor)
+{
+	FQuartzVisualListener& Listener = Listeners.FindOrAdd(TObjectKey<AActor>(Actor));
+	Listener.Actor = Actor;
+	return Listener;
+}
+
+void FQuartzVisualPulseStore::UpdateSignificance(TFunctionRef<EQuartzVisualSignificance(const AActor*)> Evaluate)
+{
+	for(TPair<TObjectKey<AActor>, FQuartzVisualListener>& Listener : Listeners)
+	{
+		const EQuartzVisualSignificance Significance = Evaluate(Listener.Value.Actor.Get());
+		if(Significance != Listener.Value.Significance)
+		{
+			Listener.Value.Significance = Significance;
+			for(const FQuartzVisualPulseHandle& Handle : Listener.Value.Pulses)
+			{
+				Hot.Significance[GetDenseIndex(Handle)] = Significance;
+			}
+		}
+	}
+}
+
+bool FQuartzVisualPulseStore::Remove(const FQuartzVisualPulseHandle& Handle)
+{
+	const int32 DenseIndex = GetDenseIndex(Handle);
+	if(DenseIndex == INDEX_NONE)
+	{
+		return false;
+	}
+	RemoveAt(DenseIndex);
+	return true;
+}
+
+void FQuartzVisualPulseStore::RemoveAt(int32 DenseIndex)
+{
+	// Carried to the end through the variant ranges, the last entry of each range fills the hole left in it.
+	for(int32 Variant = static_cast<int32>(Hot.Variant[DenseIndex]); Variant < static_cast<int32>(EQuartzVisualValueVariant::Num); Variant++)
+	{
+		const int32 VariantLast = VariantEnd[Variant] - 1;
+		SwapDense(DenseIndex, VariantLast);
+		DenseIndex = VariantLast;
+		VariantEnd[Variant]--;
+	}
+
+	const FQuartzVisualPulseKey RemovedKey = Keys[DenseIndex];
+	const FQuartzVisualPulseHandle RemovedHandle = GetHandle(DenseIndex);
+
+	Lookup.Remove(RemovedKey);
+	if(Hot.Group[DenseIndex] != INDEX_NONE)
+	{
+		TArray<TObjectKey<AActor>> Members;
+		GroupMembers.RemoveAndCopyValue(RemovedHandle, Members);
+		for(const TObjectKey<AActor>& Member : Members)
+		{
+			TArray<FQuartzVisualPulseHandle>& Memberships = GroupMemberships.FindChecked(Member);
+			Memberships.RemoveSingleSwap(RemovedHandle, false);
+			if(Memberships.Num() == 0)
+			{
+				GroupMemberships.Remove(Member);
+			}
+		}
+	}
+	else if(FQuartzVisualListener* Listener = Listeners.Find(RemovedKey.Actor))
+	{
+		Listener->Pulses.RemoveSingleSwap(RemovedHandle, false);
+		if(Listener->Pulses.Num() == 0)
+		{
+			Listeners.Remove(RemovedKey.Actor);
+		}
+	}
+
+	// Same swap removal in the clock's bucket, the entry moved into the hole needs its position updated.
+	TArray<FQuartzVisualPulseHandle>& ClockBucket = ClockBuckets[Hot.Clock[DenseIndex]];
+	const int32 BucketPosition = Hot.ClockBucketPosition[DenseIndex];
+	ClockBucket.RemoveAtSwap(BucketPosition, 1, false);
+	if(ClockBucket.IsValidIndex(BucketPosition))
+	{
+		Hot.ClockBucketPosition[Slots[ClockBucket[BucketPosition].SlotIndex].DenseIndex] = BucketPosition;
+	}
+
+	// Free the slot, bumping the generation makes every outstanding handle to it stale.
+	FSlot& RemovedSlot = Slots[RemovedHandle.SlotIndex];
+	RemovedSlot.DenseIndex = INDEX_NONE;
+	RemovedSlot.Generation++;
+	FreeSlots.Add(RemovedHandle.SlotIndex);
+
+	// Always the last entry by now, nothing else moves.
+	check(DenseIndex == Cold.Num() - 1);
+	Cold.Pop(false);
+	Hot.RemoveAtSwap(DenseIndex);
+	Keys.Pop(false);
+	DenseToSlot.Pop(false);
+}
+
+void FQuartzVisualPulseStore::Reserve(int32 NumToAdd)
+{
+	const int32 Number = Num() + NumToAdd;
+	Cold.Reserve(Number);
+	Hot.Reserve(Number);
+	Keys.Reserve(Number);
+	DenseToSlot.Reserve(Number);
+	Lookup.Reserve(Number);
+	Slots.Reserve(Slots.Num() + FMath::Max(NumToAdd - FreeSlots.Num(), 0));
+}
+
+void FQuartzVisualPulseStore::Reset()
+{
+	// Keep the slots around so stale handles stay stale.
+	for(const int32 SlotIndex : DenseToSlot)
+	{
+		FSlot& Slot = Slots[SlotIndex];
+		Slot.DenseIndex = INDEX_NONE;
+		Slot.Generation++;
+		FreeSlots.Add(SlotIndex);
+	}
+	Cold.Reset();
+	Hot.Reset();
+	Keys.Reset();
+	DenseToSlot.Reset();
+	Lookup.Reset();
+	Listeners.Reset();
+	GroupMemberships.Reset();
+	GroupMembers.Reset();
+	FMemory::Memzero(VariantEnd);
+	for(TArray<FQuartzVisualPulseHandle>& ClockBucket : ClockBuckets)
+	{
+		ClockBucket.Reset();
+	}
+	for(FClockSchedule& ClockSchedule : ClockSchedules)
+	{
+		for(TArray<FScheduledPulse>& WheelSlot : ClockSchedule.Wheel)
+		{
+			WheelSlot.Reset();
+		}
+	}
+}
+
+int32 FQuartzVisualPulseStore::GetDenseIndex(const FQuartzVisualPulseHandle& Handle) const
+{
+	if(Slots.IsValidIndex(Handle.SlotIndex) && Slots[Handle.SlotIndex].Generation == Handle.Generation)
+	{
+		return Slots[Handle.SlotIndex].DenseIndex;
+	}
+	return INDEX_NONE;
+}
+
+bool FQuartzVisualPulseStore::Validate() const
+{
+	if(Keys.Num() != Cold.Num() || Hot.Num() != Cold.Num() || DenseToSlot.Num() != Cold.Num() || Lookup.Num() != Cold.Num())
+	{
+		return false;
+	}
+
+	if(Slots.Num() != Cold.Num() + FreeSlots.Num())
+	{
+		return false;
+	}
+
+	int32 ActorHandleCount = 0;
+	for(const TPair<TObjectKey<AActor>, FQuartzVisualListener>& Listener : Listeners)
+	{
+		for(const FQuartzVisualPulseHandle& Handle : Listener.Value.Pulses)
+		{
+			const int32 DenseIndex = GetDenseIndex(Handle);
+			if(DenseIndex == INDEX_NONE || Keys[DenseIndex].Actor != Listener.Key || Hot.Group[DenseIndex] != INDEX_NONE)
+			{
+				return false;
+			}
+			// Instance pulses never go through the listener, so they don't mirror it.
+			const bool bSinkPulse = Hot.InstanceSink[DenseIndex] != INDEX_NONE;
+			if(bSinkPulse == false && (Hot.Batched[DenseIndex] != Listener.Value.bWantsBatchedUpdates || Hot.NativeInterface[DenseIndex] != Listener.Value.NativeInterface))
+			{
+				return false;
+			}
+			if(Hot.Significance[DenseIndex] != Listener.Value.Significance)
+			{
+				return false;
+			}
+		}
+		ActorHandleCount += Listener.Value.Pulses.Num();
+	}
+	// Group pulses are the ones without a listener.
+	if(ActorHandleCount + GroupMembers.Num() != Cold.Num())
+	{
+		return false;
+	}
+
+	int32 MembershipCount = 0;
+	for(const TPair<TObjectKey<AActor>, TArray<FQuartzVisualPulseHandle>>& Memberships : GroupMemberships)
+	{
+		for(const FQuartzVisualPulseHandle& Handle : Memberships.Value)
+		{
+			const TArray<TObjectKey<AActor>>* Members = GroupMembers.Find(Handle);
+			if(Members == nullptr || Members->Contains(Memberships.Key) == false)
+			{
+				return false;
+			}
+		}
+		MembershipCount += Memberships.Value.Num();
+	}
+	for(const TPair<FQuartzVisualPulseHandle, TArray<TObjectKey<AActor>>>& Members : GroupMembers)
+	{
+		const int32 DenseIndex = GetDenseIndex(Members.Key);
+		if(DenseIndex == INDEX_NONE || Hot.Group[DenseIndex] == INDEX_NONE)
+		{
+			return false;
+		}
+		MembershipCount -= Members.Value.Num();
+	}
+	if(MembershipCount != 0)
+	{
+		return false;
+	}
+
+	for(int32 DenseIndex = 0; DenseIndex < Cold.Num(); DenseIndex++)
+	{
+		const FQuartzVisualPulseHandle Handle = GetHandle(DenseIndex);
+		if(GetDenseIndex(Handle) != DenseIndex)
+		{
+			return false;
+		}
+
+		const FQuartzVisualPulseKey& Key = Keys[DenseIndex];
+		const FQuartzVisualPulseHandle* LookupHandle = Lookup.Find(Key);
+		if(LookupHandle == nullptr || (*LookupHandle == Handle) == false)
+		{
+			return false;
+		}
+
+		// Keys are captured on add, the entry itself only differs once its actor has been destroyed.
+		const FQuartzVisualPulseEntry& Entry = Cold[DenseIndex];
+		if(Hot.Actor[DenseIndex] && (TObjectKey<AActor>(Hot.Actor[DenseIndex]) != Key.Actor || Entry.Settings.Index != Key.Index || Entry.Settings.IndexFilter != Key.IndexFilter))
+		{
+			return false;
+		}
+	}
+
+	// Variant ranges follow each other and cover every entry.
+	if(VariantEnd[static_cast<int32>(EQuartzVisualValueVariant::Num) - 1] != Cold.Num())
+	{
+		return false;
+	}
+	for(int32 Variant = 0; Variant < static_cast<int32>(EQuartzVisualValueVariant::Num); Variant++)
+	{
+		const EQuartzVisualValueVariant ValueVariant = static_cast<EQuartzVisualValueVariant>(Variant);
+		if(GetVariantStart(ValueVariant) > GetVariantEnd(ValueVariant))
+		{
+			return false;
+		}
+		for(int32 DenseIndex = GetVariantStart(ValueVariant); DenseIndex < GetVariantEnd(ValueVariant); DenseIndex++)
+		{
+			if(Hot.Variant[DenseIndex] != ValueVariant)
+			{
+				return false;
+			}
+		}
+	}
+
+	int32 ClockHandleCount = 0;
+	for(int32 ClockIndex = 0; ClockIndex < ClockBuckets.Num(); ClockIndex++)
+	{
+		for(int32 BucketPosition = 0; BucketPosition < ClockBuckets[ClockIndex].Num(); BucketPosition++)
+		{
+			const int32 DenseIndex = GetDenseIndex(ClockBuckets[ClockIndex][BucketPosition]);
+			if(DenseIndex == INDEX_NONE || Hot.Clock[DenseIndex] != ClockIndex || Hot.ClockBucketPosition[DenseIndex] != BucketPosition)
+			{
+				return false;
+			}
+		}
+		ClockHandleCount += ClockBuckets[ClockIndex].Num();
+	}
+	if(ClockHandleCount != Cold.Num())
+	{
+		return false;
+	}
+
+	// Every pulse finishes exactly once, on or after the step it ends on.
+	TMap<FQuartzVisualPulseHandle, int32> FinishCounts;
+	for(int32 ClockIndex = 0; ClockIndex < ClockSchedules.Num(); ClockIndex++)
+	{
+		for(const TArray<FScheduledPulse>& WheelSlot : ClockSchedules[ClockIndex].Wheel)
+		{
+			for(const FScheduledPulse& Scheduled : WheelSlot)
+			{
+				const int32 DenseIndex = GetDenseIndex(Scheduled.Handle);
+				if(Scheduled.bFinish && DenseIndex != INDEX_NONE)
+				{
+					if(Hot.Clock[DenseIndex] != ClockIndex || Scheduled.Step < Hot.StartStep[DenseIndex] + Hot.BeatDuration[DenseIndex])
+					{
+						return false;
+					}
+					FinishCounts.FindOrAdd(Scheduled.Handle)++;
+				}
+			}
+		}
+	}
+	if(FinishCounts.Num() != Cold.Num())
+	{
+		return false;
+	}
+	for(const TPair<FQuartzVisualPulseHandle, int32>& FinishCount : FinishCounts)
+	{
+		if(FinishCount.Value != 1)
+		{
+			return false;
+		}
+	}
+
+	for(const int32 SlotIndex : FreeSlots)
+	{
+		if(Slots[SlotIndex].DenseIndex != INDEX_NONE)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+void FQuartzVisualPulseStore::AddReferencedObjects(FReferenceCollector& Collector)
+{
+	// The cold entries hold the same objects, they are written from Hot on AssembleEntry.
+	Collector.AddReferencedObjects(Hot.Actor);
+	Collector.AddReferencedObjects(Hot.ValueCurve);
+}
+
+FQuartzVisualPulseEntry& FQuartzVisualPulseStore::AssembleEntry(int32 DenseIndex)
+{
+	FQuartzVisualPulseEntry& Entry = Cold[DenseIndex];
+	Entry.Data.Actor = Hot.Actor[DenseIndex];
+	// Beat count relative to the offset, as if the entry still counted its own beats.
+	Entry.Data.CurrentBeatCount = GetClockStep(Hot.Clock[DenseIndex]) + 1 - Hot.StartStep[DenseIndex] + Entry.Data.BeatOffset;
+	Entry.Settings.ValueCurve = Hot.ValueCurve[DenseIndex];
+	Entry.State = Hot.State[DenseIndex];
+	Entry.OutValueNormalized = Hot.OutValueNormalized[DenseIndex];
+	Entry.OutValue = Hot.OutValue[DenseIndex];
+	return Entry;
+}
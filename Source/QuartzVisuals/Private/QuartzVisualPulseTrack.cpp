@@ -0,0 +1,93 @@
+// Copyright Zuko Media 2023 all rights reserved.
+
+#include "QuartzVisualPulseTrack.h"
+#include "QuartzVisualSubsystem.h"
+#include "Async/MappedFileHandle.h"
+#include "HAL/FileManager.h"
+#include "HAL/PlatformFileManager.h"
+#include "Misc/FileHelper.h"
+
+FQuartzVisualMappedPulseTrack::FQuartzVisualMappedPulseTrack() = default;
+FQuartzVisualMappedPulseTrack::FQuartzVisualMappedPulseTrack(FQuartzVisualMappedPulseTrack&&) = default;
+FQuartzVisualMappedPulseTrack& FQuartzVisualMappedPulseTrack::operator=(FQuartzVisualMappedPulseTrack&&) = default;
+
+FQuartzVisualMappedPulseTrack::~FQuartzVisualMappedPulseTrack()
+{
+	// The region has to go before the file it maps.
+	MappedRegion.Reset();
+	MappedFile.Reset();
+}
+
+bool FQuartzVisualMappedPulseTrack::Open(const FString& FilePath)
+{
+	MappedRegion.Reset();
+	MappedFile.Reset();
+	LoadedBytes.Empty();
+	Header = nullptr;
+	Pulses = nullptr;
+
+	const uint8* Data = nullptr;
+	int64 Size = 0;
+	MappedFile.Reset(FPlatformFileManager::Get().GetPlatformFile().OpenMapped(*FilePath));
+	if(MappedFile.IsValid() && MappedFile->GetFileSize() >= static_cast<int64>(sizeof(FQuartzVisualTrackHeader)))
+	{
+		MappedRegion.Reset(MappedFile->MapRegion(0, MappedFile->GetFileSize()));
+	}
+	if(MappedRegion.IsValid())
+	{
+		Data = MappedRegion->GetMappedPtr();
+		Size = MappedRegion->GetMappedSize();
+	}
+	else
+	{
+		// Files inside a pak can't be mapped. Staging Content/PulseTracks as non-UFS keeps them mappable, otherwise the whole track is loaded.
+		MappedFile.Reset();
+		if(FFileHelper::LoadFileToArray(LoadedBytes, *FilePath, FILEREAD_Silent) == false)
+		{
+			UE_LOG(LogQuartzVisuals, Warning, TEXT("Can't open pulse track %s"), *FilePath);
+			return false;
+		}
+		UE_LOG(LogQuartzVisuals, Warning, TEXT("Can't map pulse track %s, loaded all %lld bytes instead. Add PulseTracks to DirectoriesToAlwaysStageAsNonUFS to stream it."), *FilePath, LoadedBytes.Num());
+		Data = LoadedBytes.GetData();
+		Size = LoadedBytes.Num();
+	}
+
+	const FQuartzVisualTrackHeader* TrackHeader = reinterpret_cast<const FQuartzVisualTrackHeader*>(Data);
+	const int64 PulseBytes = Size - static_cast<int64>(sizeof(FQuartzVisualTrackHeader));
+	if(PulseBytes < 0 || TrackHeader->Magic != FQuartzVisualTrackHeader::TrackMagic || TrackHeader->Version != FQuartzVisualTrackHeader::TrackVersion
+		|| TrackHeader->StepsPerBeat <= 0 || TrackHeader->NumPulses < 0 || static_cast<int64>(TrackHeader->NumPulses) * static_cast<int64>(sizeof(FQuartzVisualTrackPulse)) > PulseBytes)
+	{
+		UE_LOG(LogQuartzVisuals, Warning, TEXT("%s is not a pulse track this version can play"), *FilePath);
+		MappedRegion.Reset();
+		MappedFile.Reset();
+		LoadedBytes.Empty();
+		return false;
+	}
+
+	Header = TrackHeader;
+	Pulses = reinterpret_cast<const FQuartzVisualTrackPulse*>(Header + 1);
+	return true;
+}
+
+bool FQuartzVisualMappedPulseTrack::Write(const FString& FilePath, int32 StepsPerBeat, const TArray<FQuartzVisualTrackPulse>& InPulses)
+{
+	TUniquePtr<FArchive> Writer(IFileManager::Get().CreateFileWriter(*FilePath));
+	if(Writer.IsValid() == false)
+	{
+		UE_LOG(LogQuartzVisuals, Warning, TEXT("Can't write pulse track %s"), *FilePath);
+		return false;
+	}
+
+	FQuartzVisualTrackHeader TrackHeader;
+	TrackHeader.StepsPerBeat = StepsPerBeat;
+	TrackHeader.NumPulses = InPulses.Num();
+	for(const FQuartzVisualTrackPulse& Pulse : InPulses)
+	{
+		TrackHeader.LengthSteps = FMath::Max(TrackHeader.LengthSteps, Pulse.StartStep + Pulse.DurationSteps);
+	}
+
+	// Written as they are in memory, the player maps them back without parsing.
+	Writer->Serialize(&TrackHeader, sizeof(TrackHeader));
+	Writer->Serialize(const_cast<FQuartzVisualTrackPulse*>(InPulses.GetData()), InPulses.Num() * sizeof(FQuartzVisualTrackPulse));
+	return Writer->Close();
+}
@@ -0,0 +1,597 @@
+// Copyright Zuko Media 2023 all rights reserved.
+
+#include "QuartzVisualRecorder.h"
+#include "QuartzVisualSubsystem.h"
+#include "Components/InstancedStaticMeshComponent.h"
+#include "Curves/CurveFloat.h"
+#include "Engine/World.h"
+#include "HAL/PlatformFileManager.h"
+#include "Misc/FileHelper.h"
+#include "Serialization/MemoryReader.h"
+
+FQuartzVisualRecorder::FQuartzVisualRecorder()
+	: Writer(Buffer)
+{
+}
+
+FQuartzVisualRecorder::~FQuartzVisualRecorder()
+{
+	Stop();
+}
+
+bool FQuartzVisualRecorder::Start(const FString& FilePath)
+{
+	Stop();
+	IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+	PlatformFile.CreateDirectoryTree(*FPaths::GetPath(FilePath));
+	FileHandle.Reset(PlatformFile.OpenWrite(*FilePath, true));
+	if(FileHandle.IsValid() == false)
+	{
+		UE_LOG(LogQuartzVisuals, Warning, TEXT("Can't open %s for recording"), *FilePath);
+		return false;
+	}
+
+	Buffer.Reset(BufferSize);
+	Writer.Seek(0);
+	NameIds.Reset();
+	ObjectIds.Reset();
+	ClockRecords.Reset();
+
+	uint32 Magic = FileMagic;
+	int32 Version = FileVersion;
+	WriteType(EQuartzVisualRecordType::Begin);
+	Writer << Magic << Version;
+	return true;
+}
+
+void FQuartzVisualRecorder::Stop()
+{
+	if(FileHandle.IsValid())
+	{
+		Flush();
+		FileHandle->Flush();
+		FileHandle.Reset();
+	}
+}
+
+void FQuartzVisualRecorder::RecordClock(const FQuartzVisualClockState& Clock)
+{
+	uint32 ClockNameId = GetNameId(Clock.ClockName);
+
+	uint8 Quantization = static_cast<uint8>(Clock.Quantization);
+	uint8 CoarseQuantization = static_cast<uint8>(Clock.CoarseQuantization);
+	uint8 EventQuantization = static_cast<uint8>(Clock.EventQuantization);
+	float StepsPerSecond = Clock.StepsPerSecond;
+	float StepsPerBeat = Clock.StepsPerBeat;
+	float BeatsPerBar = Clock.BeatsPerBar;
+	int32 StepsPerCoarseEvent = Clock.StepsPerCoarseEvent;
+	float DeltaTimeMultiplier = Clock.DeltaTimeMultiplier;
+	bool bAudioBeatFeed = Clock.AudioBeatFeed.IsValid();
+
+	ClockScratch.Reset();
+	FMemoryWriter ClockWriter(ClockScratch);
+	ClockWriter << Quantization << CoarseQuantization << EventQuantization << StepsPerSecond << StepsPerBeat << BeatsPerBar << StepsPerCoarseEvent << DeltaTimeMultiplier << bAudioBeatFeed;
+
+	// Called on every event, written only when something changed.
+	TArray<uint8>& LastRecord = ClockRecords.FindOrAdd(Clock.ClockName);
+	if(LastRecord == ClockScratch)
+	{
+		return;
+	}
+	LastRecord = ClockScratch;
+
+	WriteType(EQuartzVisualRecordType::Clock);
+	Writer << ClockNameId;
+	Writer.Serialize(ClockScratch.GetData(), ClockScratch.Num());
+	FlushIfFull();
+}
+
+void FQuartzVisualRecorder::RecordEvent(FName ClockName, EQuartzCommandQuantization QuantizationType, int32 NumBars, int32 Beat, float BeatFraction)
+{
+	uint32 ClockNameId = GetNameId(ClockName);
+	uint8 Quantization = static_cast<uint8>(QuantizationType);
+	WriteType(EQuartzVisualRecordType::Event);
+	Writer << ClockNameId << Quantization << NumBars << Beat << BeatFraction;
+	FlushIfFull();
+}
+
+void FQuartzVisualRecorder::RecordStep(FName ClockName, int32 Step, float AgeSeconds)
+{
+	uint32 ClockNameId = GetNameId(ClockName);
+	WriteType(EQuartzVisualRecordType::Step);
+	Writer << ClockNameId << Step << AgeSeconds;
+	FlushIfFull();
+}
+
+void FQuartzVisualRecorder::RecordFrame(float DeltaTime)
+{
+	WriteType(EQuartzVisualRecordType::Frame);
+	Writer << DeltaTime;
+	FlushIfFull();
+}
+
+void FQuartzVisualRecorder::RecordAddPulse(const AActor* Actor, const FQuartzVisualPulseSettings& Settings, int32 BeatDuration, int32 BeatOffset, int32 Repeat, FQuartzVisualPulseHandle Handle)
+{
+	uint32 ActorId = GetObjectId(Actor, EQuartzVisualRecordedObject::Actor);
+	const uint32 ClockNameId = GetNameId(Settings.ClockName);
+	const uint32 CurveId = GetObjectId(Settings.ValueCurve, EQuartzVisualRecordedObject::Asset);
+	WriteType(EQuartzVisualRecordType::AddPulse);
+	Writer << ActorId;
+	WriteSettings(Settings, ClockNameId, CurveId);
+	Writer << BeatDuration << BeatOffset << Repeat;
+	WriteHandle(Handle);
+	FlushIfFull();
+}
+
+void FQuartzVisualRecorder::RecordAddGroupPulse(const TArray<TWeakObjectPtr<AActor>>& Members, const FQuartzVisualPulseSettings& Settings, int32 BeatDuration, int32 BeatOffset, FQuartzVisualPulseHandle Handle)
+{
+	TArray<uint32, TInlineAllocator<64>> MemberIds;
+	for(const TWeakObjectPtr<AActor>& Member : Members)
+	{
+		MemberIds.Add(GetObjectId(Member.Get(), EQuartzVisualRecordedObject::Actor));
+	}
+	const uint32 ClockNameId = GetNameId(Settings.ClockName);
+	const uint32 CurveId = GetObjectId(Settings.ValueCurve, EQuartzVisualRecordedObject::Asset);
+	WriteType(EQuartzVisualRecordType::AddGroupPulse);
+	int32 NumMembers = MemberIds.Num();
+	Writer << NumMembers;
+	for(uint32& MemberId : MemberIds)
+	{
+		Writer << MemberId;
+	}
+	WriteSettings(Settings, ClockNameId, CurveId);
+	Writer << BeatDuration << BeatOffset;
+	WriteHandle(Handle);
+	FlushIfFull();
+}
+
+void FQuartzVisualRecorder::RecordAddInstancePulse(const UObject* Component, int32 InstanceIndex, int32 CustomDataIndex, const FQuartzVisualPulseSettings& Settings, int32 BeatDuration, int32 BeatOffset, FQuartzVisualPulseHandle Handle)
+{
+	uint32 ComponentId = GetObjectId(Component, EQuartzVisualRecordedObject::Component);
+	const uint32 ClockNameId = GetNameId(Settings.ClockName);
+	const uint32 CurveId = GetObjectId(Settings.ValueCurve, EQuartzVisualRecordedObject::Asset);
+	WriteType(EQuartzVisualRecordType::AddInstancePulse);
+	Writer << ComponentId << InstanceIndex << CustomDataIndex;
+	WriteSettings(Settings, ClockNameId, CurveId);
+	Writer << BeatDuration << BeatOffset;
+	WriteHandle(Handle);
+	FlushIfFull();
+}
+
+void FQuartzVisualRecorder::RecordRemovePulse(FQuartzVisualPulseHandle Handle)
+{
+	WriteType(EQuartzVisualRecordType::RemovePulse);
+	WriteHandle(Handle);
+	FlushIfFull();
+}
+
+void FQuartzVisualRecorder::RecordRemoveGroupMember(FQuartzVisualPulseHandle Handle, const AActor* Actor)
+{
+	uint32 ActorId = GetObjectId(Actor, EQuartzVisualRecordedObject::Actor);
+	WriteType(EQuartzVisualRecordType::RemoveGroupMember);
+	WriteHandle(Handle);
+	Writer << ActorId;
+	FlushIfFull();
+}
+
+void FQuartzVisualRecorder::RecordRemoveAll()
+{
+	WriteType(EQuartzVisualRecordType::RemoveAll);
+	FlushIfFull();
+}
+
+uint32 FQuartzVisualRecorder::GetNameId(FName Name)
+{
+	if(Name.IsNone())
+	{
+		return 0;
+	}
+	if(const uint32* ExistingId = NameIds.Find(Name))
+	{
+		return *ExistingId;
+	}
+	uint32 Id = NameIds.Num() + 1;
+	NameIds.Add(Name, Id);
+	FString NameString = Name.ToString();
+	WriteType(EQuartzVisualRecordType::Name);
+	Writer << Id << NameString;
+	return Id;
+}
+
+uint32 FQuartzVisualRecorder::GetObjectId(const UObject* Object, EQuartzVisualRecordedObject Kind)
+{
+	if(Object == nullptr)
+	{
+		return 0;
+	}
+	if(const uint32* ExistingId = ObjectIds.Find(FObjectKey(Object)))
+	{
+		return *ExistingId;
+	}
+	uint32 Id = ObjectIds.Num() + 1;
+	ObjectIds.Add(FObjectKey(Object), Id);
+	uint8 KindValue = static_cast<uint8>(Kind);
+	FString Path = Object->GetPathName();
+	WriteType(EQuartzVisualRecordType::Object);
+	Writer << Id << KindValue << Path;
+	return Id;
+}
+
+void FQuartzVisualRecorder::WriteType(EQuartzVisualRecordType Type)
+{
+	uint8 TypeValue = static_cast<uint8>(Type);
+	Writer << TypeValue;
+}
+
+void FQuartzVisualRecorder::WriteSettings(const FQuartzVisualPulseSettings& Settings, uint32 ClockNameId, uint32 CurveId)
+{
+	// Saving doesn't modify, this only saves copying the strings.
+	FQuartzVisualPulseSettings& SavedSettings = const_cast<FQuartzVisualPulseSettings&>(Settings);
+	Writer << SavedSettings.DebugDisplayName << SavedSettings.IndexFilter << SavedSettings.Index << ClockNameId << SavedSettings.UseValue;
+	Writer << SavedSettings.Payload.VectorData << SavedSettings.Payload.FloatData << SavedSettings.Payload.IntData;
+	Writer << CurveId << SavedSettings.OutValueMinMax << SavedSettings.InterpSpeed << SavedSettings.ValueMultiplier;
+}
+
+void FQuartzVisualRecorder::WriteHandle(FQuartzVisualPulseHandle Handle)
+{
+	Writer << Handle.SlotIndex << Handle.Generation;
+}
+
+void FQuartzVisualRecorder::FlushIfFull()
+{
+	if(Buffer.Num() >= FlushThreshold)
+	{
+		Flush();
+	}
+}
+
+void FQuartzVisualRecorder::Flush()
+{
+	if(Buffer.Num() > 0)
+	{
+		FileHandle->Write(Buffer.GetData(), Buffer.Num());
+		// Keeps the allocation.
+		Buffer.Reset();
+		Writer.Seek(0);
+	}
+}
+
+bool FQuartzVisualReplayer::Open(const FString& FilePath, UWorld* InWorld, TSubclassOf<AActor> InStandInClass)
+{
+	if(FFileHelper::LoadFileToArray(Data, *FilePath) == false)
+	{
+		UE_LOG(LogQuartzVisuals, Warning, TEXT("Can't read recording %s"), *FilePath);
+		return false;
+	}
+
+	Reader = MakeUnique<FMemoryReader>(Data);
+	uint8 Type = 0;
+	uint32 Magic = 0;
+	int32 Version = 0;
+	*Reader << Type << Magic << Version;
+	if(Reader->IsError() || Type != static_cast<uint8>(EQuartzVisualRecordType::Begin) || Magic != FQuartzVisualRecorder::FileMagic || Version > FQuartzVisualRecorder::FileVersion)
+	{
+		UE_LOG(LogQuartzVisuals, Warning, TEXT("%s is not a recording this version can play"), *FilePath);
+		Reader.Reset();
+		return false;
+	}
+	// The first session starts like any other.
+	Reader->Seek(0);
+
+	World = InWorld;
+	StandInClass = InStandInClass ? InStandInClass.Get() : AQuartzVisualReplayActor::StaticClass();
+	ResetTables();
+	RecordedSeconds = 0.0;
+	TargetSeconds = 0.0;
+	NumFrames = 0;
+	return true;
+}
+
+bool FQuartzVisualReplayer::Replay(UQuartzVisualSubsystem& Subsystem, double Seconds)
+{
+	TargetSeconds += Seconds;
+	while(RecordedSeconds < TargetSeconds)
+	{
+		if(ReplayFrame(Subsystem) == false)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+DECLARE_CYCLE_STAT(TEXT("Quartz Visual Replay"), STAT_QuartzVisualReplay, STATGROUP_QuartzVisuals);
+bool FQuartzVisualReplayer::ReplayFrame(UQuartzVisualSubsystem& Subsystem)
+{
+	SCOPE_CYCLE_COUNTER(STAT_QuartzVisualReplay);
+	if(Reader.IsValid() == false)
+	{
+		return false;
+	}
+
+	FArchive& Ar = *Reader;
+	while(Ar.Tell() < Ar.TotalSize() && Ar.IsError() == false)
+	{
+		uint8 Type = 0;
+		Ar << Type;
+		switch(static_cast<EQuartzVisualRecordType>(Type))
+		{
+		case EQuartzVisualRecordType::Begin:
+		{
+			uint32 Magic = 0;
+			int32 Version = 0;
+			Ar << Magic << Version;
+			if(Magic != FQuartzVisualRecorder::FileMagic || Version > FQuartzVisualRecorder::FileVersion)
+			{
+				UE_LOG(LogQuartzVisuals, Warning, TEXT("Session at %lld is not one this version can play, stopping the replay"), Ar.Tell());
+				return false;
+			}
+			SessionVersion = Version;
+			ResetTables();
+			break;
+		}
+		case EQuartzVisualRecordType::Name:
+		{
+			uint32 Id = 0;
+			FString NameString;
+			Ar << Id << NameString;
+			// Ids are handed out in order from 1, anything past the next one is a corrupt file and would size the table from garbage.
+			if(Id == 0 || Id > static_cast<uint32>(Names.Num()) + 1)
+			{
+				UE_LOG(LogQuartzVisuals, Error, TEXT("Name id %u at %lld is out of range of the table size %d, stopping the replay"), Id, Ar.Tell(), Names.Num());
+				return false;
+			}
+			Names.SetNum(FMath::Max(Names.Num(), static_cast<int32>(Id) + 1));
+			Names[Id] = FName(*NameString);
+			break;
+		}
+		case EQuartzVisualRecordType::Object:
+		{
+			uint32 Id = 0;
+			uint8 Kind = 0;
+			FString Path;
+			Ar << Id << Kind << Path;
+			if(Id == 0 || Id > static_cast<uint32>(Objects.Num()) + 1)
+			{
+				UE_LOG(LogQuartzVisuals, Error, TEXT("Object id %u at %lld is out of range of the table size %d, stopping the replay"), Id, Ar.Tell(), Objects.Num());
+				return false;
+			}
+			Objects.SetNum(FMath::Max(Objects.Num(), static_cast<int32>(Id) + 1));
+			Objects[Id] = ResolveObject(static_cast<EQuartzVisualRecordedObject>(Kind), Path);
+			break;
+		}
+		case EQuartzVisualRecordType::Clock:
+		{
+			const FName ClockName = ReadName();
+			uint8 Quantization = 0;
+			uint8 CoarseQuantization = 0;
+			uint8 EventQuantization = 0;
+			bool bAudioBeatFeed = false;
+			FQuartzVisualClockState& Clock = Subsystem.Clocks[Subsystem.ClaimQuartzVisualClock(ClockName)];
+			Ar << Quantization << CoarseQuantization << EventQuantization << Clock.StepsPerSecond << Clock.StepsPerBeat << Clock.BeatsPerBar << Clock.StepsPerCoarseEvent << Clock.DeltaTimeMultiplier << bAudioBeatFeed;
+			Clock.Quantization = static_cast<EQuartzCommandQuantization>(Quantization);
+			Clock.CoarseQuantization = static_cast<EQuartzCommandQuantization>(CoarseQuantization);
+			Clock.EventQuantization = static_cast<EQuartzCommandQuantization>(EventQuantization);
+			if(bAudioBeatFeed && Clock.AudioBeatFeed.IsValid() == false)
+			{
+				// Never registered with a device, it only makes events anchor instead of step. The steps come from the recording.
+				Clock.AudioBeatFeed = MakeShared<FQuartzVisualAudioBeatFeed, ESPMode::ThreadSafe>();
+				Clock.LastStep = INDEX_NONE;
+			}
+			break;
+		}
+		case EQuartzVisualRecordType::Event:
+		{
+			const FName ClockName = ReadName();
+			uint8 Quantization = 0;
+			int32 NumBars = 0;
+			int32 Beat = 0;
+			float BeatFraction = 0.0f;
+			Ar << Quantization << NumBars << Beat << BeatFraction;
+			Subsystem.OnQuantizationEvent(ClockName, static_cast<EQuartzCommandQuantization>(Quantization), NumBars, Beat, BeatFraction);
+			break;
+		}
+		case EQuartzVisualRecordType::Step:
+		{
+			const FName ClockName = ReadName();
+			int32 Step = 0;
+			float AgeSeconds = 0.0f;
+			Ar << Step << AgeSeconds;
+			Subsystem.AdvanceQuartzVisualClockTo(Subsystem.ClaimQuartzVisualClock(ClockName), Step, AgeSeconds);
+			break;
+		}
+		case EQuartzVisualRecordType::Frame:
+		{
+			float DeltaTime = 0.0f;
+			Ar << DeltaTime;
+			Subsystem.UpdateStartCycles = FPlatformTime::Cycles64();
+			Subsystem.UpdateQuartzVisualPulseFrame(DeltaTime);
+			RecordedSeconds += DeltaTime;
+			NumFrames++;
+			return Ar.IsError() == false;
+		}
+		case EQuartzVisualRecordType::AddPulse:
+		{
+			AActor* Actor = ReadActor();
+			FQuartzVisualPulseSettings Settings;
+			ReadSettings(Settings);
+			int32 BeatDuration = 0;
+			int32 BeatOffset = 0;
+			int32 Repeat = 0;
+			Ar << BeatDuration << BeatOffset;
+			if(SessionVersion >= 2)
+			{
+				Ar << Repeat;
+			}
+			const FQuartzVisualPulseHandle RecordedHandle = ReadHandle();
+			if(Actor && Subsystem.CanReceiveQuartzVisualPulses(Actor))
+			{
+				Handles.Add(RecordedHandle, Subsystem.AddCheckedQuartzVisualPulse(Actor, Settings, BeatDuration, BeatOffset, false, Repeat));
+			}
+			break;
+		}
+		case EQuartzVisualRecordType::AddGroupPulse:
+		{
+			int32 NumMembers = 0;
+			Ar << NumMembers;
+			// Every member is an object id, a count past the object table can't be valid.
+			if(NumMembers < 0 || NumMembers > Objects.Num())
+			{
+				UE_LOG(LogQuartzVisuals, Error, TEXT("Group of %d members at %lld with %d objects, stopping the replay"), NumMembers, Ar.Tell(), Objects.Num());
+				return false;
+			}
+			TArray<AActor*> Members;
+			Members.Reserve(NumMembers);
+			for(int32 MemberIndex = 0; MemberIndex < NumMembers && Ar.IsError() == false; MemberIndex++)
+			{
+				if(AActor* Member = ReadActor())
+				{
+					Members.Add(Member);
+				}
+			}
+			FQuartzVisualPulseSettings Settings;
+			ReadSettings(Settings);
+			int32 BeatDuration = 0;
+			int32 BeatOffset = 0;
+			Ar << BeatDuration << BeatOffset;
+			const FQuartzVisualPulseHandle RecordedHandle = ReadHandle();
+			Handles.Add(RecordedHandle, Subsystem.AddNewQuartzVisualGroupPulse(Members, Settings, BeatDuration, BeatOffset));
+			break;
+		}
+		case EQuartzVisualRecordType::AddInstancePulse:
+		{
+			UInstancedStaticMeshComponent* Component = Cast<UInstancedStaticMeshComponent>(ReadObject());
+			int32 InstanceIndex = 0;
+			int32 CustomDataIndex = 0;
+			Ar << InstanceIndex << CustomDataIndex;
+			FQuartzVisualPulseSettings Settings;
+			ReadSettings(Settings);
+			int32 BeatDuration = 0;
+			int32 BeatOffset = 0;
+			Ar << BeatDuration << BeatOffset;
+			const FQuartzVisualPulseHandle RecordedHandle = ReadHandle();
+			if(Component)
+			{
+				Handles.Add(RecordedHandle, Subsystem.AddNewQuartzVisualInstancePulse(Component, InstanceIndex, CustomDataIndex, Settings, BeatDuration, BeatOffset));
+			}
+			break;
+		}
+		case EQuartzVisualRecordType::RemovePulse:
+		{
+			FQuartzVisualPulseHandle ReplayHandle;
+			if(Handles.RemoveAndCopyValue(ReadHandle(), ReplayHandle))
+			{
+				Subsystem.RemoveQuartzVisualPulse(ReplayHandle);
+			}
+			break;
+		}
+		case EQuartzVisualRecordType::RemoveGroupMember:
+		{
+			const FQuartzVisualPulseHandle RecordedHandle = ReadHandle();
+			AActor* Actor = ReadActor();
+			const FQuartzVisualPulseHandle* ReplayHandle = Handles.Find(RecordedHandle);
+			if(ReplayHandle && Actor)
+			{
+				Subsystem.RemoveQuartzVisualGroupMember(*ReplayHandle, Actor);
+			}
+			break;
+		}
+		case EQuartzVisualRecordType::RemoveAll:
+			Subsystem.RemoveAllQuartzVisualPulses();
+			Handles.Reset();
+			break;
+		default:
+			UE_LOG(LogQuartzVisuals, Warning, TEXT("Unknown record %d at %lld, stopping the replay"), Type, Ar.Tell() - 1);
+			return false;
+		}
+	}
+	// A recording cut off mid record (the process died before it stopped) plays up to there.
+	return false;
+}
+
+void FQuartzVisualReplayer::ReadSettings(FQuartzVisualPulseSettings& OutSettings)
+{
+	FArchive& Ar = *Reader;
+	Ar << OutSettings.DebugDisplayName << OutSettings.IndexFilter << OutSettings.Index;
+	OutSettings.ClockName = ReadName();
+	Ar << OutSettings.UseValue;
+	Ar << OutSettings.Payload.VectorData << OutSettings.Payload.FloatData << OutSettings.Payload.IntData;
+	OutSettings.ValueCurve = Cast<UCurveFloat>(ReadObject());
+	Ar << OutSettings.OutValueMinMax << OutSettings.InterpSpeed << OutSettings.ValueMultiplier;
+}
+
+FQuartzVisualPulseHandle FQuartzVisualReplayer::ReadHandle()
+{
+	FQuartzVisualPulseHandle Handle;
+	*Reader << Handle.SlotIndex << Handle.Generation;
+	return Handle;
+}
+
+FName FQuartzVisualReplayer::ReadName()
+{
+	uint32 Id = 0;
+	*Reader << Id;
+	return Names.IsValidIndex(Id) ? Names[Id] : NAME_None;
+}
+
+UObject* FQuartzVisualReplayer::ReadObject()
+{
+	uint32 Id = 0;
+	*Reader << Id;
+	return Objects.IsValidIndex(Id) ? Objects[Id] : nullptr;
+}
+
+AActor* FQuartzVisualReplayer::ReadActor()
+{
+	return Cast<AActor>(ReadObject());
+}
+
+UObject* FQuartzVisualReplayer::ResolveObject(EQuartzVisualRecordedObject Kind, const FString& Path)
+{
+	switch(Kind)
+	{
+	case EQuartzVisualRecordedObject::Actor:
+	{
+		AActor* Actor = FindObject<AActor>(nullptr, *Path);
+		if(IsValid(Actor) == false && World.IsValid())
+		{
+			FActorSpawnParameters SpawnParameters;
+			SpawnParameters.ObjectFlags |= RF_Transient;
+			Actor = World->SpawnActor<AActor>(StandInClass, SpawnParameters);
+			StandIns.Add(Actor);
+		}
+		return Actor;
+	}
+	case EQuartzVisualRecordedObject::Asset:
+		return LoadObject<UObject>(nullptr, *Path);
+	case EQuartzVisualRecordedObject::Component:
+		return FindObject<UObject>(nullptr, *Path);
+	default:
+		return nullptr;
+	}
+}
+
+void FQuartzVisualReplayer::ResetTables()
+{
+	Names.Reset();
+	Objects.Reset();
+	Handles.Reset();
+}
+
+void FQuartzVisualReplayer::DestroyStandIns()
+{
+	for(const TWeakObjectPtr<AActor>& StandIn : StandIns)
+	{
+		if(AActor* Actor = StandIn.Get())
+		{
+			Actor->Destroy();
+		}
+	}
+	StandIns.Reset();
+}
+
+void FQuartzVisualReplayer::AddReferencedObjects(FReferenceCollector& Collector)
+{
+	Collector.AddReferencedObjects(Objects);
+	Collector.AddReferencedObject(StandInClass);
+}
@@ -3,12 +3,245 @@
 
 #include "QuartzVisualSubsystem.h"
 #include "QuartzVisualInterface.h"
+#include "QuartzVisualPulseKernels.h"
+#include "QuartzVisualMidiImporter.h"
 #include "Kismet/KismetSystemLibrary.h"
+#include "Async/ParallelFor.h"
+#include "Components/InstancedStaticMeshComponent.h"
+#include "GameFramework/PlayerController.h"
+#include "Quartz/QuartzSubsystem.h"
+#include "AudioDevice.h"
+#include "AudioMixerDevice.h"
+#include "ProfilingDebugging/CsvProfiler.h"
+#include "HAL/LowLevelMemTracker.h"
+#include "Misc/Paths.h"
+#include "ProfilingDebugging/CpuProfilerTrace.h"
+#include "Trace/Trace.inl"
+
+CSV_DEFINE_CATEGORY(QuartzVisuals, true);
+
+// Enabled with -trace=cpu,QuartzVisuals. Adds a scope per step and per actor dispatch to the timing view, and a ClockStep event per clock step.
+UE_TRACE_CHANNEL(QuartzVisualsChannel)
+
+UE_TRACE_EVENT_BEGIN(QuartzVisuals, ClockStep)
+	UE_TRACE_EVENT_FIELD(uint64, Cycle)
+	UE_TRACE_EVENT_FIELD(int32, Clock)
+	UE_TRACE_EVENT_FIELD(int32, Step)
+	UE_TRACE_EVENT_FIELD(uint32, Starts)
+	UE_TRACE_EVENT_FIELD(uint32, Finishes)
+UE_TRACE_EVENT_END()
+
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Active Pulses"), STAT_QuartzVisualActivePulses, STATGROUP_QuartzVisuals);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Pending Pulses"), STAT_QuartzVisualPendingPulses, STATGROUP_QuartzVisuals);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Dispatches"), STAT_QuartzVisualDispatches, STATGROUP_QuartzVisuals);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Pulse Starts"), STAT_QuartzVisualStarts, STATGROUP_QuartzVisuals);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Pulse Finishes"), STAT_QuartzVisualFinishes, STATGROUP_QuartzVisuals);
 
 DEFINE_LOG_CATEGORY(LogQuartzVisuals);
 
+#if !UE_BUILD_SHIPPING
+int32 GQuartzVisualsEnableLogs = 0;
+static FAutoConsoleVariableRef CVarQuartzVisualsEnableLogs(
+	TEXT("QuartzVisuals.EnableLogs"),
+	GQuartzVisualsEnableLogs,
+	TEXT("Enable logs for the visuals. These can be pretty verbose"),
+	ECVF_Default);
+#endif
+
+int32 GQuartzVisualsValidateLookup = 0;
+static FAutoConsoleVariableRef CVarQuartzVisualsValidateLookup(
+	TEXT("QuartzVisuals.ValidateLookup"),
+	GQuartzVisualsValidateLookup,
+	TEXT("Verify the pulse lookup maps against the entry array after every change. Slow, for debugging only"),
+	ECVF_Default);
+
+int32 GQuartzVisualsParallelUpdateThreshold = 4096;
+static FAutoConsoleVariableRef CVarQuartzVisualsParallelUpdateThreshold(
+	TEXT("QuartzVisuals.ParallelUpdateThreshold"),
+	GQuartzVisualsParallelUpdateThreshold,
+	TEXT("Number of active pulses at which pulse values are computed on worker threads. 0 always computes on the game thread"),
+	ECVF_Default);
+
+int32 GQuartzVisualsSubBeatPhase = 1;
+static FAutoConsoleVariableRef CVarQuartzVisualsSubBeatPhase(
+	TEXT("QuartzVisuals.SubBeatPhase"),
+	GQuartzVisualsSubBeatPhase,
+	TEXT("Advance pulse progress every frame from each clock's estimated phase instead of in whole quantization steps"),
+	ECVF_Default);
+
+int32 GQuartzVisualsSignificance = 0;
+static FAutoConsoleVariableRef CVarQuartzVisualsSignificance(
+	TEXT("QuartzVisuals.Significance"),
+	GQuartzVisualsSignificance,
+	TEXT("Send fewer mid-pulse updates to actors that are far away or haven't been rendered recently. Start and finish are always sent"),
+	ECVF_Default);
+
+float GQuartzVisualsSignificanceReducedDistance = 3000.0f;
+static FAutoConsoleVariableRef CVarQuartzVisualsSignificanceReducedDistance(
+	TEXT("QuartzVisuals.Significance.ReducedDistance"),
+	GQuartzVisualsSignificanceReducedDistance,
+	TEXT("Distance to the closest local view past which actors only get an update every ReducedInterval frames"),
+	ECVF_Default);
+
+float GQuartzVisualsSignificanceEventsOnlyDistance = 10000.0f;
+static FAutoConsoleVariableRef CVarQuartzVisualsSignificanceEventsOnlyDistance(
+	TEXT("QuartzVisuals.Significance.EventsOnlyDistance"),
+	GQuartzVisualsSignificanceEventsOnlyDistance,
+	TEXT("Distance to the closest local view past which actors only get start and finish"),
+	ECVF_Default);
+
+int32 GQuartzVisualsSignificanceReducedInterval = 4;
+static FAutoConsoleVariableRef CVarQuartzVisualsSignificanceReducedInterval(
+	TEXT("QuartzVisuals.Significance.ReducedInterval"),
+	GQuartzVisualsSignificanceReducedInterval,
+	TEXT("Frames between updates for reduced significance actors. Actors are staggered over the frames"),
+	ECVF_Default);
+
+float GQuartzVisualsSignificanceRenderTimeout = 0.5f;
+static FAutoConsoleVariableRef CVarQuartzVisualsSignificanceRenderTimeout(
+	TEXT("QuartzVisuals.Significance.RenderTimeout"),
+	GQuartzVisualsSignificanceRenderTimeout,
+	TEXT("Seconds without being rendered after which an actor only gets start and finish"),
+	ECVF_Default);
+
+int32 GQuartzVisualsSignificanceEvaluateInterval = 8;
+static FAutoConsoleVariableRef CVarQuartzVisualsSignificanceEvaluateInterval(
+	TEXT("QuartzVisuals.Significance.EvaluateInterval"),
+	GQuartzVisualsSignificanceEvaluateInterval,
+	TEXT("Frames between significance checks of every listening actor"),
+	ECVF_Default);
+
+int32 GQuartzVisualsFrameBudgetUs = 0;
+static FAutoConsoleVariableRef CVarQuartzVisualsFrameBudgetUs(
+	TEXT("QuartzVisuals.FrameBudgetUs"),
+	GQuartzVisualsFrameBudgetUs,
+	TEXT("Microseconds per frame for pulse updates. Mid-pulse updates that don't fit are sent next frame, picking up where this one stopped. Start and finish are never deferred. 0 is unlimited"),
+	ECVF_Default);
+
+int32 GQuartzVisualsTrackLookaheadSteps = 32;
+static FAutoConsoleVariableRef CVarQuartzVisualsTrackLookaheadSteps(
+	TEXT("QuartzVisuals.TrackLookaheadSteps"),
+	GQuartzVisualsTrackLookaheadSteps,
+	TEXT("Clock steps ahead of the current one that playing pulse tracks add their pulses. Only this window of a track is ever turned into pulses"),
+	ECVF_Default);
+
+int32 GQuartzVisualsIdleBarEvents = 1;
+static FAutoConsoleVariableRef CVarQuartzVisualsIdleBarEvents(
+	TEXT("QuartzVisuals.IdleBarEvents"),
+	GQuartzVisualsIdleBarEvents,
+	TEXT("Clocks no pulse follows only subscribe to bar events until the next pulse is added"),
+	ECVF_Default);
+
+float GQuartzVisualsAudioFeedMaxDrift = 0.1f;
+static FAutoConsoleVariableRef CVarQuartzVisualsAudioFeedMaxDrift(
+	TEXT("QuartzVisuals.AudioFeedMaxDrift"),
+	GQuartzVisualsAudioFeedMaxDrift,
+	TEXT("Fraction of a step the audio beat feed's grid can be off from quartz's events before it is moved"),
+	ECVF_Default);
+
+static FAutoConsoleCommandWithWorldAndArgs QuartzVisualsRecordCommand(
+	TEXT("QuartzVisuals.Record"),
+	TEXT("QuartzVisuals.Record <FileName> starts recording the world's quantization events and pulse commands, no file name stops it"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World)
+	{
+		if(UQuartzVisualSubsystem* Subsystem = World ? World->GetSubsystem<UQuartzVisualSubsystem>() : nullptr)
+		{
+			if(Args.Num() > 0)
+			{
+				Subsystem->StartQuartzVisualRecording(Args[0]);
+			}
+			else
+			{
+				Subsystem->StopQuartzVisualRecording();
+			}
+		}
+	}));
+
+static FAutoConsoleCommandWithWorldAndArgs QuartzVisualsReplayCommand(
+	TEXT("QuartzVisuals.Replay"),
+	TEXT("QuartzVisuals.Replay <FileName> [RealTime] plays a recording back through the world's subsystem, no file name stops it"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World)
+	{
+		if(UQuartzVisualSubsystem* Subsystem = World ? World->GetSubsystem<UQuartzVisualSubsystem>() : nullptr)
+		{
+			if(Args.Num() > 0)
+			{
+				Subsystem->StartQuartzVisualReplay(Args[0], Args.Num() > 1 && Args[1].ToBool());
+			}
+			else
+			{
+				Subsystem->StopQuartzVisualReplay();
+			}
+		}
+	}));
+
+static FAutoConsoleCommand QuartzVisualsImportMidiCommand(
+	TEXT("QuartzVisuals.ImportMidi"),
+	TEXT("QuartzVisuals.ImportMidi <MidiFile> <TrackFile> [StepsPerBeat] converts a MIDI file into a pulse track"),
+	FConsoleCommandWithArgsDelegate::CreateLambda([](const TArray<FString>& Args)
+	{
+		if(Args.Num() >= 2)
+		{
+			UQuartzVisualSubsystem::ImportQuartzVisualMidiTrack(Args[0], Args[1], Args.Num() > 2 ? FCString::Atoi(*Args[2]) : 8);
+		}
+	}));
+
+namespace QuartzVisualSubsystemPrivate
+{
+	// True if calling the event's _Implementation directly does the same as going through reflection.
+	bool IsNativeEvent(const AActor* Actor, const FName FunctionName)
+	{
+		// No function means Execute_ would fall back to the native interface anyway, a blueprint override is never native.
+		const UFunction* Function = Actor->FindFunction(FunctionName);
+		return Function == nullptr || Function->HasAnyFunctionFlags(FUNC_Native);
+	}
+
+	// The actor as the interface when OnQuartzVisualUpdate can be called directly, otherwise null.
+	IQuartzVisualsInterface* FindNativeUpdateInterface(AActor* Actor)
+	{
+		IQuartzVisualsInterface* NativeInterface = Cast<IQuartzVisualsInterface>(Actor);
+		return NativeInterface && IsNativeEvent(Actor, GET_FUNCTION_NAME_CHECKED(IQuartzVisualsInterface, OnQuartzVisualUpdate)) ? NativeInterface : nullptr;
+	}
+
+	FORCEINLINE void SendUpdate(AActor* Actor, IQuartzVisualsInterface* NativeInterface, const FQuartzVisualPulseEntry& PulseEntry)
+	{
+		if(NativeInterface)
+		{
+			NativeInterface->OnQuartzVisualUpdate_Implementation(PulseEntry);
+		}
+		else
+		{
+			IQuartzVisualsInterface::Execute_OnQuartzVisualUpdate(Actor, PulseEntry);
+		}
+	}
+
+	// Length of the quantization in beats, a beat being a quarter note.
+	float GetQuantizationBeats(const EQuartzCommandQuantization Quantization, const int32 BeatsPerBar)
+	{
+		switch(Quantization)
+		{
+		case EQuartzCommandQuantization::Bar: return static_cast<float>(BeatsPerBar);
+		case EQuartzCommandQuantization::Beat: return 1.0f;
+		case EQuartzCommandQuantization::ThirtySecondNote: return 0.125f;
+		case EQuartzCommandQuantization::SixteenthNote: return 0.25f;
+		case EQuartzCommandQuantization::EighthNote: return 0.5f;
+		case EQuartzCommandQuantization::QuarterNote: return 1.0f;
+		case EQuartzCommandQuantization::HalfNote: return 2.0f;
+		case EQuartzCommandQuantization::WholeNote: return 4.0f;
+		case EQuartzCommandQuantization::DottedSixteenthNote: return 0.375f;
+		case EQuartzCommandQuantization::DottedEighthNote: return 0.75f;
+		case EQuartzCommandQuantization::DottedQuarterNote: return 1.5f;
+		case EQuartzCommandQuantization::DottedHalfNote: return 3.0f;
+		case EQuartzCommandQuantization::DottedWholeNote: return 6.0f;
+		case EQuartzCommandQuantization::SixteenthNoteTriplet: return 1.0f / 6.0f;
+		case EQuartzCommandQuantization::EighthNoteTriplet: return 1.0f / 3.0f;
+		case EQuartzCommandQuantization::QuarterNoteTriplet: return 2.0f / 3.0f;
+		case EQuartzCommandQuantization::HalfNoteTriplet: return 4.0f / 3.0f;
+		default: return 0.125f;
+		}
+	}
+}
 
-PRAGMA_DISABLE_OPTIMIZATION
 void UQuartzVisualSubsystem::Tick(float DeltaTime)
 {
 	if(UseForcedTick == false)
@@ -19,7 +252,7 @@ void UQuartzVisualSubsystem::Tick(float DeltaTime)
 
 TStatId UQuartzVisualSubsystem::GetStatId() const
 {
-	return TStatId();
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UQuartzVisualSubsystem, STATGROUP_QuartzVisuals);
 }
 
 bool UQuartzVisualSubsystem::DoesSupportWorldType(const EWorldType::Type WorldType) const
@@ -31,6 +264,11 @@ bool UQuartzVisualSubsystem::ShouldCreateSubsystem(UObject* Outer) const
 {
 	UWorld* World = Cast<UWorld>(Outer);
 	check(World);
+	// Nothing is drawn on a dedicated server, so there is nothing to pulse.
+	if(IsRunningDedicatedServer())
+	{
+		return false;
+	}
 	// Forces us to be able to ONLY use the worlds supported
 	if(DoesSupportWorldType(World->WorldType))
 	{
@@ -42,13 +280,90 @@ bool UQuartzVisualSubsystem::ShouldCreateSubsystem(UObject* Outer) const
 void UQuartzVisualSubsystem::Initialize(FSubsystemCollectionBase& Collection)
 {
 	Super::Initialize(Collection);
+	PostGarbageCollectHandle = FCoreUObjectDelegates::GetPostGarbageCollect().AddUObject(this, &UQuartzVisualSubsystem::OnQuartzVisualPostGarbageCollect);
 }
 
 void UQuartzVisualSubsystem::Deinitialize()
 {
+	CommandQueue.Empty();
+	Recorder.Stop();
+	Replayer.Reset();
+	PulseTracks.Empty();
+	if(FAudioDeviceHandle AudioDevice = GetWorld() ? GetWorld()->GetAudioDevice() : FAudioDeviceHandle())
+	{
+		for(FQuartzVisualClockState& Clock : Clocks)
+		{
+			if(Clock.AudioBeatFeed.IsValid())
+			{
+				ReleaseQuartzVisualAudioBeatFeed(AudioDevice, Clock.AudioBeatFeed);
+			}
+		}
+	}
+	FCoreUObjectDelegates::GetPostGarbageCollect().Remove(PostGarbageCollectHandle);
+	CurveCache.Reset();
 	Super::Deinitialize();
 }
 
+void UQuartzVisualSubsystem::OnQuartzVisualPostGarbageCollect()
+{
+	PruneQuartzVisualInstanceSinks();
+	PruneQuartzVisualCurveTables();
+}
+
+void UQuartzVisualSubsystem::PruneQuartzVisualInstanceSinks()
+{
+	// Pulses on a destroyed component have nothing left to write to, persistent ones would hold their sink forever.
+	TArray<FQuartzVisualPulseHandle> StaleHandles;
+	const FQuartzVisualPulseHotData& Hot = QuartzVisualEntries.Hot;
+	for(int32 Index = 0; Index < QuartzVisualEntries.Num(); Index++)
+	{
+		const int32 SinkIndex = Hot.InstanceSink[Index];
+		if(SinkIndex != INDEX_NONE && InstanceSinks[SinkIndex].Component.IsValid() == false)
+		{
+			StaleHandles.Add(QuartzVisualEntries.GetHandle(Index));
+		}
+	}
+	for(const FQuartzVisualPulseHandle& Handle : StaleHandles)
+	{
+		RemoveQuartzVisualEntry(Handle);
+	}
+}
+
+void UQuartzVisualSubsystem::PruneQuartzVisualCurveTables()
+{
+	// Curves of live pulses are referenced by the store, so a table can only lose its curve once nothing uses it.
+	TBitArray<> UsedTables;
+	const FQuartzVisualPulseHotData& Hot = QuartzVisualEntries.Hot;
+	for(int32 Index = 0; Index < QuartzVisualEntries.Num(); Index++)
+	{
+		const int32 TableIndex = Hot.CurveTable[Index];
+		if(TableIndex != INDEX_NONE)
+		{
+			if(TableIndex >= UsedTables.Num())
+			{
+				UsedTables.Add(false, TableIndex + 1 - UsedTables.Num());
+			}
+			UsedTables[TableIndex] = true;
+		}
+	}
+	CurveCache.Prune(UsedTables);
+}
+
+void UQuartzVisualSubsystem::AddReferencedObjects(UObject* InThis, FReferenceCollector& Collector)
+{
+	UQuartzVisualSubsystem* This = CastChecked<UQuartzVisualSubsystem>(InThis);
+	This->QuartzVisualEntries.AddReferencedObjects(Collector);
+	if(This->Replayer.IsValid())
+	{
+		This->Replayer->AddReferencedObjects(Collector);
+	}
+	for(FQuartzVisualPulseTrackPlayback& Playback : This->PulseTracks)
+	{
+		Collector.AddReferencedObject(Playback.Settings.ValueCurve);
+	}
+	Super::AddReferencedObjects(InThis, Collector);
+}
+
 void UQuartzVisualSubsystem::ForceTick(float DeltaTime)
 {
 	if(UseForcedTick)
@@ -65,13 +380,34 @@ void UQuartzVisualSubsystem::TickInternal(float DeltaTime)
 {
 	if(IsInitialized && IsValid(OwningWorld) && OwningWorld->IsPaused() == false)
 	{
-		UpdateQuartzVisualPulseEntries(DeltaTime);
+		if(Replayer.IsValid())
+		{
+			// The recording drives the update while it plays.
+			if(Replayer->Replay(*this, DeltaTime) == false)
+			{
+				StopQuartzVisualReplay();
+			}
+		}
+		else
+		{
+			UpdateQuartzVisualPulseEntries(DeltaTime);
+		}
 	}
 }
 
 bool UQuartzVisualSubsystem::IsTickable() const
 {
-	return true;
+	// Clock events keep the steps going without the tick, it is only needed while there is something to update.
+	if(UseForcedTick)
+	{
+		return false;
+	}
+	if(QuartzVisualEntries.Num() > 0 || CommandQueue.IsEmpty() == false || PulseTracks.Num() > 0 || Replayer.IsValid() || bBatchedUpdatesDeferred)
+	{
+		return true;
+	}
+	// Stand-in clocks and audio feeds step their clocks from the tick.
+	return Clocks.ContainsByPredicate([](const FQuartzVisualClockState& Clock) { return Clock.IsSimulated() || Clock.AudioBeatFeed.IsValid(); });
 }
 
 void UQuartzVisualSubsystem::InitializeQuartzVisualSubsystem()
@@ -111,185 +447,1772 @@ void UQuartzVisualSubsystem::InitializeQuartzVisualSubsystem()
 	}
 }
 
-void UQuartzVisualSubsystem::SubscribeToQuantization(UObject* WorldContextObject, UQuartzClockHandle* QuartzClockHandle, EQuartzCommandQuantization Quantization)
+void UQuartzVisualSubsystem::SubscribeToQuantization(UObject* WorldContextObject, UQuartzClockHandle* QuartzClockHandle, EQuartzCommandQuantization Quantization, EQuartzCommandQuantization AdaptiveQuantization)
 {
 	if(WorldContextObject && QuartzClockHandle)
 	{
-		CachedQuartzClockHandle = QuartzClockHandle;
-		QuartzMetronomeEvent = FOnQuartzMetronomeEventBP();
-		QuartzMetronomeEvent.BindUFunction(this, "OnQuantizationEvent");
-		CurrentBeatCount = 0;
-		CurrentBeatCountFull = -1;
-		QuartzClockHandle->SubscribeToQuantizationEvent(WorldContextObject, EQuartzCommandQuantization::ThirtySecondNote, QuartzMetronomeEvent,QuartzClockHandle);
+		const int32 ClockIndex = ClaimQuartzVisualClock(QuartzClockHandle->GetClockName());
+		FQuartzVisualClockState& Clock = Clocks[ClockIndex];
+		Clock.SimulatedBeatsPerMinute = 0.0f;
+		if(Clock.ClockHandle)
+		{
+			Clock.ClockHandle->UnsubscribeFromTimeDivision(this, Clock.EventQuantization, Clock.ClockHandle);
+		}
+		Clock.ClockHandle = QuartzClockHandle;
+		Clock.MetronomeEvent = FOnQuartzMetronomeEventBP();
+		Clock.MetronomeEvent.BindUFunction(this, "OnQuantizationEvent");
+		Clock.CurrentBeatCount = 0;
+		Clock.CurrentBeatCountFull = -1;
+		Clock.LastStep = INDEX_NONE;
+		Clock.Quantization = Quantization == EQuartzCommandQuantization::None ? EQuartzCommandQuantization::ThirtySecondNote : Quantization;
+		Clock.CoarseQuantization = AdaptiveQuantization;
+		Clock.Phase.Reset();
+		UpdateQuartzVisualClockTiming(ClockIndex);
+
+		// Adaptive only helps if the coarse events are actually coarser, and starts fine if short pulses are already waiting.
+		if(Clock.StepsPerCoarseEvent <= 1)
+		{
+			Clock.CoarseQuantization = EQuartzCommandQuantization::None;
+		}
+		const bool bCoarse = Clock.CoarseQuantization != EQuartzCommandQuantization::None && HasShortQuartzVisualPulses(ClockIndex) == false;
+		Clock.EventQuantization = bCoarse ? Clock.CoarseQuantization : Clock.Quantization;
+		Clock.bIdle = false;
+		QuartzClockHandle->SubscribeToQuantizationEvent(WorldContextObject, Clock.EventQuantization, Clock.MetronomeEvent, QuartzClockHandle);
+		UpdateQuartzVisualClockIdle(ClockIndex);
 	}
 }
 
-DECLARE_CYCLE_STAT(TEXT("Quartz Visual Quantization"), STAT_QuartzVisualQuantization, STATGROUP_QuartzVisuals);
-void UQuartzVisualSubsystem::OnQuantizationEvent(FName ClockName, EQuartzCommandQuantization QuantizationType, int32 NumBars, int32 Beat, float BeatFraction)
-{	
-	// Handle Quantized visual data. Thirty second notes should be smooth enough for this.
-	CurrentBeatCount = Beat - 1;
-	CurrentBeatCountFull++;
-
-	// Delta time multiplier for interp usage based on BPM.
-	if(CachedQuartzClockHandle)
+void UQuartzVisualSubsystem::StartSimulatedQuartzVisualClock(FName ClockName, float BeatsPerMinute, EQuartzCommandQuantization Quantization, int32 BeatsPerBar)
+{
+	if(BeatsPerMinute <= 0.0f)
 	{
-		 DeltaTimeMultiplier = CachedQuartzClockHandle->GetBeatsPerMinute(this)/120.0f;
+		return;
 	}
-	else
+	const int32 ClockIndex = ClaimQuartzVisualClock(ClockName);
+	FQuartzVisualClockState& Clock = Clocks[ClockIndex];
+	if(Clock.ClockHandle)
 	{
-		DeltaTimeMultiplier = 1.0f;
+		Clock.ClockHandle->UnsubscribeFromTimeDivision(this, Clock.EventQuantization, Clock.ClockHandle);
+		Clock.ClockHandle = nullptr;
 	}
-	
-	// Visual Quantization 
-	if(GQuartzVisualsEnableLogs)
+	Clock.SimulatedBeatsPerMinute = BeatsPerMinute;
+	Clock.SimulatedSeconds = 0.0;
+	Clock.SimulatedStep = INDEX_NONE;
+	Clock.CurrentBeatCount = 0;
+	Clock.CurrentBeatCountFull = -1;
+	Clock.LastStep = INDEX_NONE;
+	Clock.Quantization = Quantization == EQuartzCommandQuantization::None ? EQuartzCommandQuantization::ThirtySecondNote : Quantization;
+	Clock.CoarseQuantization = EQuartzCommandQuantization::None;
+	Clock.EventQuantization = Clock.Quantization;
+	Clock.BeatsPerBar = static_cast<float>(FMath::Max(BeatsPerBar, 1));
+	Clock.Phase.Reset();
+	UpdateQuartzVisualClockTiming(ClockIndex);
+}
+
+void UQuartzVisualSubsystem::StopSimulatedQuartzVisualClock(FName ClockName)
+{
+	const int32 ClockIndex = Clocks.IndexOfByPredicate([ClockName](const FQuartzVisualClockState& Clock) { return Clock.ClockName == ClockName; });
+	if(ClockIndex != INDEX_NONE)
 	{
-		UE_LOG(LogQuartzVisuals, Log, TEXT("-----------"));
-		UE_LOG(LogQuartzVisuals, Log, TEXT("Visual Beat Count %d : %d"), CurrentBeatCount, CurrentBeatCountFull);
+		// Pulses stay where they are, the same as a quartz clock that stopped.
+		Clocks[ClockIndex].SimulatedBeatsPerMinute = 0.0f;
 	}
+}
 
-	for(int32 Index = 0; Index < QuartzVisualEntries.Num(); Index++)
+void UQuartzVisualSubsystem::AdvanceSimulatedQuartzVisualClocks(float DeltaTime)
+{
+	for(int32 ClockIndex = 0; ClockIndex < Clocks.Num(); ClockIndex++)
 	{
-		SCOPE_CYCLE_COUNTER(STAT_QuartzVisualQuantization);
-		TRACE_CPUPROFILER_EVENT_SCOPE(STAT_QuartzVisualQuantization)
-		FQuartzVisualPulseEntry& PulseEntry = QuartzVisualEntries[Index];
-		if((PulseEntry.Data.CurrentBeatCount - PulseEntry.Data.BeatOffset) == 0 && IsValid(PulseEntry.Data.Actor)/* && PulseEntry.Actor->Implements<IQuartzVisualsInterface>()*/)
+		if(Clocks[ClockIndex].IsSimulated() == false || Clocks[ClockIndex].StepsPerSecond <= 0.0f)
 		{
-			if(IsValid(PulseEntry.Data.Actor))
-			{
-				// Force value to update to current desired amount almost all curves should start at 0.0f, but we  will have to play with it.
-                PulseEntry.UpdateValue(1.0f);
-                // Send out visual update.
-				PulseEntry.State = EQuartzVisualPulseState::Start;
-				IQuartzVisualsInterface::Execute_OnQuartzVisualUpdate(PulseEntry.Data.Actor, PulseEntry);
-			}
+			continue;
 		}
-
-		if(PulseEntry.GetBeatProgress() == 1.0f || IsValid(PulseEntry.Data.Actor) == false)
+		Clocks[ClockIndex].SimulatedSeconds += DeltaTime;
+		const int32 TargetStep = FMath::FloorToInt32(Clocks[ClockIndex].SimulatedSeconds * Clocks[ClockIndex].StepsPerSecond);
+		// One event per step like quartz sends them, the events may stop the clock.
+		while(Clocks[ClockIndex].IsSimulated() && Clocks[ClockIndex].SimulatedStep < TargetStep)
 		{
-			CancelAndFinishQuartzVisualEntry(PulseEntry);
-			if(QuartzVisualEntries.IsValidIndex(Index))
-			{
-				QuartzVisualEntries.RemoveAt(Index);
-			}
-           	Index--;
-           	continue;
+			const int32 Step = ++Clocks[ClockIndex].SimulatedStep;
+			const double Beats = static_cast<double>(Step) / static_cast<double>(Clocks[ClockIndex].StepsPerBeat);
+			const double BeatsPerBar = static_cast<double>(Clocks[ClockIndex].BeatsPerBar);
+			const int32 NumBars = FMath::FloorToInt32(Beats / BeatsPerBar);
+			const double BeatInBar = Beats - static_cast<double>(NumBars) * BeatsPerBar;
+			const int32 Beat = FMath::FloorToInt32(BeatInBar);
+			OnQuantizationEvent(Clocks[ClockIndex].ClockName, Clocks[ClockIndex].Quantization, NumBars, Beat + 1, static_cast<float>(BeatInBar - static_cast<double>(Beat)));
 		}
-		
-		PulseEntry.Data.CurrentBeatCount++;
 	}
 }
 
-DECLARE_CYCLE_STAT(TEXT("Quartz Visual Update"), STAT_QuartzVisualUpdate, STATGROUP_QuartzVisuals);
-void UQuartzVisualSubsystem::UpdateQuartzVisualPulseEntries(float DeltaTime)
+int32 UQuartzVisualSubsystem::ClaimQuartzVisualClock(FName ClockName)
 {
-	for(int32 Index = 0; Index < QuartzVisualEntries.Num(); Index++)
+	int32 ClockIndex = Clocks.IndexOfByPredicate([ClockName](const FQuartzVisualClockState& Clock) { return Clock.ClockName == ClockName; });
+	if(ClockIndex == INDEX_NONE)
 	{
-		FQuartzVisualPulseEntry& PulseEntry = QuartzVisualEntries[Index];
-		if(PulseEntry.State != EQuartzVisualPulseState::ReadyToStart && IsValid(PulseEntry.Data.Actor))
+		// The first clock subscribed takes the default slot, pulses without a clock name may already be waiting on it.
+		ClockIndex = FindOrAddQuartzVisualClock(NAME_None);
+		if(Clocks[ClockIndex].ClockName.IsNone() == false)
 		{
-			SCOPE_CYCLE_COUNTER(STAT_QuartzVisualUpdate);
-			TRACE_CPUPROFILER_EVENT_SCOPE(STAT_QuartzVisualUpdate)
-			PulseEntry.UpdateValue(DeltaTime * DeltaTimeMultiplier);
-			PulseEntry.State = EQuartzVisualPulseState::Updating;
-			IQuartzVisualsInterface::Execute_OnQuartzVisualUpdate(PulseEntry.Data.Actor, PulseEntry);
+			ClockIndex = FindOrAddQuartzVisualClock(ClockName);
 		}
+		Clocks[ClockIndex].ClockName = ClockName;
 	}
+	return ClockIndex;
 }
 
-void UQuartzVisualSubsystem::AddNewQuartzVisualPulse(AActor* InActor, FQuartzVisualPulseSettings QuantizedVisualPulseSettings, int32 BeatDuration, int32 BeatOffset, bool StopIfExists)
+int32 UQuartzVisualSubsystem::FindOrAddQuartzVisualClock(FName ClockName)
 {
-	if(UKismetSystemLibrary::DoesImplementInterface(InActor, UQuartzVisualsInterface::StaticClass()) == false)
+	if(Clocks.Num() == 0)
+	{
+		Clocks.AddDefaulted();
+	}
+	if(ClockName.IsNone())
+	{
+		return 0;
+	}
+	const int32 ClockIndex = Clocks.IndexOfByPredicate([ClockName](const FQuartzVisualClockState& Clock) { return Clock.ClockName == ClockName; });
+	if(ClockIndex != INDEX_NONE)
+	{
+		return ClockIndex;
+	}
+	FQuartzVisualClockState NewClock;
+	NewClock.ClockName = ClockName;
+	return Clocks.Add(NewClock);
+}
+
+void UQuartzVisualSubsystem::UpdateQuartzVisualClockTiming(int32 ClockIndex)
+{
+	FQuartzVisualClockState& Clock = Clocks[ClockIndex];
+
+	// Replayed clocks get their timing from the recording.
+	if(Replayer.IsValid())
 	{
-		UE_LOG(LogQuartzVisuals, Warning, TEXT("Does not implement quartz visual interface"));
 		return;
 	}
-	
-	FQuartzVisualPulseEntry NewEntry = FQuartzVisualPulseEntry();
-	NewEntry.Settings = QuantizedVisualPulseSettings;
-	NewEntry.Data.BeatOffset = BeatOffset;
-	NewEntry.Data.BeatDuration = BeatDuration;
-	NewEntry.Data.Actor = InActor;
-	NewEntry.State = EQuartzVisualPulseState::ReadyToStart;
 
-	const int32 Index = QuartzVisualEntries.IndexOfByPredicate([NewEntry] (const FQuartzVisualPulseEntry& VisualPulseSettings)
+	// Delta time multiplier for interp usage based on BPM.
+	Clock.bTimingDirty = false;
+	if(Clock.ClockHandle)
 	{
-		return VisualPulseSettings == NewEntry;
-	});
-	
-	if(StopIfExists && QuartzVisualEntries.IsValidIndex(Index))
+		Clock.TimingBeatsPerMinute = Clock.ClockHandle->GetBeatsPerMinute(this);
+		Clock.DeltaTimeMultiplier = Clock.TimingBeatsPerMinute/120.0f;
+	}
+	else
+	{
+		Clock.DeltaTimeMultiplier = 1.0f;
+	}
+
+	// Stand-in clocks know their timing without asking quartz, the time signature is set when they start.
+	if(Clock.IsSimulated())
 	{
+		const float StepBeats = QuartzVisualSubsystemPrivate::GetQuantizationBeats(Clock.Quantization, FMath::RoundToInt(Clock.BeatsPerBar));
+		Clock.DeltaTimeMultiplier = Clock.SimulatedBeatsPerMinute / 120.0f;
+		Clock.StepsPerBeat = 1.0f / StepBeats;
+		Clock.StepsPerSecond = Clock.SimulatedBeatsPerMinute / 60.0f * Clock.StepsPerBeat;
+		Clock.StepsPerCoarseEvent = 1;
 		return;
 	}
-	
-	if(QuartzVisualEntries.IsValidIndex(Index))
+
+	// Ratios between quantizations follow the time signature, the step length follows the tempo.
+	UQuartzSubsystem* QuartzSubsystem = UQuartzSubsystem::Get(GetWorld());
+	if(QuartzSubsystem == nullptr)
 	{
-		// Cancel if the entry already exists.
-		if(GQuartzVisualsEnableLogs)
-		{
-			UE_LOG(LogQuartzVisuals, Log, TEXT("-----------------------"));
-			UE_LOG(LogQuartzVisuals, Log, TEXT("Add new entry %s"), *NewEntry.ToString());
-			UE_LOG(LogQuartzVisuals, Log, TEXT("-----------------------"));
-		}
-		CancelAndFinishQuartzVisualEntry(QuartzVisualEntries[Index]);
-		QuartzVisualEntries[Index] = NewEntry;
+		return;
 	}
-	else
+	const float StepSeconds = QuartzSubsystem->GetDurationOfQuantizationTypeInSeconds(this, Clock.ClockName, Clock.Quantization);
+	const float BeatSeconds = QuartzSubsystem->GetDurationOfQuantizationTypeInSeconds(this, Clock.ClockName, EQuartzCommandQuantization::Beat);
+	const float BarSeconds = QuartzSubsystem->GetDurationOfQuantizationTypeInSeconds(this, Clock.ClockName, EQuartzCommandQuantization::Bar);
+	if(StepSeconds > UE_SMALL_NUMBER && BeatSeconds > UE_SMALL_NUMBER)
 	{
-		if(GQuartzVisualsEnableLogs)
+		Clock.StepsPerSecond = 1.0f / StepSeconds;
+		Clock.StepsPerBeat = BeatSeconds / StepSeconds;
+		Clock.BeatsPerBar = BarSeconds / BeatSeconds;
+		if(Clock.CoarseQuantization != EQuartzCommandQuantization::None)
 		{
-			UE_LOG(LogQuartzVisuals, Log, TEXT("-----------------------"));
-			UE_LOG(LogQuartzVisuals, Log, TEXT("Add new quarts entry %s"), *NewEntry.ToString());
-			UE_LOG(LogQuartzVisuals, Log, TEXT("-----------------------"));
+			const float CoarseSeconds = QuartzSubsystem->GetDurationOfQuantizationTypeInSeconds(this, Clock.ClockName, Clock.CoarseQuantization);
+			Clock.StepsPerCoarseEvent = FMath::Max(FMath::RoundToInt(CoarseSeconds / StepSeconds), 1);
+		}
+		else
+		{
+			Clock.StepsPerCoarseEvent = 1;
 		}
-		QuartzVisualEntries.Add(NewEntry);
 	}
+}
 
+void UQuartzVisualSubsystem::SetQuartzVisualClockEventQuantization(int32 ClockIndex, EQuartzCommandQuantization EventQuantization)
+{
+	FQuartzVisualClockState& Clock = Clocks[ClockIndex];
+	if(Clock.EventQuantization == EventQuantization || Clock.ClockHandle == nullptr)
+	{
+		return;
+	}
+	if(GQuartzVisualsEnableLogs)
+	{
+		UE_LOG(LogQuartzVisuals, Log, TEXT("Clock %s switching to %s events"), *Clock.ClockName.ToString(), *UEnum::GetValueAsString(EventQuantization));
+	}
+	// Events from the old subscription can still arrive, their steps are already processed so they do nothing.
+	Clock.ClockHandle->UnsubscribeFromTimeDivision(this, Clock.EventQuantization, Clock.ClockHandle);
+	Clock.EventQuantization = EventQuantization;
+	Clock.bTimingDirty = true;
+	Clock.ClockHandle->SubscribeToQuantizationEvent(this, EventQuantization, Clock.MetronomeEvent, Clock.ClockHandle);
+	if(Recorder.IsRecording())
+	{
+		Recorder.RecordClock(Clock);
+	}
 }
 
-void UQuartzVisualSubsystem::RemoveQuartzVisualPulseFromActor(int32 Index, int32 IndexFilter, AActor* InActor)
+void UQuartzVisualSubsystem::UpdateQuartzVisualClockIdle(int32 ClockIndex)
 {
-	for(int32 EntryIndex = 0; EntryIndex < QuartzVisualEntries.Num(); EntryIndex++)
+	FQuartzVisualClockState& Clock = Clocks[ClockIndex];
+	bool bIdle = GQuartzVisualsIdleBarEvents && Clock.ClockHandle && Clock.AudioBeatFeed.IsValid() == false && QuartzVisualEntries.GetClockBucket(ClockIndex).Num() == 0;
+	// Tracks count their steps from the clock, it can't fall behind between their pulses.
+	for(const FQuartzVisualPulseTrackPlayback& Playback : PulseTracks)
+	{
+		bIdle &= Playback.ClockIndex != ClockIndex;
+	}
+	if(bIdle == Clock.bIdle)
+	{
+		return;
+	}
+
+	Clock.bIdle = bIdle;
+	if(bIdle)
+	{
+		SetQuartzVisualClockEventQuantization(ClockIndex, EQuartzCommandQuantization::Bar);
+		return;
+	}
+	// Bar events left the steps behind, the next event starts the clock over and the new pulses count from there.
+	Clock.LastStep = INDEX_NONE;
+	const bool bCoarse = Clock.CoarseQuantization != EQuartzCommandQuantization::None && HasShortQuartzVisualPulses(ClockIndex) == false;
+	SetQuartzVisualClockEventQuantization(ClockIndex, bCoarse ? Clock.CoarseQuantization : Clock.Quantization);
+}
+
+DECLARE_DWORD_COUNTER_STAT(TEXT("Quantization Events"), STAT_QuartzVisualQuantizationEvents, STATGROUP_QuartzVisuals);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Extrapolated Steps"), STAT_QuartzVisualExtrapolatedSteps, STATGROUP_QuartzVisuals);
+DECLARE_CYCLE_STAT(TEXT("Quartz Visual Quantization Event"), STAT_QuartzVisualQuantizationEvent, STATGROUP_QuartzVisuals);
+void UQuartzVisualSubsystem::OnQuantizationEvent(FName ClockName, EQuartzCommandQuantization QuantizationType, int32 NumBars, int32 Beat, float BeatFraction)
+{	
+	SCOPE_CYCLE_COUNTER(STAT_QuartzVisualQuantizationEvent);
+	INC_DWORD_STAT(STAT_QuartzVisualQuantizationEvents);
+
+	ProcessQuartzVisualCommands();
+	StreamQuartzVisualPulseTracks();
+
+	const int32 ClockIndex = Clocks.IndexOfByPredicate([ClockName](const FQuartzVisualClockState& Clock) { return Clock.ClockName == ClockName; });
+	if(ClockIndex == INDEX_NONE)
+	{
+		return;
+	}
+
+	Clocks[ClockIndex].CurrentBeatCount = Beat - 1;
+	// One tempo query per event instead of the four durations, those only change with the tempo or time signature.
+	const FQuartzVisualClockState& TimedClock = Clocks[ClockIndex];
+	if(TimedClock.bTimingDirty || (TimedClock.ClockHandle && TimedClock.ClockHandle->GetBeatsPerMinute(this) != TimedClock.TimingBeatsPerMinute))
 	{
-		FQuartzVisualPulseEntry& QuantizedVisual = QuartzVisualEntries[EntryIndex];
-		if(QuantizedVisual.Data.Actor == InActor && QuantizedVisual.Settings.Index == Index && QuantizedVisual.Settings.IndexFilter == IndexFilter)
+		UpdateQuartzVisualClockTiming(ClockIndex);
+	}
+	if(Recorder.IsRecording())
+	{
+		Recorder.RecordClock(Clocks[ClockIndex]);
+		Recorder.RecordEvent(ClockName, QuantizationType, NumBars, Beat, BeatFraction);
+	}
+
+	// Position of the event in steps from its bar and beat, so coarse, fine and late events all agree on it.
+	const FQuartzVisualClockState& Clock = Clocks[ClockIndex];
+	const double EventBeats = static_cast<double>(NumBars) * Clock.BeatsPerBar + static_cast<double>(Beat - 1) + static_cast<double>(BeatFraction);
+	const int32 EventStep = FMath::RoundToInt(EventBeats * static_cast<double>(Clock.StepsPerBeat));
+
+	if(Clock.AudioBeatFeed.IsValid())
+	{
+		// The feed steps the clock, events number its steps and correct its phase.
+		Clock.AudioBeatFeed->SetStepsPerSecond(Clock.StepsPerSecond);
+		if(Clock.LastStep == INDEX_NONE || FMath::Abs(EventStep - Clock.LastStep) > FMath::Max(Clock.StepsPerCoarseEvent * 2, 4))
 		{
-			CancelAndFinishQuartzVisualEntry(QuantizedVisual);
-			QuartzVisualEntries.RemoveAt(EntryIndex);
-			EntryIndex--;
-			continue;
+			Clock.AudioBeatFeed->Anchor(EventStep);
+			AdvanceQuartzVisualClockTo(ClockIndex, EventStep, 0.0f);
+		}
+		else
+		{
+			Clock.AudioBeatFeed->Correct(EventStep, GQuartzVisualsAudioFeedMaxDrift);
 		}
+		return;
+	}
+
+	AdvanceQuartzVisualClockTo(ClockIndex, EventStep, 0.0f);
+
+	// Back to coarse events once the short pulses are done, checked once per coarse interval.
+	const FQuartzVisualClockState& SteppedClock = Clocks[ClockIndex];
+	if(SteppedClock.CoarseQuantization != EQuartzCommandQuantization::None && SteppedClock.IsExtrapolating() == false
+		&& EventStep % SteppedClock.StepsPerCoarseEvent == 0 && HasShortQuartzVisualPulses(ClockIndex) == false)
+	{
+		SetQuartzVisualClockEventQuantization(ClockIndex, Clocks[ClockIndex].CoarseQuantization);
 	}
+	// Clocks nothing follows anymore drop to bar events until the next pulse.
+	UpdateQuartzVisualClockIdle(ClockIndex);
 }
 
-void UQuartzVisualSubsystem::RemoveAllQuartzVisualPulsesFromActor(AActor* InActor, TArray<int32> ExcludeIndexFilters)
+void UQuartzVisualSubsystem::AdvanceQuartzVisualClockTo(int32 ClockIndex, int32 EventStep, float AgeSeconds)
 {
-	for(int32 Index = 0; Index < QuartzVisualEntries.Num(); Index++)
+	// Start over after the first event or a jump (clock restarted, time signature change), otherwise catch up on every step up to this one.
+	const FQuartzVisualClockState& Clock = Clocks[ClockIndex];
+	const int32 MaxCatchUpSteps = FMath::Max(Clock.StepsPerCoarseEvent, 1) * 2;
+	const bool bRestart = Clock.LastStep == INDEX_NONE || FMath::Abs(EventStep - Clock.LastStep) > MaxCatchUpSteps;
+	if(bRestart)
 	{
-		FQuartzVisualPulseEntry& QuantizedVisual = QuartzVisualEntries[Index];
-		if(QuantizedVisual.Data.Actor == InActor && ExcludeIndexFilters.Contains(QuantizedVisual.Settings.IndexFilter) == false)
+		// Playing tracks move with the pulses they already added.
+		const int32 RebaseDelta = EventStep - 1 - QuartzVisualEntries.GetClockStep(ClockIndex);
+		for(FQuartzVisualPulseTrackPlayback& Playback : PulseTracks)
 		{
-			CancelAndFinishQuartzVisualEntry(QuantizedVisual);
-			QuartzVisualEntries.RemoveAt(Index);
-			Index--;
-			continue;
+			if(Playback.ClockIndex == ClockIndex && Playback.StartStep != INDEX_NONE)
+			{
+				Playback.StartStep += RebaseDelta;
+			}
 		}
+		// A jump can be a time signature change, the next event asks quartz for the timing again.
+		Clocks[ClockIndex].bTimingDirty |= Clock.LastStep != INDEX_NONE;
+		Clocks[ClockIndex].LastStep = EventStep - 1;
+		QuartzVisualEntries.RebaseClock(ClockIndex, EventStep - 1);
+	}
+	// Duplicate events (fine and coarse on the same boundary while switching) don't move the estimate back.
+	if(bRestart || EventStep > Clock.Phase.GetLastStep())
+	{
+		Clocks[ClockIndex].Phase.OnStep(EventStep, Clock.StepsPerSecond, AgeSeconds);
+	}
+
+	while(Clocks[ClockIndex].LastStep < EventStep)
+	{
+		StepQuartzVisualClock(ClockIndex, Clocks[ClockIndex].LastStep + 1);
 	}
 }
 
-void UQuartzVisualSubsystem::RemoveAllQuartzVisualPulses()
+bool UQuartzVisualSubsystem::SetQuartzVisualAudioBeatFeedEnabled(FName ClockName, bool bEnabled)
 {
-	for(int32 Index = 0; Index < QuartzVisualEntries.Num(); Index++)
+	const int32 ClockIndex = Clocks.IndexOfByPredicate([ClockName](const FQuartzVisualClockState& Clock) { return Clock.ClockName == ClockName; });
+	if(ClockIndex == INDEX_NONE || Clocks[ClockIndex].AudioBeatFeed.IsValid() == bEnabled)
+	{
+		return ClockIndex != INDEX_NONE;
+	}
+
+	FAudioDeviceHandle AudioDevice = GetWorld() ? GetWorld()->GetAudioDevice() : FAudioDeviceHandle();
+	if(AudioDevice.IsValid() == false)
+	{
+		// -nosound, the clock keeps following its events.
+		return false;
+	}
+
+	FQuartzVisualClockState& Clock = Clocks[ClockIndex];
+	if(bEnabled)
 	{
-		FQuartzVisualPulseEntry& QuantizedVisual = QuartzVisualEntries[Index];
-		CancelAndFinishQuartzVisualEntry(QuantizedVisual);
-		QuartzVisualEntries.RemoveAt(Index);
-		Index--;
-		continue;
+		Clock.AudioBeatFeed = MakeShared<FQuartzVisualAudioBeatFeed, ESPMode::ThreadSafe>();
+		Clock.AudioBeatFeed->SetStepsPerSecond(Clock.StepsPerSecond);
+		// Anchored on the clock's next event. Adaptive clocks stay on coarse events, the feed fills in every step.
+		Clock.LastStep = INDEX_NONE;
+		UpdateQuartzVisualClockIdle(ClockIndex);
+		if(Clock.CoarseQuantization != EQuartzCommandQuantization::None)
+		{
+			SetQuartzVisualClockEventQuantization(ClockIndex, Clock.CoarseQuantization);
+		}
+		AudioDevice->RegisterSubmixBufferListener(Clock.AudioBeatFeed.Get());
+	}
+	else
+	{
+		ReleaseQuartzVisualAudioBeatFeed(AudioDevice, Clock.AudioBeatFeed);
+		Clock.LastStep = INDEX_NONE;
+	}
+	if(Recorder.IsRecording())
+	{
+		Recorder.RecordClock(Clock);
 	}
+	return true;
+}
+
+void UQuartzVisualSubsystem::ReleaseQuartzVisualAudioBeatFeed(FAudioDeviceHandle& AudioDevice, TSharedPtr<FQuartzVisualAudioBeatFeed, ESPMode::ThreadSafe>& AudioBeatFeed)
+{
+	AudioDevice->UnregisterSubmixBufferListener(AudioBeatFeed.Get());
+	// Unregistering happens on the render thread, the feed has to live until it has.
+	static_cast<Audio::FMixerDevice*>(AudioDevice.GetAudioDevice())->AudioRenderThreadCommand([AudioBeatFeed]() {});
+	AudioBeatFeed.Reset();
+}
+
+FString UQuartzVisualSubsystem::GetQuartzVisualRecordingPath(const FString& FileName)
+{
+	FString FilePath = FPaths::IsRelative(FileName) ? FPaths::Combine(FPaths::ProfilingDir(), TEXT("QuartzVisuals"), FileName) : FileName;
+	if(FPaths::GetExtension(FilePath).IsEmpty())
+	{
+		FilePath += TEXT(".qvrec");
+	}
+	return FilePath;
+}
+
+bool UQuartzVisualSubsystem::StartQuartzVisualRecording(const FString& FileName)
+{
+	const FString FilePath = GetQuartzVisualRecordingPath(FileName);
+	if(Recorder.Start(FilePath) == false)
+	{
+		return false;
+	}
+	UE_LOG(LogQuartzVisuals, Log, TEXT("Recording quartz visuals to %s"), *FilePath);
+	// Clocks already running start the recording with their timing, pulses already active are not in it.
+	for(const FQuartzVisualClockState& Clock : Clocks)
+	{
+		Recorder.RecordClock(Clock);
+	}
+	return true;
+}
+
+void UQuartzVisualSubsystem::StopQuartzVisualRecording()
+{
+	Recorder.Stop();
+}
+
+bool UQuartzVisualSubsystem::StartQuartzVisualReplay(const FString& FileName, bool bRealTime)
+{
+	StopQuartzVisualReplay();
+	const FString FilePath = GetQuartzVisualRecordingPath(FileName);
+	TUniquePtr<FQuartzVisualReplayer> NewReplayer = MakeUnique<FQuartzVisualReplayer>();
+	if(NewReplayer->Open(FilePath, GetWorld()) == false)
+	{
+		return false;
+	}
+
+	RemoveAllQuartzVisualPulses();
+	Replayer = MoveTemp(NewReplayer);
+	if(bRealTime == false)
+	{
+		const double StartSeconds = FPlatformTime::Seconds();
+		Replayer->Replay(*this, TNumericLimits<double>::Max());
+		UE_LOG(LogQuartzVisuals, Log, TEXT("Replayed %d frames of %s in %.3f seconds"), Replayer->GetNumFrames(), *FilePath, FPlatformTime::Seconds() - StartSeconds);
+		StopQuartzVisualReplay();
+	}
+	return true;
+}
+
+void UQuartzVisualSubsystem::StopQuartzVisualReplay()
+{
+	if(Replayer.IsValid())
+	{
+		// Stand-ins go with the pulses they were getting.
+		RemoveAllQuartzVisualPulses();
+		Replayer->DestroyStandIns();
+		Replayer.Reset();
+	}
+}
+
+bool UQuartzVisualSubsystem::ImportQuartzVisualMidiTrack(const FString& MidiFile, const FString& TrackFile, int32 StepsPerBeat)
+{
+	const FString MidiFilePath = FPaths::IsRelative(MidiFile) ? FPaths::ConvertRelativePathToFull(FPaths::ProjectDir(), MidiFile) : MidiFile;
+	FString Error;
+	if(QuartzVisualMidiImporter::ImportMidiFile(MidiFilePath, GetQuartzVisualPulseTrackPath(TrackFile), StepsPerBeat, Error) == false)
+	{
+		UE_LOG(LogQuartzVisuals, Warning, TEXT("Importing %s failed: %s"), *MidiFilePath, *Error);
+		return false;
+	}
+	return true;
+}
+
+FString UQuartzVisualSubsystem::GetQuartzVisualPulseTrackPath(const FString& FileName)
+{
+	FString FilePath = FPaths::IsRelative(FileName) ? FPaths::Combine(FPaths::ProjectContentDir(), TEXT("PulseTracks"), FileName) : FileName;
+	if(FPaths::GetExtension(FilePath).IsEmpty())
+	{
+		FilePath += TEXT(".qvtrack");
+	}
+	return FilePath;
+}
+
+int32 UQuartzVisualSubsystem::PlayQuartzVisualPulseTrack(const TArray<AActor*>& Actors, const FString& TrackFile, const FQuartzVisualPulseSettings& QuantizedVisualPulseSettings, int32 BeatOffset)
+{
+	FQuartzVisualPulseTrackPlayback Playback;
+	if(Playback.Track.Open(GetQuartzVisualPulseTrackPath(TrackFile)) == false)
+	{
+		return INDEX_NONE;
+	}
+	for(AActor* Actor : Actors)
+	{
+		if(IsValid(Actor))
+		{
+			Playback.Actors.AddUnique(Actor);
+		}
+	}
+	Playback.Settings = QuantizedVisualPulseSettings;
+	Playback.ClockIndex = FindOrAddQuartzVisualClock(QuantizedVisualPulseSettings.ClockName);
+	Playback.BeatOffset = FMath::Max(BeatOffset, 0);
+	const int32 TrackId = PulseTracks.Add(MoveTemp(Playback));
+
+	// The first pulses go in right away when the clock is already running.
+	StreamQuartzVisualPulseTracks();
+	return TrackId;
+}
+
+void UQuartzVisualSubsystem::StopQuartzVisualPulseTrack(int32 TrackId)
+{
+	if(PulseTracks.IsValidIndex(TrackId))
+	{
+		PulseTracks.RemoveAt(TrackId);
+	}
+}
+
+DECLARE_DWORD_COUNTER_STAT(TEXT("Track Pulses"), STAT_QuartzVisualTrackPulses, STATGROUP_QuartzVisuals);
+void UQuartzVisualSubsystem::StreamQuartzVisualPulseTracks()
+{
+	TArray<AActor*> Actors;
+	for(auto It = PulseTracks.CreateIterator(); It; ++It)
+	{
+		FQuartzVisualPulseTrackPlayback& Playback = *It;
+		if(Clocks[Playback.ClockIndex].LastStep == INDEX_NONE)
+		{
+			continue;
+		}
+		const int32 ClockStep = QuartzVisualEntries.GetClockStep(Playback.ClockIndex);
+		if(Playback.StartStep == INDEX_NONE)
+		{
+			Playback.StartStep = ClockStep + 1 + Playback.BeatOffset;
+		}
+
+		// Tracks keep the resolution they were imported at, the clock may step at another one.
+		const double StepScale = static_cast<double>(Clocks[Playback.ClockIndex].StepsPerBeat) / static_cast<double>(Playback.Track.GetHeader().StepsPerBeat);
+		const int32 WindowEnd = ClockStep + 1 + FMath::Max(GQuartzVisualsTrackLookaheadSteps, 0);
+		const TConstArrayView<FQuartzVisualTrackPulse> TrackPulses = Playback.Track.GetPulses();
+		FQuartzVisualPulseSettings Settings = Playback.Settings;
+		Actors.Reset();
+		while(Playback.Cursor < TrackPulses.Num())
+		{
+			const FQuartzVisualTrackPulse& TrackPulse = TrackPulses[Playback.Cursor];
+			const int32 PulseStep = Playback.StartStep + FMath::RoundToInt(static_cast<double>(TrackPulse.StartStep) * StepScale);
+			if(PulseStep > WindowEnd)
+			{
+				break;
+			}
+			Playback.Cursor++;
+
+			if(Actors.Num() == 0)
+			{
+				for(const TWeakObjectPtr<AActor>& Actor : Playback.Actors)
+				{
+					if(Actor.IsValid())
+					{
+						Actors.Add(Actor.Get());
+					}
+				}
+				if(Actors.Num() == 0)
+				{
+					// Every actor is gone, nothing left to play on.
+					Playback.Cursor = TrackPulses.Num();
+					break;
+				}
+			}
+
+			// Group pulses, so a note repeating before the last one finished doesn't replace it.
+			Settings.Index = TrackPulse.Note;
+			Settings.IndexFilter = TrackPulse.Channel;
+			Settings.Payload.IntData = TrackPulse.Velocity;
+			Settings.Payload.FloatData = static_cast<float>(TrackPulse.Velocity) / 127.0f;
+			const int32 BeatDuration = FMath::Max(FMath::RoundToInt(static_cast<double>(TrackPulse.DurationSteps) * StepScale), 1);
+			// Late pulses (a hitch longer than the lookahead) start on the next step.
+			AddNewQuartzVisualGroupPulse(Actors, Settings, BeatDuration, FMath::Max(PulseStep - ClockStep - 1, 0));
+			INC_DWORD_STAT(STAT_QuartzVisualTrackPulses);
+		}
+
+		if(Playback.Cursor >= TrackPulses.Num())
+		{
+			It.RemoveCurrent();
+		}
+	}
+}
+
+DECLARE_DWORD_COUNTER_STAT(TEXT("Audio Feed Steps"), STAT_QuartzVisualAudioFeedSteps, STATGROUP_QuartzVisuals);
+void UQuartzVisualSubsystem::ConsumeQuartzVisualAudioBeats()
+{
+	const double NowSeconds = FPlatformTime::Seconds();
+	for(int32 ClockIndex = 0; ClockIndex < Clocks.Num(); ClockIndex++)
+	{
+		FQuartzVisualAudioBeat AudioBeat;
+		// Steps can turn the feed off, it is looked up again every time.
+		while(Clocks[ClockIndex].AudioBeatFeed.IsValid() && Clocks[ClockIndex].LastStep != INDEX_NONE && Clocks[ClockIndex].AudioBeatFeed->DequeueDue(NowSeconds, AudioBeat))
+		{
+			if(AudioBeat.Step > Clocks[ClockIndex].LastStep)
+			{
+				INC_DWORD_STAT(STAT_QuartzVisualAudioFeedSteps);
+				if(Recorder.IsRecording())
+				{
+					Recorder.RecordStep(Clocks[ClockIndex].ClockName, AudioBeat.Step, static_cast<float>(NowSeconds - AudioBeat.PlatformSeconds));
+				}
+				AdvanceQuartzVisualClockTo(ClockIndex, AudioBeat.Step, static_cast<float>(NowSeconds - AudioBeat.PlatformSeconds));
+			}
+		}
+	}
+}
+
+void UQuartzVisualSubsystem::ExtrapolateQuartzVisualClocks(float DeltaTime)
+{
+	for(int32 ClockIndex = 0; ClockIndex < Clocks.Num(); ClockIndex++)
+	{
+		if(Clocks[ClockIndex].IsExtrapolating() == false || Clocks[ClockIndex].bIdle || Clocks[ClockIndex].Phase.IsLocked() == false || Clocks[ClockIndex].AudioBeatFeed.IsValid())
+		{
+			Clocks[ClockIndex].Phase.Advance(DeltaTime);
+			continue;
+		}
+
+		// The step on the next coarse boundary is left to the event itself, so extrapolation never runs ahead of the clock.
+		const int32 EventStep = Clocks[ClockIndex].Phase.GetLastStep();
+		const int32 StepsPerCoarseEvent = Clocks[ClockIndex].StepsPerCoarseEvent;
+		const int32 NextEventStep = EventStep + StepsPerCoarseEvent - ((EventStep % StepsPerCoarseEvent) + StepsPerCoarseEvent) % StepsPerCoarseEvent;
+		Clocks[ClockIndex].Phase.Advance(DeltaTime, NextEventStep - EventStep);
+		while(Clocks[ClockIndex].LastStep + 1 < NextEventStep && Clocks[ClockIndex].Phase.GetPosition() >= static_cast<double>(Clocks[ClockIndex].LastStep + 1))
+		{
+			INC_DWORD_STAT(STAT_QuartzVisualExtrapolatedSteps);
+			StepQuartzVisualClock(ClockIndex, Clocks[ClockIndex].LastStep + 1);
+		}
+	}
+}
+
+DECLARE_CYCLE_STAT(TEXT("Quartz Visual Quantization"), STAT_QuartzVisualQuantization, STATGROUP_QuartzVisuals);
+void UQuartzVisualSubsystem::StepQuartzVisualClock(int32 ClockIndex, int32 Step)
+{
+	// Handle Quantized visual data. Thirty second notes should be smooth enough for this.
+	SCOPE_CYCLE_COUNTER(STAT_QuartzVisualQuantization);
+	TRACE_CPUPROFILER_EVENT_SCOPE(STAT_QuartzVisualQuantization)
+	TRACE_CPUPROFILER_EVENT_SCOPE_ON_CHANNEL(QuartzVisualStep, QuartzVisualsChannel)
+	LLM_SCOPE_BYNAME(TEXT("QuartzVisuals"));
+	CSV_SCOPED_TIMING_STAT(QuartzVisuals, Step);
+	CSV_CUSTOM_STAT(QuartzVisuals, Steps, 1, ECsvCustomStatOp::Accumulate);
+	FQuartzVisualClockState& Clock = Clocks[ClockIndex];
+	Clock.LastStep = Step;
+	Clock.CurrentBeatCountFull++;
+
+	// Visual Quantization 
+	if(GQuartzVisualsEnableLogs)
+	{
+		UE_LOG(LogQuartzVisuals, Log, TEXT("-----------"));
+		UE_LOG(LogQuartzVisuals, Log, TEXT("Visual Beat Count %s %d : %d"), *Clock.ClockName.ToString(), Clock.CurrentBeatCount, Clock.CurrentBeatCountFull);
+	}
+
+	// Only the pulses starting or finishing on this step are visited. The clock's step is completed after the events,
+	// so pulses added from inside them with no offset still start on this step, the same as before. Loops until nothing new is due.
+	FQuartzVisualPulseHotData& Hot = QuartzVisualEntries.Hot;
+	FQuartzVisualDuePulses Starting;
+	FQuartzVisualDuePulses Finishing;
+	uint32 NumStarts = 0;
+	uint32 NumFinishes = 0;
+	QuartzVisualEntries.CollectDuePulses(ClockIndex, Step, Starting, Finishing);
+	while(Starting.Num() > 0 || Finishing.Num() > 0)
+	{
+		NumStarts += Starting.Num();
+		NumFinishes += Finishing.Num();
+		for(const FQuartzVisualPulseHandle& Handle : Starting)
+		{
+			// Earlier events may have removed it.
+			const int32 Index = QuartzVisualEntries.GetDenseIndex(Handle);
+			if(Index == INDEX_NONE)
+			{
+				continue;
+			}
+			if(Hot.Group[Index] != INDEX_NONE)
+			{
+				Hot.UpdateValue(Index, Step - 1, 1.0f, &CurveCache);
+				Hot.State[Index] = EQuartzVisualPulseState::Start;
+				SendQuartzVisualGroupUpdate(Index, Hot.Group[Index]);
+				continue;
+			}
+			AActor* Actor = Hot.Actor[Index];
+			if(IsValid(Actor)/* && PulseEntry.Actor->Implements<IQuartzVisualsInterface>()*/)
+			{
+				// Force value to update to current desired amount almost all curves should start at 0.0f, but we  will have to play with it.
+				Hot.UpdateValue(Index, Step - 1, 1.0f, &CurveCache);
+				// Send out visual update.
+				Hot.State[Index] = EQuartzVisualPulseState::Start;
+				if(Hot.InstanceSink[Index] != INDEX_NONE)
+				{
+					WriteQuartzVisualInstanceValue(Index);
+				}
+				else
+				{
+					QuartzVisualSubsystemPrivate::SendUpdate(Actor, Hot.NativeInterface[Index], QuartzVisualEntries.AssembleEntry(Index));
+				}
+			}
+			else
+			{
+				FinishQuartzVisualEntryAt(Index);
+				RemoveQuartzVisualEntry(Handle);
+			}
+		}
+
+		for(const FQuartzVisualPulseHandle& Handle : Finishing)
+		{
+			const int32 Index = QuartzVisualEntries.GetDenseIndex(Handle);
+			if(Index != INDEX_NONE)
+			{
+				FinishQuartzVisualEntryAt(Index);
+				// The finish event may have already removed it, the handle tells us either way.
+				RemoveQuartzVisualEntry(Handle);
+			}
+		}
+
+		Starting.Reset();
+		Finishing.Reset();
+		QuartzVisualEntries.CollectDuePulses(ClockIndex, Step, Starting, Finishing);
+	}
+	QuartzVisualEntries.SetClockStep(ClockIndex, Step);
+
+	INC_DWORD_STAT_BY(STAT_QuartzVisualStarts, NumStarts);
+	INC_DWORD_STAT_BY(STAT_QuartzVisualFinishes, NumFinishes);
+	UE_TRACE_LOG(QuartzVisuals, ClockStep, QuartzVisualsChannel)
+		<< ClockStep.Cycle(FPlatformTime::Cycles64())
+		<< ClockStep.Clock(ClockIndex)
+		<< ClockStep.Step(Step)
+		<< ClockStep.Starts(NumStarts)
+		<< ClockStep.Finishes(NumFinishes);
+
+	FlushQuartzVisualInstanceSinks();
+
+	if(GQuartzVisualsValidateLookup)
+	{
+		ensureMsgf(QuartzVisualEntries.Validate(), TEXT("Quartz visual lookup out of sync after quantization event"));
+	}
+}
+
+bool UQuartzVisualSubsystem::HasShortQuartzVisualPulses(int32 ClockIndex) const
+{
+	const FQuartzVisualPulseHotData& Hot = QuartzVisualEntries.Hot;
+	for(const FQuartzVisualPulseHandle& Handle : QuartzVisualEntries.GetClockBucket(ClockIndex))
+	{
+		if(Hot.BeatDuration[QuartzVisualEntries.GetDenseIndex(Handle)] < Clocks[ClockIndex].StepsPerCoarseEvent)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+DECLARE_CYCLE_STAT(TEXT("Quartz Visual Update"), STAT_QuartzVisualUpdate, STATGROUP_QuartzVisuals);
+void UQuartzVisualSubsystem::UpdateQuartzVisualPulseEntries(float DeltaTime)
+{
+	LLM_SCOPE_BYNAME(TEXT("QuartzVisuals"));
+	CSV_SCOPED_TIMING_STAT(QuartzVisuals, Update);
+	UpdateStartCycles = FPlatformTime::Cycles64();
+	ProcessQuartzVisualCommands();
+	StreamQuartzVisualPulseTracks();
+	AdvanceSimulatedQuartzVisualClocks(DeltaTime);
+	ConsumeQuartzVisualAudioBeats();
+	if(Recorder.IsRecording())
+	{
+		Recorder.RecordFrame(DeltaTime);
+	}
+	UpdateQuartzVisualPulseFrame(DeltaTime);
+}
+
+void UQuartzVisualSubsystem::UpdateQuartzVisualPulseFrame(float DeltaTime)
+{
+	LLM_SCOPE_BYNAME(TEXT("QuartzVisuals"));
+	ExtrapolateQuartzVisualClocks(DeltaTime);
+	UpdateQuartzVisualSignificance();
+	ComputeQuartzVisualPulseValues(DeltaTime);
+	DispatchQuartzVisualPulseUpdates();
+
+	CSV_CUSTOM_STAT(QuartzVisuals, ActivePulses, QuartzVisualEntries.Num(), ECsvCustomStatOp::Set);
+#if STATS
+	// Pulses still waiting on their start step.
+	int32 NumPending = 0;
+	for(const EQuartzVisualPulseState State : QuartzVisualEntries.Hot.State)
+	{
+		NumPending += State == EQuartzVisualPulseState::ReadyToStart ? 1 : 0;
+	}
+	SET_DWORD_STAT(STAT_QuartzVisualActivePulses, QuartzVisualEntries.Num() - NumPending);
+	SET_DWORD_STAT(STAT_QuartzVisualPendingPulses, NumPending);
+#endif
+	CSV_CUSTOM_STAT(QuartzVisuals, DeferredUpdates, DeferredUpdateCount, ECsvCustomStatOp::Set);
+}
+
+DECLARE_CYCLE_STAT(TEXT("Quartz Visual Compute"), STAT_QuartzVisualCompute, STATGROUP_QuartzVisuals);
+void UQuartzVisualSubsystem::ComputeQuartzVisualPulseValues(float DeltaTime)
+{
+	SCOPE_CYCLE_COUNTER(STAT_QuartzVisualCompute);
+	TRACE_CPUPROFILER_EVENT_SCOPE(STAT_QuartzVisualCompute)
+
+	FQuartzVisualPulseHotData& Hot = QuartzVisualEntries.Hot;
+	CurveCache.Refresh();
+	const FQuartzVisualCurveTable* Tables = CurveCache.GetTables();
+	const int32 NumEntries = QuartzVisualEntries.Num();
+	BatchOutValueNormalized.SetNumUninitialized(NumEntries, false);
+	BatchOutValue.SetNumUninitialized(NumEntries, false);
+	BatchDeltaSeconds.SetNumUninitialized(NumEntries, false);
+	BatchSubStep.SetNumUninitialized(NumEntries, false);
+	BatchCurrentStep.SetNumUninitialized(NumEntries, false);
+
+	// Each clock scales delta time by its own BPM. Progress comes from the clock's predicted position: a step counts as reached
+	// when it starts, the same as without the phase, and the phase carries it on towards the next one.
+	TArray<float, TInlineAllocator<8>> ClockDeltaSeconds;
+	TArray<float, TInlineAllocator<8>> ClockSubStep;
+	TArray<int32, TInlineAllocator<8>> ClockStep;
+	for(int32 ClockIndex = 0; ClockIndex < Clocks.Num(); ClockIndex++)
+	{
+		const FQuartzVisualClockState& Clock = Clocks[ClockIndex];
+		ClockDeltaSeconds.Add(DeltaTime * Clock.DeltaTimeMultiplier);
+		const bool bUsePhase = GQuartzVisualsSubBeatPhase && Clock.Phase.IsLocked();
+		ClockStep.Add(QuartzVisualEntries.GetClockStep(ClockIndex));
+		ClockSubStep.Add(bUsePhase ? 1.0f + Clock.Phase.GetStepPhase(ClockStep.Last(), OutputLatencyMs * 0.001f) : 1.0f);
+	}
+
+	// Pulses without a value come first and are skipped. Chunks only read and write their own range, so the result is the same on any number of threads.
+	const int32 ValueStart = QuartzVisualEntries.GetVariantEnd(EQuartzVisualValueVariant::None);
+	const int32 NumChunks = FMath::DivideAndRoundUp(NumEntries - ValueStart, QuartzVisualComputeChunkSize);
+	const bool bParallel = GQuartzVisualsParallelUpdateThreshold > 0 && NumEntries - ValueStart >= GQuartzVisualsParallelUpdateThreshold;
+	ParallelFor(NumChunks, [this, &Hot, &ClockDeltaSeconds, &ClockSubStep, &ClockStep, Tables, ValueStart, NumEntries](int32 ChunkIndex)
+	{
+		const int32 ChunkStart = ValueStart + ChunkIndex * QuartzVisualComputeChunkSize;
+		const int32 ChunkEnd = FMath::Min(ChunkStart + QuartzVisualComputeChunkSize, NumEntries);
+
+		for(int32 Index = ChunkStart; Index < ChunkEnd; Index++)
+		{
+			BatchDeltaSeconds[Index] = ClockDeltaSeconds[Hot.Clock[Index]];
+			BatchSubStep[Index] = ClockSubStep[Hot.Clock[Index]];
+			BatchCurrentStep[Index] = ClockStep[Hot.Clock[Index]];
+		}
+
+		// A chunk can span the end of one variant and the start of the next, each part goes to its own kernel.
+		for(int32 Variant = static_cast<int32>(EQuartzVisualValueVariant::Linear); Variant < static_cast<int32>(EQuartzVisualValueVariant::Num); Variant++)
+		{
+			const EQuartzVisualValueVariant ValueVariant = static_cast<EQuartzVisualValueVariant>(Variant);
+			const int32 Start = FMath::Max(ChunkStart, QuartzVisualEntries.GetVariantStart(ValueVariant));
+			const int32 Num = FMath::Min(ChunkEnd, QuartzVisualEntries.GetVariantEnd(ValueVariant)) - Start;
+			if(Num > 0)
+			{
+				QuartzVisualPulseKernels::EvaluateValues(ValueVariant,
+					BatchCurrentStep.GetData() + Start, Hot.StartStep.GetData() + Start, Hot.BeatDuration.GetData() + Start, BatchSubStep.GetData() + Start,
+					Hot.CurveTable.GetData() + Start, Tables, Hot.OutValueMin.GetData() + Start, Hot.OutValueMax.GetData() + Start, Hot.InterpSpeed.GetData() + Start,
+					Hot.OutValue.GetData() + Start, BatchOutValueNormalized.GetData() + Start, BatchOutValue.GetData() + Start, BatchDeltaSeconds.GetData() + Start, Num);
+			}
+		}
+
+		// Keep the results for started entries, the ones still waiting keep their values.
+		for(int32 Index = ChunkStart; Index < ChunkEnd; Index++)
+		{
+			const bool bStarted = Hot.State[Index] != EQuartzVisualPulseState::ReadyToStart;
+			Hot.OutValueNormalized[Index] = bStarted ? BatchOutValueNormalized[Index] : Hot.OutValueNormalized[Index];
+			Hot.OutValue[Index] = bStarted ? BatchOutValue[Index] : Hot.OutValue[Index];
+		}
+	}, bParallel ? EParallelForFlags::None : EParallelForFlags::ForceSingleThread);
+}
+
+DECLARE_DWORD_COUNTER_STAT(TEXT("Skipped Updates (Significance)"), STAT_QuartzVisualSkippedUpdates, STATGROUP_QuartzVisuals);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Deferred Updates (Budget)"), STAT_QuartzVisualDeferredUpdates, STATGROUP_QuartzVisuals);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Budget Overruns"), STAT_QuartzVisualBudgetOverruns, STATGROUP_QuartzVisuals);
+void UQuartzVisualSubsystem::DispatchQuartzVisualPulseUpdates()
+{
+	// Game thread only, always in dense order so listeners see the same sequence regardless of how values were computed.
+	// With a frame budget the order starts where the previous frame stopped, so every entry gets its turn.
+	SCOPE_CYCLE_COUNTER(STAT_QuartzVisualUpdate);
+	TRACE_CPUPROFILER_EVENT_SCOPE(STAT_QuartzVisualUpdate)
+	FQuartzVisualPulseHotData& Hot = QuartzVisualEntries.Hot;
+	bool bHasBatchedUpdates = false;
+	int32 NumDispatched = 0;
+	// Naming a scope per actor is too slow to leave on, only done while the channel is traced.
+	const bool bTraceActors = UE_TRACE_CHANNELEXPR_IS_ENABLED(QuartzVisualsChannel);
+	TArray<FQuartzVisualPulseHandle, TInlineAllocator<16>> DestroyedActorPulses;
+
+	const bool bBudgeted = GQuartzVisualsFrameBudgetUs > 0;
+	if(bBudgeted && bBatchedUpdatesDeferred)
+	{
+		bBatchedUpdatesDeferred = false;
+		DispatchBatchedQuartzVisualUpdates();
+	}
+
+	// Listeners can add and remove pulses from inside their update, which swaps entries across the variant ranges.
+	// Walking a snapshot of the handles visits every entry once however they move, pulses added meanwhile go out next frame.
+	const int32 NumToVisit = QuartzVisualEntries.Num();
+	const int32 FirstIndex = bBudgeted && DispatchCursor < NumToVisit ? DispatchCursor : 0;
+	DispatchHandleScratch.Reset(NumToVisit);
+	for(int32 Index = FirstIndex; Index < NumToVisit; Index++)
+	{
+		DispatchHandleScratch.Add(QuartzVisualEntries.GetHandle(Index));
+	}
+	for(int32 Index = 0; Index < FirstIndex; Index++)
+	{
+		DispatchHandleScratch.Add(QuartzVisualEntries.GetHandle(Index));
+	}
+
+	int32 NumVisited = 0;
+	for(; NumVisited < NumToVisit; NumVisited++)
+	{
+		// Checking the clock is not free, every few entries is close enough. The first few always go out so updates keep moving.
+		if(bBudgeted && NumVisited > 0 && NumVisited % 16 == 0 && IsOverQuartzVisualFrameBudget())
+		{
+			break;
+		}
+		const int32 Index = QuartzVisualEntries.GetDenseIndex(DispatchHandleScratch[NumVisited]);
+		if(Index == INDEX_NONE)
+		{
+			continue;
+		}
+
+		if(Hot.Group[Index] != INDEX_NONE)
+		{
+			// Members are rated on their own, the group always updates.
+			if(Hot.State[Index] != EQuartzVisualPulseState::ReadyToStart)
+			{
+				Hot.State[Index] = EQuartzVisualPulseState::Updating;
+				SendQuartzVisualGroupUpdate(Index, Hot.Group[Index]);
+				NumDispatched++;
+			}
+			continue;
+		}
+		if(IsValid(Hot.Actor[Index]) == false)
+		{
+			// Steps only visit pulses that start or finish on them, so pulses of destroyed actors are dropped here.
+			DestroyedActorPulses.Add(DispatchHandleScratch[NumVisited]);
+			continue;
+		}
+		if(Hot.State[Index] != EQuartzVisualPulseState::ReadyToStart)
+		{
+			Hot.State[Index] = EQuartzVisualPulseState::Updating;
+			if(Hot.Significance[Index] != EQuartzVisualSignificance::Full && IsQuartzVisualUpdateDue(Hot.Significance[Index], Hot.Actor[Index]) == false)
+			{
+				INC_DWORD_STAT(STAT_QuartzVisualSkippedUpdates);
+				continue;
+			}
+			if(Hot.InstanceSink[Index] != INDEX_NONE)
+			{
+				WriteQuartzVisualInstanceValue(Index);
+				NumDispatched++;
+				continue;
+			}
+			if(Hot.Batched[Index])
+			{
+				bHasBatchedUpdates = true;
+				continue;
+			}
+			if(bTraceActors)
+			{
+				TRACE_CPUPROFILER_EVENT_SCOPE_TEXT_ON_CHANNEL(*Hot.Actor[Index]->GetName(), QuartzVisualsChannel);
+				QuartzVisualSubsystemPrivate::SendUpdate(Hot.Actor[Index], Hot.NativeInterface[Index], QuartzVisualEntries.AssembleEntry(Index));
+			}
+			else
+			{
+				QuartzVisualSubsystemPrivate::SendUpdate(Hot.Actor[Index], Hot.NativeInterface[Index], QuartzVisualEntries.AssembleEntry(Index));
+			}
+			NumDispatched++;
+		}
+	}
+	INC_DWORD_STAT_BY(STAT_QuartzVisualDispatches, NumDispatched);
+
+	DispatchCursor = NumToVisit > 0 ? (FirstIndex + NumVisited) % NumToVisit : 0;
+	DeferredUpdateCount = NumToVisit - NumVisited;
+	INC_DWORD_STAT_BY(STAT_QuartzVisualDeferredUpdates, DeferredUpdateCount);
+
+	if(bHasBatchedUpdates)
+	{
+		if(bBudgeted && IsOverQuartzVisualFrameBudget())
+		{
+			bBatchedUpdatesDeferred = true;
+		}
+		else
+		{
+			DispatchBatchedQuartzVisualUpdates();
+		}
+	}
+
+	for(const FQuartzVisualPulseHandle& Handle : DestroyedActorPulses)
+	{
+		RemoveQuartzVisualPulse(Handle);
+	}
+
+	FlushQuartzVisualInstanceSinks();
+
+	if(bBudgeted && IsOverQuartzVisualFrameBudget())
+	{
+		BudgetOverrunCount++;
+		INC_DWORD_STAT(STAT_QuartzVisualBudgetOverruns);
+	}
+}
+
+DECLARE_CYCLE_STAT(TEXT("Quartz Visual Batched Update"), STAT_QuartzVisualBatchedUpdate, STATGROUP_QuartzVisuals);
+void UQuartzVisualSubsystem::DispatchBatchedQuartzVisualUpdates()
+{
+	SCOPE_CYCLE_COUNTER(STAT_QuartzVisualBatchedUpdate);
+	TRACE_CPUPROFILER_EVENT_SCOPE(STAT_QuartzVisualBatchedUpdate)
+
+	// Gather first, listeners can add and remove pulses from inside the event.
+	BatchedActorScratch.Reset();
+	for(const TPair<TObjectKey<AActor>, FQuartzVisualListener>& Listener : QuartzVisualEntries.GetListeners())
+	{
+		if(Listener.Value.bWantsBatchedUpdates && IsQuartzVisualUpdateDue(Listener.Value.Significance, Listener.Value.Actor.Get()))
+		{
+			if(AActor* Actor = Listener.Value.Actor.Get())
+			{
+				BatchedActorScratch.Add(Actor);
+			}
+		}
+	}
+
+	for(AActor* Actor : BatchedActorScratch)
+	{
+		const FQuartzVisualListener* Listener = QuartzVisualEntries.FindListener(Actor);
+		if(Listener == nullptr || IsValid(Actor) == false)
+		{
+			continue;
+		}
+
+		BatchedUpdateScratch.Reset();
+		for(const FQuartzVisualPulseHandle& Handle : Listener->Pulses)
+		{
+			const int32 DenseIndex = QuartzVisualEntries.GetDenseIndex(Handle);
+			if(QuartzVisualEntries.Hot.State[DenseIndex] == EQuartzVisualPulseState::Updating && QuartzVisualEntries.Hot.InstanceSink[DenseIndex] == INDEX_NONE)
+			{
+				BatchedUpdateScratch.Add(QuartzVisualEntries.MakeUpdate(DenseIndex));
+			}
+		}
+
+		if(BatchedUpdateScratch.Num() > 0)
+		{
+			INC_DWORD_STAT_BY(STAT_QuartzVisualDispatches, BatchedUpdateScratch.Num());
+			if(Listener->NativeBatchInterface)
+			{
+				Listener->NativeBatchInterface->OnQuartzVisualUpdateBatch_Implementation(BatchedUpdateScratch);
+			}
+			else
+			{
+				IQuartzVisualsInterface::Execute_OnQuartzVisualUpdateBatch(Actor, BatchedUpdateScratch);
+			}
+		}
+	}
+}
+
+void UQuartzVisualSubsystem::UpdateQuartzVisualSignificance()
+{
+	SignificanceFrame++;
+	if(GQuartzVisualsSignificance == 0)
+	{
+		// Put everyone back to full once after turning it off.
+		if(bSignificanceApplied)
+		{
+			bSignificanceApplied = false;
+			QuartzVisualEntries.UpdateSignificance([](const AActor*) { return EQuartzVisualSignificance::Full; });
+		}
+		return;
+	}
+	if(bSignificanceApplied && SignificanceFrame % static_cast<uint32>(FMath::Max(GQuartzVisualsSignificanceEvaluateInterval, 1)) != 0)
+	{
+		return;
+	}
+	bSignificanceApplied = true;
+
+	TArray<FVector, TInlineAllocator<4>> ViewLocations;
+	for(FConstPlayerControllerIterator Iterator = OwningWorld->GetPlayerControllerIterator(); Iterator; ++Iterator)
+	{
+		const APlayerController* PlayerController = Iterator->Get();
+		if(PlayerController && PlayerController->IsLocalController())
+		{
+			FVector ViewLocation;
+			FRotator ViewRotation;
+			PlayerController->GetPlayerViewPoint(ViewLocation, ViewRotation);
+			ViewLocations.Add(ViewLocation);
+		}
+	}
+
+	QuartzVisualEntries.UpdateSignificance([this, &ViewLocations](const AActor* Actor)
+	{
+		return EvaluateQuartzVisualSignificance(Actor, ViewLocations);
+	});
+}
+
+EQuartzVisualSignificance UQuartzVisualSubsystem::EvaluateQuartzVisualSignificance(const AActor* Actor, const TArray<FVector, TInlineAllocator<4>>& ViewLocations) const
+{
+	if(IsValid(Actor) == false || ViewLocations.Num() == 0)
+	{
+		return EQuartzVisualSignificance::Full;
+	}
+	if(Actor->WasRecentlyRendered(GQuartzVisualsSignificanceRenderTimeout) == false)
+	{
+		return EQuartzVisualSignificance::EventsOnly;
+	}
+
+	const FVector ActorLocation = Actor->GetActorLocation();
+	double ClosestDistanceSquared = TNumericLimits<double>::Max();
+	for(const FVector& ViewLocation : ViewLocations)
+	{
+		ClosestDistanceSquared = FMath::Min(ClosestDistanceSquared, FVector::DistSquared(ActorLocation, ViewLocation));
+	}
+	if(ClosestDistanceSquared > FMath::Square(static_cast<double>(GQuartzVisualsSignificanceEventsOnlyDistance)))
+	{
+		return EQuartzVisualSignificance::EventsOnly;
+	}
+	if(ClosestDistanceSquared > FMath::Square(static_cast<double>(GQuartzVisualsSignificanceReducedDistance)))
+	{
+		return EQuartzVisualSignificance::Reduced;
+	}
+	return EQuartzVisualSignificance::Full;
+}
+
+FQuartzVisualPulseHandle UQuartzVisualSubsystem::AddNewQuartzVisualPulse(AActor* InActor, const FQuartzVisualPulseSettings& QuantizedVisualPulseSettings, int32 BeatDuration, int32 BeatOffset, bool StopIfExists)
+{
+	if(CanReceiveQuartzVisualPulses(InActor) == false)
+	{
+		return FQuartzVisualPulseHandle();
+	}
+	return AddCheckedQuartzVisualPulse(InActor, QuantizedVisualPulseSettings, BeatDuration, BeatOffset, StopIfExists);
+}
+
+bool UQuartzVisualSubsystem::CanReceiveQuartzVisualPulses(AActor* InActor) const
+{
+	// Actors that already have pulses were checked when they got their first one.
+	const FQuartzVisualListener* ExistingListener = QuartzVisualEntries.FindListener(InActor);
+	if((ExistingListener == nullptr || ExistingListener->bInitialized == false) && UKismetSystemLibrary::DoesImplementInterface(InActor, UQuartzVisualsInterface::StaticClass()) == false)
+	{
+		UE_LOG(LogQuartzVisuals, Warning, TEXT("Does not implement quartz visual interface"));
+		return false;
+	}
+	return true;
+}
+
+int32 UQuartzVisualSubsystem::AddQuartzVisualPulsePattern(const TArray<AActor*>& Actors, UQuartzVisualPulsePattern* Pattern, int32 BeatOffset, bool StopIfExists)
+{
+	if(Pattern == nullptr)
+	{
+		return 0;
+	}
+	return AddNewQuartzVisualPulses(Actors, Pattern->GetCompiledPulses(), BeatOffset, StopIfExists);
+}
+
+int32 UQuartzVisualSubsystem::AddNewQuartzVisualPulses(const TArray<AActor*>& Actors, const TArray<FQuartzVisualPatternPulse>& Pulses, int32 BeatOffset, bool StopIfExists)
+{
+	LLM_SCOPE_BYNAME(TEXT("QuartzVisuals"));
+	QuartzVisualEntries.Reserve(Actors.Num() * Pulses.Num());
+
+	// A light hit on beat 1 and again on beat 3 is two pulses, numbered so the second doesn't replace the first.
+	TArray<int32, TInlineAllocator<64>> Repeats;
+	Repeats.SetNumUninitialized(Pulses.Num());
+	TMap<TPair<int32, int32>, int32, TInlineSetAllocator<64>> NumHits;
+	for(int32 PulseIndex = 0; PulseIndex < Pulses.Num(); PulseIndex++)
+	{
+		Repeats[PulseIndex] = NumHits.FindOrAdd(TPair<int32, int32>(Pulses[PulseIndex].Settings.Index, Pulses[PulseIndex].Settings.IndexFilter))++;
+	}
+
+	int32 NumAdded = 0;
+	for(AActor* Actor : Actors)
+	{
+		// The interface is checked once per actor instead of once per pulse.
+		if(IsValid(Actor) == false || CanReceiveQuartzVisualPulses(Actor) == false)
+		{
+			continue;
+		}
+		for(int32 PulseIndex = 0; PulseIndex < Pulses.Num(); PulseIndex++)
+		{
+			const FQuartzVisualPatternPulse& Pulse = Pulses[PulseIndex];
+			// A pulse kept by StopIfExists wasn't added, so it isn't counted.
+			if(StopIfExists && QuartzVisualEntries.Find(FQuartzVisualPulseKey(Actor, Pulse.Settings.Index, Pulse.Settings.IndexFilter, nullptr, Repeats[PulseIndex])).IsSet())
+			{
+				continue;
+			}
+			NumAdded += AddCheckedQuartzVisualPulse(Actor, Pulse.Settings, Pulse.BeatDuration, BeatOffset + Pulse.BeatOffset, StopIfExists, Repeats[PulseIndex]).IsSet() ? 1 : 0;
+		}
+	}
+	return NumAdded;
+}
+
+FQuartzVisualPulseHandle UQuartzVisualSubsystem::AddCheckedQuartzVisualPulse(AActor* InActor, const FQuartzVisualPulseSettings& QuantizedVisualPulseSettings, int32 BeatDuration, int32 BeatOffset, bool StopIfExists, int32 Repeat)
+{
+	FQuartzVisualPulseEntry NewEntry = FQuartzVisualPulseEntry();
+	NewEntry.Settings = QuantizedVisualPulseSettings;
+	NewEntry.Data.BeatOffset = BeatOffset;
+	NewEntry.Data.BeatDuration = BeatDuration;
+	NewEntry.Data.Actor = InActor;
+	NewEntry.State = EQuartzVisualPulseState::ReadyToStart;
+
+	const FQuartzVisualPulseKey Key(NewEntry, nullptr, Repeat);
+	const FQuartzVisualPulseHandle ExistingHandle = QuartzVisualEntries.Find(Key);
+	
+	if(StopIfExists && ExistingHandle.IsSet())
+	{
+		return ExistingHandle;
+	}
+	
+	if(ExistingHandle.IsSet())
+	{
+		// Cancel if the entry already exists.
+		if(GQuartzVisualsEnableLogs)
+		{
+			UE_LOG(LogQuartzVisuals, Log, TEXT("-----------------------"));
+			UE_LOG(LogQuartzVisuals, Log, TEXT("Add new entry %s"), *NewEntry.ToString());
+			UE_LOG(LogQuartzVisuals, Log, TEXT("-----------------------"));
+		}
+		RemoveQuartzVisualPulse(ExistingHandle);
+		// The finish event could have added the same pulse again.
+		RemoveQuartzVisualEntry(QuartzVisualEntries.Find(Key));
+	}
+	else
+	{
+		if(GQuartzVisualsEnableLogs)
+		{
+			UE_LOG(LogQuartzVisuals, Log, TEXT("-----------------------"));
+			UE_LOG(LogQuartzVisuals, Log, TEXT("Add new quarts entry %s"), *NewEntry.ToString());
+			UE_LOG(LogQuartzVisuals, Log, TEXT("-----------------------"));
+		}
+	}
+	// The replaced pulse may have been the actor's last one, so look the listener up again.
+	const FQuartzVisualListener* ExistingListener = QuartzVisualEntries.FindListener(InActor);
+	if(ExistingListener == nullptr || ExistingListener->bInitialized == false)
+	{
+		InitializeQuartzVisualListener(InActor);
+	}
+	const FQuartzVisualPulseHandle NewHandle = AddQuartzVisualEntry(NewEntry, nullptr, INDEX_NONE, Repeat);
+	if(Recorder.IsRecording())
+	{
+		Recorder.RecordAddPulse(InActor, QuantizedVisualPulseSettings, BeatDuration, BeatOffset, Repeat, NewHandle);
+	}
+	return NewHandle;
+}
+
+FQuartzVisualPulseHandle UQuartzVisualSubsystem::AddNewQuartzVisualGroupPulse(const TArray<AActor*>& Actors, const FQuartzVisualPulseSettings& QuantizedVisualPulseSettings, int32 BeatDuration, int32 BeatOffset)
+{
+	FQuartzVisualPulseGroup NewGroup;
+	NewGroup.Members.Reserve(Actors.Num());
+	NewGroup.NativeInterfaces.Reserve(Actors.Num());
+	for(AActor* Actor : Actors)
+	{
+		if(IsValid(Actor) && NewGroup.Members.Contains(Actor) == false && CanReceiveQuartzVisualPulses(Actor))
+		{
+			NewGroup.Members.Add(Actor);
+			NewGroup.NativeInterfaces.Add(QuartzVisualSubsystemPrivate::FindNativeUpdateInterface(Actor));
+		}
+	}
+	if(NewGroup.Members.Num() == 0)
+	{
+		return FQuartzVisualPulseHandle();
+	}
+
+	FQuartzVisualPulseEntry NewEntry = FQuartzVisualPulseEntry();
+	NewEntry.Settings = QuantizedVisualPulseSettings;
+	NewEntry.Data.BeatOffset = BeatOffset;
+	NewEntry.Data.BeatDuration = BeatDuration;
+	NewEntry.State = EQuartzVisualPulseState::ReadyToStart;
+
+	if(GQuartzVisualsEnableLogs)
+	{
+		UE_LOG(LogQuartzVisuals, Log, TEXT("Add new group entry %s for %d actors"), *NewEntry.ToString(), NewGroup.Members.Num());
+	}
+
+	const int32 GroupIndex = PulseGroups.Add(MoveTemp(NewGroup));
+	const FQuartzVisualPulseHandle NewHandle = AddQuartzVisualEntry(NewEntry, nullptr, GroupIndex);
+	PulseGroups[GroupIndex].Handle = NewHandle;
+	for(const TWeakObjectPtr<AActor>& Member : PulseGroups[GroupIndex].Members)
+	{
+		QuartzVisualEntries.AddGroupMember(NewHandle, Member.Get());
+	}
+	if(Recorder.IsRecording())
+	{
+		Recorder.RecordAddGroupPulse(PulseGroups[GroupIndex].Members, QuantizedVisualPulseSettings, BeatDuration, BeatOffset, NewHandle);
+	}
+	return NewHandle;
+}
+
+bool UQuartzVisualSubsystem::RemoveQuartzVisualGroupMember(FQuartzVisualPulseHandle Handle, AActor* Actor)
+{
+	const int32 DenseIndex = QuartzVisualEntries.GetDenseIndex(Handle);
+	if(DenseIndex == INDEX_NONE || QuartzVisualEntries.Hot.Group[DenseIndex] == INDEX_NONE)
+	{
+		return false;
+	}
+	FQuartzVisualPulseGroup& Group = PulseGroups[QuartzVisualEntries.Hot.Group[DenseIndex]];
+	// Already being sent the group's finish, a second one of its own would finish the actor twice.
+	if(Group.bFinishing)
+	{
+		return false;
+	}
+	const int32 MemberIndex = Group.Members.IndexOfByKey(Actor);
+	if(MemberIndex == INDEX_NONE)
+	{
+		return false;
+	}
+	if(Recorder.IsRecording())
+	{
+		Recorder.RecordRemoveGroupMember(Handle, Actor);
+	}
+	IQuartzVisualsInterface* NativeInterface = Group.NativeInterfaces[MemberIndex];
+	if(Group.DispatchDepth > 0)
+	{
+		// Swapping would move a member the dispatch hasn't reached yet into a slot it has passed.
+		Group.Members[MemberIndex] = nullptr;
+		Group.NativeInterfaces[MemberIndex] = nullptr;
+	}
+	else
+	{
+		Group.Members.RemoveAtSwap(MemberIndex, 1, false);
+		Group.NativeInterfaces.RemoveAtSwap(MemberIndex, 1, false);
+	}
+	QuartzVisualEntries.RemoveGroupMember(Handle, Actor);
+	const bool bGroupEmpty = Group.Members.ContainsByPredicate([](const TWeakObjectPtr<AActor>& Member) { return Member.IsValid(); }) == false;
+
+	// The actor gets the same finish the whole group would, the hot fields are put back for the members still playing.
+	FQuartzVisualPulseHotData& Hot = QuartzVisualEntries.Hot;
+	const EQuartzVisualPulseState State = Hot.State[DenseIndex];
+	const float OutValueNormalized = Hot.OutValueNormalized[DenseIndex];
+	const float OutValue = Hot.OutValue[DenseIndex];
+	Hot.UpdateValue(DenseIndex, Hot.StartStep[DenseIndex] + Hot.BeatDuration[DenseIndex], 1000.0f, &CurveCache);
+	Hot.State[DenseIndex] = EQuartzVisualPulseState::Finished;
+	FQuartzVisualPulseEntry& MemberEntry = QuartzVisualEntries.AssembleEntry(DenseIndex);
+	MemberEntry.Data.Actor = Actor;
+	QuartzVisualSubsystemPrivate::SendUpdate(Actor, NativeInterface, MemberEntry);
+
+	// The finish event can add or remove pulses, moving this one.
+	const int32 MovedIndex = QuartzVisualEntries.GetDenseIndex(Handle);
+	if(MovedIndex != INDEX_NONE)
+	{
+		Hot.State[MovedIndex] = State;
+		Hot.OutValueNormalized[MovedIndex] = OutValueNormalized;
+		Hot.OutValue[MovedIndex] = OutValue;
+	}
+
+	if(bGroupEmpty)
+	{
+		RemoveQuartzVisualPulse(Handle);
+	}
+	return true;
+}
+
+void UQuartzVisualSubsystem::SendQuartzVisualGroupUpdate(int32 DenseIndex, int32 GroupIndex)
+{
+	// One copy for the whole group, members may add or remove pulses from inside their update.
+	FQuartzVisualPulseEntry GroupEntry = QuartzVisualEntries.AssembleEntry(DenseIndex);
+	const FQuartzVisualPulseHandle Handle = QuartzVisualEntries.GetHandle(DenseIndex);
+	// The group can be finished and freed by a member, and the sparse array moved by new groups.
+	auto IsSameGroup = [this, GroupIndex, &Handle]() { return PulseGroups.IsValidIndex(GroupIndex) && PulseGroups[GroupIndex].Handle == Handle; };
+
+	PulseGroups[GroupIndex].DispatchDepth++;
+	for(int32 MemberIndex = 0; IsSameGroup() && MemberIndex < PulseGroups[GroupIndex].Members.Num(); MemberIndex++)
+	{
+		FQuartzVisualPulseGroup& Group = PulseGroups[GroupIndex];
+		AActor* Member = Group.Members[MemberIndex].Get();
+		if(IsValid(Member) == false)
+		{
+			// Destroyed, or removed while the members are being sent the update. Dropped below.
+			continue;
+		}
+		GroupEntry.Data.Actor = Member;
+		QuartzVisualSubsystemPrivate::SendUpdate(Member, Group.NativeInterfaces[MemberIndex], GroupEntry);
+	}
+
+	if(IsSameGroup() && --PulseGroups[GroupIndex].DispatchDepth == 0)
+	{
+		FQuartzVisualPulseGroup& Group = PulseGroups[GroupIndex];
+		for(int32 MemberIndex = Group.Members.Num() - 1; MemberIndex >= 0; MemberIndex--)
+		{
+			if(IsValid(Group.Members[MemberIndex].Get()) == false)
+			{
+				Group.Members.RemoveAtSwap(MemberIndex, 1, false);
+				Group.NativeInterfaces.RemoveAtSwap(MemberIndex, 1, false);
+			}
+		}
+	}
+}
+
+FQuartzVisualPulseHandle UQuartzVisualSubsystem::AddNewQuartzVisualInstancePulse(UInstancedStaticMeshComponent* Component, int32 InstanceIndex, int32 CustomDataIndex, FQuartzVisualPulseSettings QuantizedVisualPulseSettings, int32 BeatDuration, int32 BeatOffset, bool StopIfExists)
+{
+	if(IsValid(Component) == false || IsValid(Component->GetOwner()) == false)
+	{
+		UE_LOG(LogQuartzVisuals, Warning, TEXT("Instance pulse needs a valid component with an owner"));
+		return FQuartzVisualPulseHandle();
+	}
+	if(Component->IsValidInstance(InstanceIndex) == false || CustomDataIndex < 0 || CustomDataIndex >= Component->NumCustomDataFloats)
+	{
+		UE_LOG(LogQuartzVisuals, Warning, TEXT("Instance %d custom data %d is out of range on %s"), InstanceIndex, CustomDataIndex, *Component->GetName());
+		return FQuartzVisualPulseHandle();
+	}
+
+	// The instance and custom data slot are the identity of the pulse.
+	QuantizedVisualPulseSettings.Index = InstanceIndex;
+	QuantizedVisualPulseSettings.IndexFilter = CustomDataIndex;
+
+	FQuartzVisualPulseEntry NewEntry = FQuartzVisualPulseEntry();
+	NewEntry.Settings = QuantizedVisualPulseSettings;
+	NewEntry.Data.BeatOffset = BeatOffset;
+	NewEntry.Data.BeatDuration = BeatDuration;
+	NewEntry.Data.Actor = Component->GetOwner();
+	NewEntry.State = EQuartzVisualPulseState::ReadyToStart;
+
+	const FQuartzVisualPulseKey Key(NewEntry, Component);
+	const FQuartzVisualPulseHandle ExistingHandle = QuartzVisualEntries.Find(Key);
+	if(ExistingHandle.IsSet())
+	{
+		if(StopIfExists)
+		{
+			return ExistingHandle;
+		}
+		RemoveQuartzVisualPulse(ExistingHandle);
+	}
+
+	const FQuartzVisualPulseHandle NewHandle = AddQuartzVisualEntry(NewEntry, Component);
+	if(Recorder.IsRecording())
+	{
+		Recorder.RecordAddInstancePulse(Component, InstanceIndex, CustomDataIndex, QuantizedVisualPulseSettings, BeatDuration, BeatOffset, NewHandle);
+	}
+	return NewHandle;
+}
+
+void UQuartzVisualSubsystem::RemoveQuartzVisualInstancePulse(UInstancedStaticMeshComponent* Component, int32 InstanceIndex, int32 CustomDataIndex)
+{
+	if(Component)
+	{
+		RemoveQuartzVisualPulse(QuartzVisualEntries.Find(FQuartzVisualPulseKey(Component->GetOwner(), InstanceIndex, CustomDataIndex, Component)));
+	}
+}
+
+FQuartzVisualPulseHandle UQuartzVisualSubsystem::AddQuartzVisualEntry(const FQuartzVisualPulseEntry& NewEntry, UInstancedStaticMeshComponent* InstanceComponent, int32 GroupIndex, int32 Repeat)
+{
+	LLM_SCOPE_BYNAME(TEXT("QuartzVisuals"));
+	// Groups are identified by their index, their settings' Index and IndexFilter are only for the members.
+	const FQuartzVisualPulseKey Key = GroupIndex != INDEX_NONE ? FQuartzVisualPulseKey(nullptr, GroupIndex, 0, this) : FQuartzVisualPulseKey(NewEntry, InstanceComponent, Repeat);
+	const FQuartzVisualPulseHandle NewHandle = QuartzVisualEntries.Add(NewEntry, FindOrAddQuartzVisualClock(NewEntry.Settings.ClockName), Key, GroupIndex);
+	const int32 DenseIndex = QuartzVisualEntries.GetDenseIndex(NewHandle);
+	QuartzVisualEntries.Hot.CurveTable[DenseIndex] = CurveCache.FindOrBake(NewEntry.Settings.ValueCurve);
+
+	// Pulses shorter than a coarse event need the fine events, extrapolation alone drifts too much for them. The audio feed has every step already.
+	const int32 ClockIndex = QuartzVisualEntries.Hot.Clock[DenseIndex];
+	if(Clocks[ClockIndex].bIdle)
+	{
+		UpdateQuartzVisualClockIdle(ClockIndex);
+	}
+	if(Clocks[ClockIndex].IsExtrapolating() && Clocks[ClockIndex].AudioBeatFeed.IsValid() == false && NewEntry.Data.BeatDuration < Clocks[ClockIndex].StepsPerCoarseEvent)
+	{
+		SetQuartzVisualClockEventQuantization(ClockIndex, Clocks[ClockIndex].Quantization);
+	}
+	if(InstanceComponent)
+	{
+		QuartzVisualEntries.Hot.InstanceSink[DenseIndex] = FindOrAddQuartzVisualInstanceSink(InstanceComponent);
+	}
+
+	if(GQuartzVisualsValidateLookup)
+	{
+		ensureMsgf(QuartzVisualEntries.Validate(), TEXT("Quartz visual lookup out of sync after adding %s"), *NewEntry.ToString());
+	}
+	return NewHandle;
+}
+
+int32 UQuartzVisualSubsystem::FindOrAddQuartzVisualInstanceSink(UInstancedStaticMeshComponent* Component)
+{
+	const TObjectKey<UInstancedStaticMeshComponent> ComponentKey(Component);
+	if(const int32* SinkIndex = InstanceSinkLookup.Find(ComponentKey))
+	{
+		InstanceSinks[*SinkIndex].NumPulses++;
+		return *SinkIndex;
+	}
+	const int32 SinkIndex = FreeInstanceSinks.Num() > 0 ? FreeInstanceSinks.Pop(false) : InstanceSinks.AddDefaulted();
+	FQuartzVisualInstanceSink& Sink = InstanceSinks[SinkIndex];
+	Sink.Component = Component;
+	Sink.ComponentKey = ComponentKey;
+	Sink.NumPulses = 1;
+	Sink.bDirty = false;
+	InstanceSinkLookup.Add(ComponentKey, SinkIndex);
+	return SinkIndex;
+}
+
+void UQuartzVisualSubsystem::ReleaseQuartzVisualInstanceSink(int32 SinkIndex)
+{
+	FQuartzVisualInstanceSink& Sink = InstanceSinks[SinkIndex];
+	if(--Sink.NumPulses > 0)
+	{
+		return;
+	}
+	// The last pulse's final value would otherwise wait for a flush that skips released sinks.
+	if(Sink.bDirty)
+	{
+		if(UInstancedStaticMeshComponent* Component = Sink.Component.Get())
+		{
+			Component->MarkRenderStateDirty();
+		}
+	}
+	// The component may be gone already, the key still finds its lookup entry.
+	InstanceSinkLookup.Remove(Sink.ComponentKey);
+	Sink = FQuartzVisualInstanceSink();
+	FreeInstanceSinks.Add(SinkIndex);
+}
+
+void UQuartzVisualSubsystem::WriteQuartzVisualInstanceValue(int32 DenseIndex)
+{
+	FQuartzVisualInstanceSink& Sink = InstanceSinks[QuartzVisualEntries.Hot.InstanceSink[DenseIndex]];
+	if(UInstancedStaticMeshComponent* Component = Sink.Component.Get())
+	{
+		// Render state is marked dirty once per component in FlushQuartzVisualInstanceSinks.
+		const FQuartzVisualPulseKey& Key = QuartzVisualEntries.GetKey(DenseIndex);
+		Component->SetCustomDataValue(Key.Index, Key.IndexFilter, QuartzVisualEntries.Hot.OutValue[DenseIndex], false);
+		Sink.bDirty = true;
+	}
+}
+
+void UQuartzVisualSubsystem::FlushQuartzVisualInstanceSinks()
+{
+	for(FQuartzVisualInstanceSink& Sink : InstanceSinks)
+	{
+		if(Sink.bDirty)
+		{
+			Sink.bDirty = false;
+			if(UInstancedStaticMeshComponent* Component = Sink.Component.Get())
+			{
+				Component->MarkRenderStateDirty();
+			}
+		}
+	}
+}
+
+bool UQuartzVisualSubsystem::RemoveQuartzVisualEntry(const FQuartzVisualPulseHandle& Handle)
+{
+	const int32 DenseIndex = QuartzVisualEntries.GetDenseIndex(Handle);
+	if(DenseIndex == INDEX_NONE)
+	{
+		return false;
+	}
+	if(QuartzVisualEntries.Hot.InstanceSink[DenseIndex] != INDEX_NONE)
+	{
+		ReleaseQuartzVisualInstanceSink(QuartzVisualEntries.Hot.InstanceSink[DenseIndex]);
+	}
+	return QuartzVisualEntries.Remove(Handle);
+}
+
+bool UQuartzVisualSubsystem::RemoveQuartzVisualPulse(FQuartzVisualPulseHandle Handle)
+{
+	const int32 DenseIndex = QuartzVisualEntries.GetDenseIndex(Handle);
+	if(DenseIndex == INDEX_NONE)
+	{
+		return false;
+	}
+	if(Recorder.IsRecording())
+	{
+		Recorder.RecordRemovePulse(Handle);
+	}
+	FinishQuartzVisualEntryAt(DenseIndex);
+	// The finish event may have already removed it, the handle tells us either way.
+	RemoveQuartzVisualEntry(Handle);
+
+	if(GQuartzVisualsValidateLookup)
+	{
+		ensureMsgf(QuartzVisualEntries.Validate(), TEXT("Quartz visual lookup out of sync after removing a pulse"));
+	}
+	return true;
+}
+
+bool UQuartzVisualSubsystem::IsQuartzVisualPulseActive(FQuartzVisualPulseHandle Handle) const
+{
+	return QuartzVisualEntries.GetDenseIndex(Handle) != INDEX_NONE;
+}
+
+void UQuartzVisualSubsystem::RemoveQuartzVisualPulseFromActor(int32 Index, int32 IndexFilter, AActor* InActor)
+{
+	const TArray<FQuartzVisualPulseHandle>* ActorHandles = QuartzVisualEntries.FindActorHandles(InActor);
+	if(ActorHandles == nullptr)
+	{
+		return;
+	}
+
+	// Pattern repeats of the pulse go with it. Copy, removing entries changes the actor's handle list.
+	TArray<FQuartzVisualPulseHandle, TInlineAllocator<4>> HandlesToRemove;
+	for(const FQuartzVisualPulseHandle& ActorHandle : *ActorHandles)
+	{
+		const FQuartzVisualPulseKey& Key = QuartzVisualEntries.GetKey(QuartzVisualEntries.GetDenseIndex(ActorHandle));
+		if(Key.Index == Index && Key.IndexFilter == IndexFilter && Key.Sink == TObjectKey<UObject>())
+		{
+			HandlesToRemove.Add(ActorHandle);
+		}
+	}
+	for(const FQuartzVisualPulseHandle& ActorHandle : HandlesToRemove)
+	{
+		RemoveQuartzVisualPulse(ActorHandle);
+	}
+}
+
+void UQuartzVisualSubsystem::RemoveAllQuartzVisualPulsesFromActor(AActor* InActor, TArray<int32> ExcludeIndexFilters)
+{
+	// Groups only lose the actor, the other members keep their pulse. Copied, removing members changes the list.
+	if(const TArray<FQuartzVisualPulseHandle>* ActorGroupHandles = QuartzVisualEntries.FindActorGroupHandles(InActor))
+	{
+		const TArray<FQuartzVisualPulseHandle, TInlineAllocator<8>> GroupHandles(*ActorGroupHandles);
+		for(const FQuartzVisualPulseHandle& Handle : GroupHandles)
+		{
+			const int32 DenseIndex = QuartzVisualEntries.GetDenseIndex(Handle);
+			if(DenseIndex != INDEX_NONE && ExcludeIndexFilters.Contains(QuartzVisualEntries.GetSettings(DenseIndex).IndexFilter) == false)
+			{
+				RemoveQuartzVisualGroupMember(Handle, InActor);
+			}
+		}
+	}
+
+	const TArray<FQuartzVisualPulseHandle>* ActorHandles = QuartzVisualEntries.FindActorHandles(InActor);
+	if(ActorHandles == nullptr)
+	{
+		return;
+	}
+
+	// Copy, removing entries changes the actor's handle list.
+	TArray<FQuartzVisualPulseHandle, TInlineAllocator<16>> HandlesToRemove;
+	for(const FQuartzVisualPulseHandle& Handle : *ActorHandles)
+	{
+		const int32 DenseIndex = QuartzVisualEntries.GetDenseIndex(Handle);
+		if(ExcludeIndexFilters.Contains(QuartzVisualEntries.GetKey(DenseIndex).IndexFilter) == false)
+		{
+			HandlesToRemove.Add(Handle);
+		}
+	}
+
+	for(const FQuartzVisualPulseHandle& Handle : HandlesToRemove)
+	{
+		RemoveQuartzVisualPulse(Handle);
+	}
+}
+
+void UQuartzVisualSubsystem::EnqueueQuartzVisualPulse(AActor* InActor, const FQuartzVisualPulseSettings& QuantizedVisualPulseSettings, int32 BeatDuration, int32 BeatOffset, bool StopIfExists)
+{
+	FQuartzVisualPulseCommand Command;
+	Command.Type = FQuartzVisualPulseCommand::EType::Add;
+	Command.Actor = InActor;
+	Command.Settings = QuantizedVisualPulseSettings;
+	Command.BeatDuration = BeatDuration;
+	Command.BeatOffset = BeatOffset;
+	Command.bStopIfExists = StopIfExists;
+	CommandQueue.Enqueue(MoveTemp(Command));
+}
+
+void UQuartzVisualSubsystem::EnqueueRemoveQuartzVisualPulseFromActor(int32 Index, int32 IndexFilter, AActor* InActor)
+{
+	FQuartzVisualPulseCommand Command;
+	Command.Type = FQuartzVisualPulseCommand::EType::Remove;
+	Command.Actor = InActor;
+	Command.Index = Index;
+	Command.IndexFilter = IndexFilter;
+	CommandQueue.Enqueue(MoveTemp(Command));
+}
+
+void UQuartzVisualSubsystem::EnqueueRemoveAllQuartzVisualPulsesFromActor(AActor* InActor, TArray<int32> ExcludeIndexFilters)
+{
+	FQuartzVisualPulseCommand Command;
+	Command.Type = FQuartzVisualPulseCommand::EType::RemoveAll;
+	Command.Actor = InActor;
+	Command.ExcludeIndexFilters = MoveTemp(ExcludeIndexFilters);
+	CommandQueue.Enqueue(MoveTemp(Command));
+}
+
+void UQuartzVisualSubsystem::EnqueueCancelQuartzVisualPulse(FQuartzVisualPulseHandle Handle)
+{
+	FQuartzVisualPulseCommand Command;
+	Command.Type = FQuartzVisualPulseCommand::EType::Cancel;
+	Command.Handle = Handle;
+	CommandQueue.Enqueue(MoveTemp(Command));
+}
+
+DECLARE_DWORD_COUNTER_STAT(TEXT("Queued Commands"), STAT_QuartzVisualQueuedCommands, STATGROUP_QuartzVisuals);
+void UQuartzVisualSubsystem::ProcessQuartzVisualCommands()
+{
+	check(IsInGameThread());
+	FQuartzVisualPulseCommand Command;
+	while(CommandQueue.Dequeue(Command))
+	{
+		INC_DWORD_STAT(STAT_QuartzVisualQueuedCommands);
+		switch(Command.Type)
+		{
+		case FQuartzVisualPulseCommand::EType::Add:
+			// Actors destroyed while the command was queued are skipped.
+			if(AActor* Actor = Command.Actor.Get())
+			{
+				AddNewQuartzVisualPulse(Actor, Command.Settings, Command.BeatDuration, Command.BeatOffset, Command.bStopIfExists);
+			}
+			break;
+		case FQuartzVisualPulseCommand::EType::Remove:
+			if(AActor* Actor = Command.Actor.Get())
+			{
+				RemoveQuartzVisualPulseFromActor(Command.Index, Command.IndexFilter, Actor);
+			}
+			break;
+		case FQuartzVisualPulseCommand::EType::RemoveAll:
+			if(AActor* Actor = Command.Actor.Get())
+			{
+				RemoveAllQuartzVisualPulsesFromActor(Actor, Command.ExcludeIndexFilters);
+			}
+			break;
+		case FQuartzVisualPulseCommand::EType::Cancel:
+			RemoveQuartzVisualPulse(Command.Handle);
+			break;
+		}
+	}
+}
+
+void UQuartzVisualSubsystem::RemoveAllQuartzVisualPulses()
+{
+	if(Recorder.IsRecording())
+	{
+		Recorder.RecordRemoveAll();
+	}
+	// Snapshot first so finish events that add new pulses don't get wiped.
+	TArray<FQuartzVisualPulseHandle> HandlesToRemove;
+	HandlesToRemove.Reserve(QuartzVisualEntries.Num());
+	for(int32 Index = 0; Index < QuartzVisualEntries.Num(); Index++)
+	{
+		HandlesToRemove.Add(QuartzVisualEntries.GetHandle(Index));
+	}
+
+	// Back to front, so each removal is the last entry and nothing has to move.
+	for(int32 HandleIndex = HandlesToRemove.Num() - 1; HandleIndex >= 0; HandleIndex--)
+	{
+		const int32 DenseIndex = QuartzVisualEntries.GetDenseIndex(HandlesToRemove[HandleIndex]);
+		if(DenseIndex != INDEX_NONE)
+		{
+			FinishQuartzVisualEntryAt(DenseIndex);
+			RemoveQuartzVisualEntry(HandlesToRemove[HandleIndex]);
+		}
+	}
+
+	FlushQuartzVisualInstanceSinks();
+	if(QuartzVisualEntries.Num() == 0)
+	{
+		InstanceSinks.Reset();
+		InstanceSinkLookup.Reset();
+		FreeInstanceSinks.Reset();
+		PulseGroups.Reset();
+	}
+}
+
+void UQuartzVisualSubsystem::FinishQuartzVisualEntryAt(int32 DenseIndex)
+{
+	FQuartzVisualPulseHotData& Hot = QuartzVisualEntries.Hot;
+	if(Hot.Group[DenseIndex] != INDEX_NONE)
+	{
+		// A member removed the pulse from inside its own finish event, the members are already being sent it.
+		if(Hot.State[DenseIndex] == EQuartzVisualPulseState::Finished)
+		{
+			return;
+		}
+		// Every member gets the finish, then the group is done with.
+		const int32 GroupIndex = Hot.Group[DenseIndex];
+		Hot.UpdateValue(DenseIndex, Hot.StartStep[DenseIndex] + Hot.BeatDuration[DenseIndex], 1000.0f, &CurveCache);
+		Hot.State[DenseIndex] = EQuartzVisualPulseState::Finished;
+		PulseGroups[GroupIndex].bFinishing = true;
+		SendQuartzVisualGroupUpdate(DenseIndex, GroupIndex);
+		PulseGroups.RemoveAt(GroupIndex);
+	}
+	else if(Hot.InstanceSink[DenseIndex] != INDEX_NONE)
+	{
+		// Same as CancelAndFinishQuartzVisualEntry, the final value goes to the instance instead of an event.
+		Hot.UpdateValue(DenseIndex, Hot.StartStep[DenseIndex] + Hot.BeatDuration[DenseIndex], 1000.0f, &CurveCache);
+		Hot.State[DenseIndex] = EQuartzVisualPulseState::Finished;
+		WriteQuartzVisualInstanceValue(DenseIndex);
+	}
+	else
+	{
+		CancelAndFinishQuartzVisualEntry(QuartzVisualEntries.AssembleEntry(DenseIndex), Hot.NativeInterface[DenseIndex]);
+	}
+}
+
+void UQuartzVisualSubsystem::InitializeQuartzVisualListener(AActor* InActor)
+{
+	const bool bWantsBatchedUpdates = IQuartzVisualsInterface::Execute_WantsBatchedQuartzVisualUpdates(InActor);
+
+	// Only set for native classes, blueprint only implementations can't be cast to the interface.
+	IQuartzVisualsInterface* NativeInterface = Cast<IQuartzVisualsInterface>(InActor);
+	const bool bNativeBatch = NativeInterface && QuartzVisualSubsystemPrivate::IsNativeEvent(InActor, GET_FUNCTION_NAME_CHECKED(IQuartzVisualsInterface, OnQuartzVisualUpdateBatch));
+
+	FQuartzVisualListener& Listener = QuartzVisualEntries.FindOrAddListener(InActor);
+	Listener.bInitialized = true;
+	Listener.bWantsBatchedUpdates = bWantsBatchedUpdates;
+	Listener.NativeInterface = QuartzVisualSubsystemPrivate::FindNativeUpdateInterface(InActor);
+	Listener.NativeBatchInterface = bNativeBatch ? NativeInterface : nullptr;
 }
 
-void UQuartzVisualSubsystem::CancelAndFinishQuartzVisualEntry(FQuartzVisualPulseEntry& QuartzVisualPulseEntry)
+void UQuartzVisualSubsystem::CancelAndFinishQuartzVisualEntry(FQuartzVisualPulseEntry& QuartzVisualPulseEntry, IQuartzVisualsInterface* NativeInterface)
 {
 	if(IsValid(QuartzVisualPulseEntry.Data.Actor))
 	{
@@ -316,8 +2239,7 @@ void UQuartzVisualSubsystem::CancelAndFinishQuartzVisualEntry(FQuartzVisualPulse
 		// Force the end event.
 		QuartzVisualPulseEntry.UpdateValue(1000.0f);
 		QuartzVisualPulseEntry.State = EQuartzVisualPulseState::Finished;
-		IQuartzVisualsInterface::Execute_OnQuartzVisualUpdate(QuartzVisualPulseEntry.Data.Actor, QuartzVisualPulseEntry);
+		QuartzVisualSubsystemPrivate::SendUpdate(QuartzVisualPulseEntry.Data.Actor, NativeInterface, QuartzVisualPulseEntry);
 		//QuartzVisualPulseEntry.Data.Actor->Execute(QuartzVisualPulseEntry);
 	}
 }
-PRAGMA_ENABLE_OPTIMIZATION
@@ -0,0 +1,144 @@
+// Copyright Zuko Media 2023 all rights reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "ISubmixBufferListener.h"
+#include "Containers/CircularQueue.h"
+#include "Containers/StaticArray.h"
+#include <atomic>
+
+// A step boundary found on the audio render thread.
+struct FQuartzVisualAudioBeat
+{
+	int32 Step = 0;
+	// Anchor the step was counted from, boundaries of older anchors are dropped.
+	int32 Generation = 0;
+	// When the boundary is rendered, in FPlatformTime::Seconds. Mapped from its position in the render clock.
+	double PlatformSeconds = 0.0;
+};
+
+/**
+ * Finds step boundaries in the rendered audio instead of waiting for the metronome delegate on the game thread.
+ * The grid is kept in the render clock (the AudioClock of each submix buffer), so boundaries are sample accurate to each other
+ * and don't depend on when the render thread or the game thread happened to run. They reach the game thread through a
+ * single producer single consumer queue.
+ *
+ * The grid belongs to the render thread. The game thread sends it rate, anchor and correction commands through a second
+ * single producer single consumer queue, and reads back where the grid was after the last buffer from a seqlock, so neither
+ * thread ever waits on the other.
+ *
+ * Quartz events number the steps and correct the phase. The game thread only sees an event once quartz has rendered its boundary,
+ * so comparing the event's step with how far the grid had rendered by then can only show the grid as late as the delivery delay.
+ * The smallest of those differences over the last few events is the grid's error, and the grid moves as soon as it is off
+ * by more than QuartzVisuals.AudioFeedMaxDrift of a step. How far the audio has rendered moves a buffer at a time, which leaves
+ * the phase within about one render buffer of quartz's. 5.1 gives plugins nothing closer to quartz's own render-thread tick.
+ *
+ * A boundary is due once the buffer holding it has been rendered. It is heard one device output latency later, a constant of the device
+ * that OutputLatencyMs covers, and it is stepped on the first game frame after it is due, so visuals trail the audio by up to one frame more.
+ * Works on the null audio device too, it renders buffers like any other device.
+ */
+class QUARTZVISUALS_API FQuartzVisualAudioBeatFeed : public ISubmixBufferListener
+{
+public:
+
+	// Game thread. Rate of the grid, 0 stops it. The grid keeps its position over a change.
+	void SetStepsPerSecond(float InStepsPerSecond);
+
+	// Game thread. Restarts the grid from Step at the start of the next buffer, for the first event and when quartz jumps.
+	void Anchor(int32 Step);
+
+	// Game thread. Compares a quartz event for Step with the grid and moves the grid when it is off by more than MaxDriftSteps.
+	void Correct(int32 Step, float MaxDriftSteps);
+
+	// Game thread. Takes the oldest boundary due before NowSeconds, skipping those of earlier anchors.
+	bool DequeueDue(double NowSeconds, FQuartzVisualAudioBeat& OutBeat);
+
+	// Boundaries lost because the game thread fell more than the queue size behind.
+	int32 GetNumDropped() const
+	{
+		return NumDropped.load(std::memory_order_relaxed);
+	}
+
+	// Audio render thread.
+	virtual void OnNewSubmixBuffer(const USoundSubmix* OwningSubmix, float* AudioData, int32 NumSamples, int32 NumChannels, const int32 SampleRate, double AudioClock) override;
+
+private:
+
+	static constexpr int32 NumLatenessSamples = 8;
+	// Seconds the render to platform clock mapping gives up per buffer, so it follows the two clocks drifting apart.
+	static constexpr double PlatformOffsetRelaxSeconds = 1.0e-5;
+
+	enum class ECommand : uint8
+	{
+		SetRate,
+		Anchor,
+		// Moves step 0 by Value steps of the current rate, negative is earlier.
+		Shift,
+	};
+
+	struct FCommand
+	{
+		ECommand Type = ECommand::SetRate;
+		int32 Step = 0;
+		int32 Generation = 0;
+		// Steps per second for SetRate, steps for Shift.
+		double Value = 0.0;
+	};
+
+	struct FGrid
+	{
+		// Render clock at which step 0 falls.
+		double StepZeroClock = 0.0;
+		double StepsPerSecond = 0.0;
+		int32 AnchorStep = 0;
+		int32 Generation = 0;
+		// Anchored while stopped, AnchorStep is placed at the start of the first buffer with a rate.
+		bool bPlacePending = false;
+	};
+
+	// What the game thread knows of the grid, as of the end of the last rendered buffer.
+	struct FGridSnapshot
+	{
+		// Negative until the first buffer.
+		double RenderedClock = -1.0;
+		double StepZeroClock = 0.0;
+		double StepsPerSecond = 0.0;
+		// Commands applied so far, the grid still has some to catch up on while this is behind NumCommandsSent.
+		uint32 NumCommands = 0;
+	};
+
+	// Game thread.
+	void SendCommand(const FCommand& Command);
+	FGridSnapshot ReadSnapshot() const;
+
+	// Audio render thread.
+	void ApplyCommand(const FCommand& Command, double AudioClock);
+	void PublishSnapshot(double RenderedClock);
+
+	// Only touched on the render thread.
+	FGrid Grid;
+	int32 LastEmittedStep = 0;
+	double PlatformOffset = TNumericLimits<double>::Max();
+	uint32 NumCommandsApplied = 0;
+
+	// Only touched on the game thread.
+	int32 Generation = 0;
+	double StepsPerSecond = 0.0;
+	uint32 NumCommandsSent = 0;
+	// Steps past the event's step the grid had rendered, for the last few events.
+	TStaticArray<float, NumLatenessSamples> Lateness;
+	int32 NumLateness = 0;
+
+	// The snapshot, written by the render thread. Odd while it is being written.
+	std::atomic<uint32> SnapshotSequence { 0 };
+	std::atomic<double> SnapshotRenderedClock { -1.0 };
+	std::atomic<double> SnapshotStepZeroClock { 0.0 };
+	std::atomic<double> SnapshotStepsPerSecond { 0.0 };
+	std::atomic<uint32> SnapshotNumCommands { 0 };
+
+	std::atomic<int32> NumDropped { 0 };
+
+	TCircularQueue<FCommand> Commands { 64 };
+	TCircularQueue<FQuartzVisualAudioBeat> Beats { 256 };
+};
@@ -0,0 +1,56 @@
+// Copyright Zuko Media 2023 all rights reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ * Continuous position of a quartz clock, in quantization steps. Quantization events only arrive on the game thread
+ * a few times per beat, so the position is advanced every frame from the clock's rate and pulled towards each
+ * event as it comes in. Corrections change the rate, faster or slower, instead of the position so the phase never runs backwards.
+ */
+struct QUARTZVISUALS_API FQuartzVisualBeatPhaseEstimator
+{
+	// Called for every quantization event. Step is the event's step count, StepsPerSecond the current rate of the clock.
+	// AgeSeconds is how long ago the step boundary was, for events that carry their own timestamp.
+	void OnStep(int32 Step, float StepsPerSecond, float AgeSeconds = 0.0f);
+
+	// Moves the estimate forward by frame time. MaxStepsAhead is the step the next event is expected on,
+	// the estimate runs on LateStepSlack past it for late events and holds there.
+	void Advance(float DeltaSeconds, int32 MaxStepsAhead = 1);
+
+	// Events late by up to this many steps are predicted through instead of holding the estimate at the next step.
+	static constexpr int32 LateStepSlack = 1;
+
+	// Estimated position LatencySeconds ago, so visuals can be held back to match the audible output.
+	double GetPosition(float LatencySeconds = 0.0f) const
+	{
+		return Position - static_cast<double>(LatencySeconds * StepsPerSecond);
+	}
+
+	// How far past Step the (latency offset) estimate is, in steps. Clamped to -1 - 1 + LateStepSlack.
+	float GetStepPhase(int32 Step, float LatencySeconds = 0.0f) const
+	{
+		return LastStep == INDEX_NONE ? 0.0f : FMath::Clamp(static_cast<float>(GetPosition(LatencySeconds) - static_cast<double>(Step)), -1.0f, 1.0f + LateStepSlack);
+	}
+
+	bool IsLocked() const
+	{
+		return LastStep != INDEX_NONE;
+	}
+
+	int32 GetLastStep() const
+	{
+		return LastStep;
+	}
+
+	void Reset();
+
+private:
+
+	double Position = 0.0;
+	float StepsPerSecond = 0.0f;
+	// Rate adjustment that removes the error measured at the last event over the following step, negative when ahead.
+	float RateCorrection = 0.0f;
+	int32 LastStep = INDEX_NONE;
+};
@@ -0,0 +1,88 @@
+// Copyright Zuko Media 2023 all rights reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "UObject/ObjectKey.h"
+
+class UCurveFloat;
+class UCurveBase;
+
+extern QUARTZVISUALS_API int32 GQuartzVisualsCurveTableResolution;
+
+/* A value curve sampled at a fixed resolution over the 0 - 1 pulse progress. */
+struct QUARTZVISUALS_API FQuartzVisualCurveTable
+{
+	TArray<float> Samples;
+
+	void Bake(const UCurveFloat* Curve, int32 Resolution);
+
+	// Linear interpolation between the two closest samples, Time is clamped to 0 - 1.
+	FORCEINLINE float Evaluate(const float Time) const
+	{
+		const float Position = FMath::Clamp(Time, 0.0f, 1.0f) * static_cast<float>(Samples.Num() - 1);
+		const int32 Lower = FMath::Min(FMath::FloorToInt(Position), Samples.Num() - 2);
+		return FMath::Lerp(Samples[Lower], Samples[Lower + 1], Position - static_cast<float>(Lower));
+	}
+
+	// Largest difference to the exact curve, checked halfway between samples where the error peaks.
+	float MeasureMaxError(const UCurveFloat* Curve) const;
+};
+
+/**
+ * Baked tables for every distinct value curve used by pulses. Tables are indexed so pulses can hold on to an
+ * int32, indices stay valid until the table is pruned or Reset. Edited curves are rebaked in place (editor only).
+ */
+struct QUARTZVISUALS_API FQuartzVisualCurveCache
+{
+	~FQuartzVisualCurveCache();
+
+	// Returns the table index for the curve, baking it if needed.
+	int32 FindOrBake(const UCurveFloat* Curve);
+
+	const FQuartzVisualCurveTable& GetTable(const int32 TableIndex) const
+	{
+		return Tables[TableIndex];
+	}
+
+	const FQuartzVisualCurveTable* GetTables() const
+	{
+		return Tables.GetData();
+	}
+
+	// Rebakes every table if the resolution setting changed. Call before evaluating.
+	void Refresh();
+
+	// Releases every table not set in UsedTables, their indices are handed out again by FindOrBake.
+	void Prune(const TBitArray<>& UsedTables);
+
+	void Reset();
+
+	// Tables baked right now, released ones don't count.
+	int32 Num() const
+	{
+		return Tables.Num() - FreeTables.Num();
+	}
+
+private:
+
+	void Rebake(int32 TableIndex);
+
+	void Release(int32 TableIndex);
+
+#if WITH_EDITOR
+	void OnCurveUpdated(UCurveBase* Curve, EPropertyChangeType::Type ChangeType);
+#endif
+
+	TArray<FQuartzVisualCurveTable> Tables;
+	// Weak so a cached table never keeps its curve loaded, a null key is a released table.
+	TArray<TObjectKey<UCurveFloat>> TableCurves;
+	TMap<TObjectKey<UCurveFloat>, int32> TableLookup;
+	TArray<int32> FreeTables;
+
+#if WITH_EDITOR
+	TArray<FDelegateHandle> CurveUpdatedHandles;
+#endif
+
+	int32 BakedResolution = 0;
+};
@@ -20,4 +20,15 @@ public:
 	UFUNCTION(BlueprintCallable, BlueprintNativeEvent)
 	void OnQuartzVisualUpdate(const FQuartzVisualPulseEntry& PulseData);
 	virtual void OnQuartzVisualUpdate_Implementation(const FQuartzVisualPulseEntry& PulseData);
+
+	// Return true to receive the per-frame updates of all pulses at once through OnQuartzVisualUpdateBatch instead of OnQuartzVisualUpdate.
+	// Start and finish events still go through OnQuartzVisualUpdate. Asked once when the actor gets its first pulse.
+	UFUNCTION(BlueprintCallable, BlueprintNativeEvent)
+	bool WantsBatchedQuartzVisualUpdates() const;
+	virtual bool WantsBatchedQuartzVisualUpdates_Implementation() const;
+
+	// Happens once per frame with every updating pulse of this actor (Interpolated values)
+	UFUNCTION(BlueprintCallable, BlueprintNativeEvent)
+	void OnQuartzVisualUpdateBatch(const TArray<FQuartzVisualPulseUpdate>& PulseUpdates);
+	virtual void OnQuartzVisualUpdateBatch_Implementation(const TArray<FQuartzVisualPulseUpdate>& PulseUpdates);
 };
\ No newline at end of file
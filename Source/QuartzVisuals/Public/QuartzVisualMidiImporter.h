@@ -0,0 +1,24 @@
+// Copyright Zuko Media 2023 all rights reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "QuartzVisualPulseTrack.h"
+
+/**
+ * Turns a standard MIDI file (format 0 or 1, tick based timing) into pulse track pulses. Every note becomes a pulse:
+ * note number to Index, channel to IndexFilter, velocity to the payload. Timing is kept in beats, tempo changes are
+ * ignored as the quartz clock sets the tempo on playback.
+ */
+namespace QuartzVisualMidiImporter
+{
+	/**
+	 * @param StepsPerBeat	Resolution notes are quantized to, 8 for 32nd notes. Should match the clock's quantization.
+	 * @param OutPulses		Receives the pulses sorted by start step.
+	 * @param OutError		Set when the file can't be read.
+	 */
+	QUARTZVISUALS_API bool ConvertMidi(const TArray<uint8>& MidiData, int32 StepsPerBeat, TArray<FQuartzVisualTrackPulse>& OutPulses, FString& OutError);
+
+	// Reads MidiFilePath and writes the track to TrackFilePath.
+	QUARTZVISUALS_API bool ImportMidiFile(const FString& MidiFilePath, const FString& TrackFilePath, int32 StepsPerBeat, FString& OutError);
+}
@@ -0,0 +1,44 @@
+// Copyright Zuko Media 2023 all rights reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "QuartzVisualCurveCache.h"
+#include "QuartzVisualSharedTypes.h"
+
+/**
+ * Batch versions of the per-entry math in FQuartzVisualPulseEntry, working on contiguous arrays
+ * (see FQuartzVisualPulseHotData). Results match the scalar path up to float rounding.
+ */
+namespace QuartzVisualPulseKernels
+{
+	/**
+	 * Progress, value and interpolation for pulses of one value variant, each variant has its own specialization
+	 * so nothing is checked per pulse. Processes four lanes at a time, curve lookups one lane at a time.
+	 * Every lane in [0, Num) is evaluated, callers pick which results to keep.
+	 * @param Variant		Variant of every pulse in the range, None does nothing.
+	 * @param CurrentStep	Last step completed by each pulse's clock.
+	 * @param SubStep		How far into the following step the clock is, 0 - 1. 1 gives whole step progress.
+	 * @param CurveTable	Baked table of each pulse, only read by the curve variants.
+	 * @param CurrentValue	Last OutValue of each pulse, interpolated from.
+	 * @param OutNormalized	Receives the 0 - 1 beat progress.
+	 * @param OutValue		Receives the interpolated value. May alias CurrentValue.
+	 * @param DeltaSeconds	Interpolation delta time of each pulse (clocks scale it by their BPM).
+	 */
+	QUARTZVISUALS_API void EvaluateValues(
+		const EQuartzVisualValueVariant Variant,
+		const int32* RESTRICT CurrentStep,
+		const int32* RESTRICT StartStep,
+		const int32* RESTRICT BeatDuration,
+		const float* RESTRICT SubStep,
+		const int32* RESTRICT CurveTable,
+		const FQuartzVisualCurveTable* RESTRICT Tables,
+		const float* RESTRICT OutValueMin,
+		const float* RESTRICT OutValueMax,
+		const float* RESTRICT InterpSpeed,
+		const float* CurrentValue,
+		float* RESTRICT OutNormalized,
+		float* OutValue,
+		const float* RESTRICT DeltaSeconds,
+		const int32 Num);
+}
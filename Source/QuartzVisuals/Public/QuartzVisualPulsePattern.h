@@ -0,0 +1,90 @@
+// Copyright Zuko Media 2023 all rights reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Engine/DataAsset.h"
+#include "QuartzVisualSharedTypes.h"
+#include "QuartzVisualPulsePattern.generated.h"
+
+/* One pulse of a pattern. Index and IndexFilter come from the settings. */
+USTRUCT(BlueprintType)
+struct QUARTZVISUALS_API FQuartzVisualPatternPulse
+{
+	GENERATED_USTRUCT_BODY()
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	FQuartzVisualPulseSettings Settings;
+
+	/* Beats from the start of the pattern */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (ClampMin = 0))
+	int32 BeatOffset = 0;
+
+	/* How many beats should this pulse last Has to be at least 1*/
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (ClampMin = 1))
+	int32 BeatDuration = 1;
+};
+
+/**
+ * A bar (or any length) of pulses authored once and scheduled onto actors in one call, see AddQuartzVisualPulsePattern.
+ * Compiled the first time it's played after a change: sorted by offset, durations clamped, and pulses sharing an Index,
+ * IndexFilter and BeatOffset reduced to the last one. The same Index and IndexFilter at other offsets are further hits
+ * of it, each is played.
+ */
+UCLASS(BlueprintType)
+class QUARTZVISUALS_API UQuartzVisualPulsePattern : public UPrimaryDataAsset
+{
+	GENERATED_BODY()
+
+public:
+
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category="Pattern")
+	TArray<FQuartzVisualPatternPulse> Pulses;
+
+	// Pulses ready to schedule, compiled first if they changed.
+	const TArray<FQuartzVisualPatternPulse>& GetCompiledPulses()
+	{
+		ConditionalCompile();
+		return CompiledPulses;
+	}
+
+	/* Beats from the start of the pattern to the end of its last pulse */
+	UFUNCTION(BlueprintPure)
+	int32 GetPatternLength()
+	{
+		ConditionalCompile();
+		return PatternLength;
+	}
+
+	// Call after changing Pulses from code, the editor and loading do it already.
+	void MarkPulsesDirty()
+	{
+		bCompileDirty = true;
+	}
+
+	void ConditionalCompile()
+	{
+		if(bCompileDirty)
+		{
+			Compile();
+		}
+	}
+
+	void Compile();
+
+	virtual void PostLoad() override;
+#if WITH_EDITOR
+	virtual void PostEditChangeProperty(FPropertyChangedEvent& PropertyChangedEvent) override;
+	virtual EDataValidationResult IsDataValid(TArray<FText>& ValidationErrors) override;
+#endif
+
+private:
+
+	UPROPERTY(Transient)
+	TArray<FQuartzVisualPatternPulse> CompiledPulses;
+
+	int32 PatternLength = 0;
+
+	// Set until the first compile, so patterns made at runtime compile too.
+	bool bCompileDirty = true;
+};
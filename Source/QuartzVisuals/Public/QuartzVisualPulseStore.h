@@ -0,0 +1,334 @@
+// Copyright Zuko Media 2023 all rights reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Curves/CurveFloat.h"
+#include "QuartzVisualSharedTypes.h"
+#include "QuartzVisualCurveCache.h"
+
+/* How often an actor's pulses are sent mid-pulse updates. Start and finish are always sent. */
+enum class EQuartzVisualSignificance : uint8
+{
+	Full,
+	// Every few frames, see QuartzVisuals.Significance.ReducedInterval
+	Reduced,
+	EventsOnly
+};
+
+/**
+ * Per-frame fields of every pulse, one array per field (same dense order as the store).
+ * Mirrors the math in FQuartzVisualPulseEntry so the frame loop never has to touch settings, names or payloads.
+ */
+struct QUARTZVISUALS_API FQuartzVisualPulseHotData
+{
+	TArray<AActor*> Actor;
+	// Clock the pulse follows and where it sits in that clock's bucket.
+	TArray<int32> Clock;
+	TArray<int32> ClockBucketPosition;
+	// Clock step the pulse starts on. Progress comes from the clock's step, pulses don't count beats themselves.
+	TArray<int32> StartStep;
+	TArray<int32> BeatDuration;
+	TArray<EQuartzVisualPulseState> State;
+	// Fixed when the pulse is added, the store keeps each variant in one contiguous range.
+	TArray<EQuartzVisualValueVariant> Variant;
+	TArray<UCurveFloat*> ValueCurve;
+	// Index into FQuartzVisualCurveCache, INDEX_NONE until the subsystem assigns the baked table.
+	TArray<int32> CurveTable;
+	TArray<float> OutValueMin;
+	TArray<float> OutValueMax;
+	TArray<float> InterpSpeed;
+	TArray<float> OutValueNormalized;
+	TArray<float> OutValue;
+	// Copied from the actor's listener, these are sent through OnQuartzVisualUpdateBatch.
+	TArray<bool> Batched;
+	// Copied from the actor's listener, null when the update has to go through reflection.
+	TArray<IQuartzVisualsInterface*> NativeInterface;
+	// Index of the instanced mesh sink the value is written to, INDEX_NONE for pulses sent to the actor.
+	TArray<int32> InstanceSink;
+	// Copied from the actor's listener.
+	TArray<EQuartzVisualSignificance> Significance;
+	// Index of the group the value is sent to, INDEX_NONE for pulses of a single actor. Group pulses have no actor.
+	TArray<int32> Group;
+
+	void Add(const FQuartzVisualPulseEntry& Entry);
+	void Reserve(int32 Number);
+	void RemoveAtSwap(int32 Index);
+	void Swap(int32 IndexA, int32 IndexB);
+	void Reset();
+
+	int32 Num() const
+	{
+		return StartStep.Num();
+	}
+
+	// Same as FQuartzVisualPulseEntry::GetBeatProgress. ClockStep is the last step the pulse's clock completed.
+	FORCEINLINE float GetBeatProgress(const int32 Index, const int32 ClockStep) const
+	{
+		return static_cast<float>(FMath::Clamp(ClockStep + 1 - StartStep[Index], 0, BeatDuration[Index])) / static_cast<float>(BeatDuration[Index]);
+	}
+
+	// Same as FQuartzVisualPulseEntry::UpdateValue, baked curve tables are used when given.
+	void UpdateValue(const int32 Index, const int32 ClockStep, const float DeltaSeconds, const FQuartzVisualCurveCache* CurveCache = nullptr)
+	{
+		// Only update if we are using a value
+		const EQuartzVisualValueVariant ValueVariant = Variant[Index];
+		if(ValueVariant != EQuartzVisualValueVariant::None)
+		{
+			const float Progress = GetBeatProgress(Index, ClockStep);
+			OutValueNormalized[Index] = Progress;
+			float NewValue = Progress;
+			// Use the value curve
+			if(ValueVariant == EQuartzVisualValueVariant::Curve || ValueVariant == EQuartzVisualValueVariant::CurveRemap)
+			{
+				NewValue = CurveCache && CurveTable[Index] != INDEX_NONE ? CurveCache->GetTable(CurveTable[Index]).Evaluate(Progress) : ValueCurve[Index]->GetFloatValue(Progress);
+			}
+			if(ValueVariant == EQuartzVisualValueVariant::Remap || ValueVariant == EQuartzVisualValueVariant::CurveRemap)
+			{
+				NewValue = FMath::Lerp(OutValueMin[Index], OutValueMax[Index], NewValue);
+			}
+			OutValue[Index] = FMath::FInterpTo(OutValue[Index], NewValue, DeltaSeconds, InterpSpeed[Index]);
+		}
+	}
+};
+
+/* Everything the store knows about one actor receiving pulses. Lives while the actor has at least one pulse. */
+struct FQuartzVisualListener
+{
+	TWeakObjectPtr<AActor> Actor;
+
+	TArray<FQuartzVisualPulseHandle> Pulses;
+
+	// Filled in by the subsystem before the actor's first pulse is added.
+	bool bInitialized = false;
+	bool bWantsBatchedUpdates = false;
+
+	EQuartzVisualSignificance Significance = EQuartzVisualSignificance::Full;
+
+	// Set when the actor is native and the event is not overridden in blueprint, so it can be called directly.
+	IQuartzVisualsInterface* NativeInterface = nullptr;
+	IQuartzVisualsInterface* NativeBatchInterface = nullptr;
+};
+
+// Pulses due on one clock step, see FQuartzVisualPulseStore::CollectDuePulses.
+using FQuartzVisualDuePulses = TArray<FQuartzVisualPulseHandle, TInlineAllocator<16>>;
+
+/**
+ * Pooled storage for pulse entries.
+ * Entries are kept densely packed for iteration, grouped by value variant so each variant's kernel runs over one
+ * contiguous range. Adding and removing swaps entries across the variant boundaries. Handles point at slots which
+ * redirect to the dense index, so they stay valid while other entries move around.
+ * Hot per-frame fields live in Hot, everything else stays in a cold FQuartzVisualPulseEntry which is only
+ * brought up to date when it gets dispatched (AssembleEntry).
+ * Each clock schedules its pulses on a timing wheel by the step they start and finish on, so a step only visits
+ * the pulses due on it.
+ */
+struct QUARTZVISUALS_API FQuartzVisualPulseStore
+{
+	// Adds the entry and registers it in the lookups and the clock's bucket. The key must not already exist.
+	FQuartzVisualPulseHandle Add(const FQuartzVisualPulseEntry& NewEntry, const int32 ClockIndex, const UObject* Sink = nullptr)
+	{
+		return Add(NewEntry, ClockIndex, FQuartzVisualPulseKey(NewEntry, Sink));
+	}
+
+	// Same with a key that doesn't come from the entry, for pulses that aren't identified by their actor.
+	// Group pulses (GroupIndex set) have no actor and no listener, their members are registered with AddGroupMember.
+	FQuartzVisualPulseHandle Add(const FQuartzVisualPulseEntry& NewEntry, int32 ClockIndex, const FQuartzVisualPulseKey& Key, int32 GroupIndex = INDEX_NONE);
+
+	// Last step the clock completed. New pulses count their offset from it.
+	int32 GetClockStep(const int32 ClockIndex) const
+	{
+		return ClockSchedules.IsValidIndex(ClockIndex) ? ClockSchedules[ClockIndex].Step : 0;
+	}
+
+	// Completes the step. Pulses due on it have to be collected first.
+	void SetClockStep(int32 ClockIndex, int32 Step);
+
+	// Moves the clock to Step keeping every pulse's remaining beats, for the first event and jumps. Rebuilds the clock's wheel.
+	void RebaseClock(int32 ClockIndex, int32 Step);
+
+	// Takes the pulses starting and finishing on Step out of the wheel, in the order they were scheduled. Entries of removed pulses are dropped.
+	void CollectDuePulses(int32 ClockIndex, int32 Step, FQuartzVisualDuePulses& OutStarting, FQuartzVisualDuePulses& OutFinishing);
+
+	// Handles of every pulse following the clock, in no particular order.
+	const TArray<FQuartzVisualPulseHandle>& GetClockBucket(const int32 ClockIndex) const
+	{
+		static const TArray<FQuartzVisualPulseHandle> EmptyBucket;
+		return ClockBuckets.IsValidIndex(ClockIndex) ? ClockBuckets[ClockIndex] : EmptyBucket;
+	}
+
+	// Makes room for NumToAdd more entries, for adding many at once.
+	void Reserve(int32 NumToAdd);
+
+	// Returns the actor's listener, creating an uninitialized one if it has no pulses yet.
+	FQuartzVisualListener& FindOrAddListener(AActor* Actor);
+
+	// Returns false if the handle is stale.
+	bool Remove(const FQuartzVisualPulseHandle& Handle);
+
+	// Removes the entry at the dense index. Entries of later variants move down to keep the ranges together.
+	void RemoveAt(int32 DenseIndex);
+
+	void Reset();
+
+	// Returns INDEX_NONE if the handle is stale.
+	int32 GetDenseIndex(const FQuartzVisualPulseHandle& Handle) const;
+
+	FQuartzVisualPulseHandle GetHandle(const int32 DenseIndex) const
+	{
+		const int32 SlotIndex = DenseToSlot[DenseIndex];
+		return FQuartzVisualPulseHandle(SlotIndex, Slots[SlotIndex].Generation);
+	}
+
+	FQuartzVisualPulseHandle Find(const FQuartzVisualPulseKey& Key) const
+	{
+		const FQuartzVisualPulseHandle* Handle = Lookup.Find(Key);
+		return Handle ? *Handle : FQuartzVisualPulseHandle();
+	}
+
+	const TArray<FQuartzVisualPulseHandle>* FindActorHandles(const AActor* Actor) const
+	{
+		const FQuartzVisualListener* Listener = Listeners.Find(TObjectKey<AActor>(Actor));
+		return Listener ? &Listener->Pulses : nullptr;
+	}
+
+	// Group pulses the actor is a member of. Dropped with the pulse, or with RemoveGroupMember.
+	void AddGroupMember(const FQuartzVisualPulseHandle& Handle, const AActor* Actor);
+	void RemoveGroupMember(const FQuartzVisualPulseHandle& Handle, const AActor* Actor);
+
+	const TArray<FQuartzVisualPulseHandle>* FindActorGroupHandles(const AActor* Actor) const
+	{
+		return GroupMemberships.Find(TObjectKey<AActor>(Actor));
+	}
+
+	const FQuartzVisualListener* FindListener(const AActor* Actor) const
+	{
+		return Listeners.Find(TObjectKey<AActor>(Actor));
+	}
+
+	const TMap<TObjectKey<AActor>, FQuartzVisualListener>& GetListeners() const
+	{
+		return Listeners;
+	}
+
+	// Asks Evaluate for the significance of every listening actor and mirrors changes into its pulses.
+	void UpdateSignificance(TFunctionRef<EQuartzVisualSignificance(const AActor*)> Evaluate);
+
+	// Copies the hot fields into the cold entry and returns it, ready to send to the actor.
+	FQuartzVisualPulseEntry& AssembleEntry(int32 DenseIndex);
+
+	// Compact version of AssembleEntry for batched updates, only reads hot data.
+	FQuartzVisualPulseUpdate MakeUpdate(const int32 DenseIndex) const
+	{
+		FQuartzVisualPulseUpdate Update;
+		Update.Handle = GetHandle(DenseIndex);
+		Update.Index = Keys[DenseIndex].Index;
+		Update.IndexFilter = Keys[DenseIndex].IndexFilter;
+		Update.State = Hot.State[DenseIndex];
+		Update.OutValueNormalized = Hot.OutValueNormalized[DenseIndex];
+		Update.OutValue = Hot.OutValue[DenseIndex];
+		return Update;
+	}
+
+	const FQuartzVisualPulseKey& GetKey(const int32 DenseIndex) const
+	{
+		return Keys[DenseIndex];
+	}
+
+	// Settings as added. The value curve is kept up to date in Hot, the rest never changes.
+	const FQuartzVisualPulseSettings& GetSettings(const int32 DenseIndex) const
+	{
+		return Cold[DenseIndex].Settings;
+	}
+
+	int32 Num() const
+	{
+		return Cold.Num();
+	}
+
+	// Dense range [GetVariantStart, GetVariantEnd) holds every pulse of the variant. Variants follow each other in enum order.
+	int32 GetVariantStart(const EQuartzVisualValueVariant Variant) const
+	{
+		return Variant == EQuartzVisualValueVariant::None ? 0 : VariantEnd[static_cast<int32>(Variant) - 1];
+	}
+
+	int32 GetVariantEnd(const EQuartzVisualValueVariant Variant) const
+	{
+		return VariantEnd[static_cast<int32>(Variant)];
+	}
+
+	bool IsValidIndex(const int32 DenseIndex) const
+	{
+		return Cold.IsValidIndex(DenseIndex);
+	}
+
+	// Returns true if the slots and lookups match the dense entries exactly.
+	bool Validate() const;
+
+	void AddReferencedObjects(FReferenceCollector& Collector);
+
+	FQuartzVisualPulseHotData Hot;
+
+private:
+
+	struct FSlot
+	{
+		int32 DenseIndex = INDEX_NONE;
+		int32 Generation = 1;
+	};
+
+	// Settings, payload and names. Only read when dispatching.
+	TArray<FQuartzVisualPulseEntry> Cold;
+
+	// Keys for each entry (same order). Captured on add so removal works even after the actor is gone.
+	TArray<FQuartzVisualPulseKey> Keys;
+	TArray<int32> DenseToSlot;
+
+	// Sparse, handles index into these.
+	TArray<FSlot> Slots;
+	TArray<int32> FreeSlots;
+
+	// (Actor, Index, IndexFilter) to the handle of the entry
+	TMap<FQuartzVisualPulseKey, FQuartzVisualPulseHandle> Lookup;
+
+	// Actor to its listener, which holds the handles of all of its entries
+	TMap<TObjectKey<AActor>, FQuartzVisualListener> Listeners;
+
+	// Member to the group pulses it is in, and each group pulse to its members. Keys, so destroyed members are still dropped with their pulse.
+	TMap<TObjectKey<AActor>, TArray<FQuartzVisualPulseHandle>> GroupMemberships;
+	TMap<FQuartzVisualPulseHandle, TArray<TObjectKey<AActor>>> GroupMembers;
+
+	// Clock index to the handles of its entries. Swap removed, positions are tracked in Hot.ClockBucketPosition.
+	TArray<TArray<FQuartzVisualPulseHandle>> ClockBuckets;
+
+	// Steps per turn of the timing wheel. Pulses further out wait in their slot for later turns.
+	static constexpr int32 TimingWheelSize = 256;
+
+	struct FScheduledPulse
+	{
+		FQuartzVisualPulseHandle Handle;
+		int32 Step = 0;
+		bool bFinish = false;
+	};
+
+	struct FClockSchedule
+	{
+		int32 Step = 0;
+		// Slot Step & (TimingWheelSize - 1). Removing a pulse leaves its entries behind, they are dropped the next time their slot comes round.
+		TArray<TArray<FScheduledPulse>> Wheel;
+	};
+
+	// Clock index to its step and wheel, same size as ClockBuckets.
+	TArray<FClockSchedule> ClockSchedules;
+
+	// End of each variant's dense range.
+	int32 VariantEnd[static_cast<int32>(EQuartzVisualValueVariant::Num)] = {};
+
+	// Exchanges two dense entries, handles follow them.
+	void SwapDense(int32 DenseIndexA, int32 DenseIndexB);
+
+	void AddClock(int32 ClockIndex);
+
+	// Puts the pulse's start (if still ahead) and finish on its clock's wheel.
+	void Schedule(int32 DenseIndex);
+};
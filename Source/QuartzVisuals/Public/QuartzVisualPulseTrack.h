@@ -0,0 +1,87 @@
+// Copyright Zuko Media 2023 all rights reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+class IMappedFileHandle;
+class IMappedFileRegion;
+
+/* One pulse of a track file, 12 bytes. Track files hold these sorted by StartStep, straight after the header. */
+struct FQuartzVisualTrackPulse
+{
+	// Steps from the start of the track, StepsPerBeat of the header per beat.
+	int32 StartStep = 0;
+	int32 DurationSteps = 1;
+	// Index of the pulse.
+	uint8 Note = 0;
+	// IndexFilter of the pulse.
+	uint8 Channel = 0;
+	// Payload of the pulse, 1 - 127.
+	uint8 Velocity = 0;
+	uint8 Reserved = 0;
+};
+static_assert(sizeof(FQuartzVisualTrackPulse) == 12, "Track pulses are read straight from the file");
+
+struct FQuartzVisualTrackHeader
+{
+	static constexpr uint32 TrackMagic = 0x54505651; // QVPT
+	static constexpr int32 TrackVersion = 1;
+
+	uint32 Magic = TrackMagic;
+	int32 Version = TrackVersion;
+	// Resolution the steps were quantized to when importing.
+	int32 StepsPerBeat = 8;
+	int32 NumPulses = 0;
+	// End of the last pulse, in steps.
+	int32 LengthSteps = 0;
+	int32 Reserved = 0;
+};
+static_assert(sizeof(FQuartzVisualTrackHeader) == 24, "The header is read straight from the file");
+
+/**
+ * A track file mapped into memory. Only the pages around the pulses being read are ever loaded,
+ * so the length of the track makes no difference to memory use.
+ * Files inside a pak can't be mapped, packaged projects need
+ * +DirectoriesToAlwaysStageAsNonUFS=(Path="PulseTracks") under [/Script/UnrealEd.ProjectPackagingSettings] in DefaultGame.ini.
+ * Without it the whole file is loaded instead, with a warning.
+ */
+class QUARTZVISUALS_API FQuartzVisualMappedPulseTrack
+{
+public:
+
+	FQuartzVisualMappedPulseTrack();
+	FQuartzVisualMappedPulseTrack(FQuartzVisualMappedPulseTrack&&);
+	FQuartzVisualMappedPulseTrack& operator=(FQuartzVisualMappedPulseTrack&&);
+	~FQuartzVisualMappedPulseTrack();
+
+	// False (with a warning) if the file is missing or isn't a track of this version.
+	bool Open(const FString& FilePath);
+
+	bool IsOpen() const
+	{
+		return Header != nullptr;
+	}
+
+	const FQuartzVisualTrackHeader& GetHeader() const
+	{
+		return *Header;
+	}
+
+	TConstArrayView<FQuartzVisualTrackPulse> GetPulses() const
+	{
+		return TConstArrayView<FQuartzVisualTrackPulse>(Pulses, Header ? Header->NumPulses : 0);
+	}
+
+	// Writes a track file. Pulses have to be sorted by StartStep.
+	static bool Write(const FString& FilePath, int32 StepsPerBeat, const TArray<FQuartzVisualTrackPulse>& InPulses);
+
+private:
+
+	TUniquePtr<IMappedFileHandle> MappedFile;
+	TUniquePtr<IMappedFileRegion> MappedRegion;
+	// Only used when the file can't be mapped.
+	TArray64<uint8> LoadedBytes;
+	const FQuartzVisualTrackHeader* Header = nullptr;
+	const FQuartzVisualTrackPulse* Pulses = nullptr;
+};
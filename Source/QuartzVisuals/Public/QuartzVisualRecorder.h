@@ -0,0 +1,185 @@
+// Copyright Zuko Media 2023 all rights reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/Actor.h"
+#include "Serialization/MemoryWriter.h"
+#include "Sound/QuartzQuantizationUtilities.h"
+#include "QuartzVisualSharedTypes.h"
+#include "QuartzVisualInterface.h"
+#include "QuartzVisualRecorder.generated.h"
+
+class IFileHandle;
+class UQuartzVisualSubsystem;
+struct FQuartzVisualClockState;
+
+/**
+ * Records in a capture file. Each is a type byte followed by its fields, names and objects are written once and
+ * referred to by id afterwards. A file holds one or more sessions, each starting with Begin.
+ */
+enum class EQuartzVisualRecordType : uint8
+{
+	// Magic and version, resets the name and object ids.
+	Begin,
+	Name,
+	Object,
+	// Timing and subscription of a clock, written when it changes.
+	Clock,
+	Event,
+	// A step found by an audio beat feed.
+	Step,
+	// Delta time of a frame, written once the clocks have stepped and the pulses are about to update.
+	Frame,
+	AddPulse,
+	AddGroupPulse,
+	AddInstancePulse,
+	RemovePulse,
+	RemoveGroupMember,
+	RemoveAll
+};
+
+// What a recorded object is, so the replayer knows how to find it again.
+enum class EQuartzVisualRecordedObject : uint8
+{
+	// Looked up by path, replaced by a stand-in when it doesn't exist.
+	Actor,
+	// Loaded by path.
+	Asset,
+	// Looked up by path, pulses on it are skipped when it doesn't exist.
+	Component
+};
+
+/**
+ * Writes everything that reaches the subsystem from outside (quantization events, tempo and subscription changes,
+ * pulse adds and removes) to an append-only file. Records go into a buffer allocated once at start and are written
+ * out when it fills up, nothing is allocated per record. Game thread only, queued commands are recorded when applied.
+ */
+class QUARTZVISUALS_API FQuartzVisualRecorder
+{
+public:
+
+	static constexpr uint32 FileMagic = 0x31525651; // QVR1
+	// 2 added the pattern repeat to AddPulse.
+	static constexpr int32 FileVersion = 2;
+
+	FQuartzVisualRecorder();
+	~FQuartzVisualRecorder();
+
+	// Appends a new session to the file, creating it if needed.
+	bool Start(const FString& FilePath);
+	void Stop();
+
+	bool IsRecording() const
+	{
+		return FileHandle.IsValid();
+	}
+
+	void RecordClock(const FQuartzVisualClockState& Clock);
+	void RecordEvent(FName ClockName, EQuartzCommandQuantization QuantizationType, int32 NumBars, int32 Beat, float BeatFraction);
+	void RecordStep(FName ClockName, int32 Step, float AgeSeconds);
+	void RecordFrame(float DeltaTime);
+	void RecordAddPulse(const AActor* Actor, const FQuartzVisualPulseSettings& Settings, int32 BeatDuration, int32 BeatOffset, int32 Repeat, FQuartzVisualPulseHandle Handle);
+	void RecordAddGroupPulse(const TArray<TWeakObjectPtr<AActor>>& Members, const FQuartzVisualPulseSettings& Settings, int32 BeatDuration, int32 BeatOffset, FQuartzVisualPulseHandle Handle);
+	void RecordAddInstancePulse(const UObject* Component, int32 InstanceIndex, int32 CustomDataIndex, const FQuartzVisualPulseSettings& Settings, int32 BeatDuration, int32 BeatOffset, FQuartzVisualPulseHandle Handle);
+	void RecordRemovePulse(FQuartzVisualPulseHandle Handle);
+	void RecordRemoveGroupMember(FQuartzVisualPulseHandle Handle, const AActor* Actor);
+	void RecordRemoveAll();
+
+private:
+
+	// Ids are written before the record using them. 0 is none.
+	uint32 GetNameId(FName Name);
+	uint32 GetObjectId(const UObject* Object, EQuartzVisualRecordedObject Kind);
+
+	void WriteType(EQuartzVisualRecordType Type);
+	void WriteSettings(const FQuartzVisualPulseSettings& Settings, uint32 ClockNameId, uint32 CurveId);
+	void WriteHandle(FQuartzVisualPulseHandle Handle);
+
+	// Called after every record, so the file only ever holds whole records.
+	void FlushIfFull();
+	void Flush();
+
+	static constexpr int32 BufferSize = 256 * 1024;
+	static constexpr int32 FlushThreshold = 192 * 1024;
+
+	TUniquePtr<IFileHandle> FileHandle;
+	TArray<uint8> Buffer;
+	FMemoryWriter Writer;
+
+	TMap<FName, uint32> NameIds;
+	TMap<FObjectKey, uint32> ObjectIds;
+
+	// Last timing written per clock, only changes are recorded.
+	TMap<FName, TArray<uint8>> ClockRecords;
+	TArray<uint8> ClockScratch;
+};
+
+// Receives the pulses of recorded actors that don't exist in the replaying world.
+UCLASS(NotPlaceable, Transient)
+class QUARTZVISUALS_API AQuartzVisualReplayActor : public AActor, public IQuartzVisualsInterface
+{
+	GENERATED_BODY()
+};
+
+/**
+ * Feeds a capture file back through the subsystem: events, clock changes and pulse commands in their recorded order,
+ * and the pulse update for every recorded frame with its recorded delta time. Pulse handles are mapped to the ones the
+ * replay hands out. Sessions are played one after the other.
+ */
+class QUARTZVISUALS_API FQuartzVisualReplayer
+{
+public:
+
+	// Missing actors are replaced by a spawned InStandInClass, AQuartzVisualReplayActor when null. It has to implement the interface.
+	bool Open(const FString& FilePath, UWorld* InWorld, TSubclassOf<AActor> InStandInClass = nullptr);
+
+	// Replays frames until the recording has advanced Seconds further. False once the end is reached.
+	bool Replay(UQuartzVisualSubsystem& Subsystem, double Seconds);
+
+	int32 GetNumFrames() const
+	{
+		return NumFrames;
+	}
+
+	// Stand-ins in the order the recording first referred to their actors.
+	const TArray<TWeakObjectPtr<AActor>>& GetStandIns() const
+	{
+		return StandIns;
+	}
+
+	// Destroys the stand-ins spawned for missing actors.
+	void DestroyStandIns();
+
+	void AddReferencedObjects(FReferenceCollector& Collector);
+
+private:
+
+	// Applies records up to and including the next frame.
+	bool ReplayFrame(UQuartzVisualSubsystem& Subsystem);
+
+	void ReadSettings(FQuartzVisualPulseSettings& OutSettings);
+	FQuartzVisualPulseHandle ReadHandle();
+	FName ReadName();
+	UObject* ReadObject();
+	AActor* ReadActor();
+	UObject* ResolveObject(EQuartzVisualRecordedObject Kind, const FString& Path);
+	void ResetTables();
+
+	TArray<uint8> Data;
+	TUniquePtr<FArchive> Reader;
+	TWeakObjectPtr<UWorld> World;
+	UClass* StandInClass = nullptr;
+
+	TArray<FName> Names;
+	// Same ids as the recording, null where the object couldn't be found.
+	TArray<UObject*> Objects;
+	TMap<FQuartzVisualPulseHandle, FQuartzVisualPulseHandle> Handles;
+	TArray<TWeakObjectPtr<AActor>> StandIns;
+
+	// Version of the session being played.
+	int32 SessionVersion = 0;
+	double RecordedSeconds = 0.0;
+	double TargetSeconds = 0.0;
+	int32 NumFrames = 0;
+};
@@ -1,6 +1,7 @@
 ﻿// Copyright Zuko Media 2023 all rights reserved.
 
 #pragma once
+#include "UObject/ObjectKey.h"
 #include "QuartzVisualSharedTypes.generated.h"
 
 
@@ -18,6 +19,21 @@ enum class EQuartzVisualPulseState : uint8
 	Finished			UMETA(DisplayName = "Finished"),
 };
 
+/* How a pulse's value is computed, pulses of each kind are stored together and updated by their own kernel. */
+enum class EQuartzVisualValueVariant : uint8
+{
+	// UseValue is off, only the events are sent.
+	None,
+	// Beat progress as is.
+	Linear,
+	// Beat progress lerped into OutValueMinMax.
+	Remap,
+	Curve,
+	// Curve value lerped into OutValueMinMax.
+	CurveRemap,
+	Num
+};
+
 USTRUCT(BlueprintType)
 struct QUARTZVISUALS_API FQuartzVisualPulsePayload
 {
@@ -51,6 +67,10 @@ struct QUARTZVISUALS_API FQuartzVisualPulseSettings
 	UPROPERTY(EditAnywhere, BlueprintReadWrite)
 	int32 Index = 0;
 
+	/* Quartz clock this pulse follows. None uses the default clock (the first one subscribed) */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	FName ClockName = NAME_None;
+
 	/* For cases where we want to do an event without a visual */
 	UPROPERTY(EditAnywhere, BlueprintReadWrite)
 	bool UseValue = true;
@@ -74,6 +94,20 @@ struct QUARTZVISUALS_API FQuartzVisualPulseSettings
 	/* Final Multiplier for the value*/
 	float ValueMultiplier = 1.0f;
 
+	EQuartzVisualValueVariant GetValueVariant() const
+	{
+		if(UseValue == false)
+		{
+			return EQuartzVisualValueVariant::None;
+		}
+		const bool bRemap = OutValueMinMax.X != 0.0f || OutValueMinMax.Y != 1.0f;
+		if(ValueCurve)
+		{
+			return bRemap ? EQuartzVisualValueVariant::CurveRemap : EQuartzVisualValueVariant::Curve;
+		}
+		return bRemap ? EQuartzVisualValueVariant::Remap : EQuartzVisualValueVariant::Linear;
+	}
+
 	FORCEINLINE bool operator ==(const FQuartzVisualPulseSettings& Settings) const
 	{
 		return Settings.Index == Index && Settings.IndexFilter == IndexFilter;
@@ -187,4 +221,107 @@ struct QUARTZVISUALS_API FQuartzVisualPulseEntry
 		&& InSettings.Settings.IndexFilter == Settings.IndexFilter
 		&& InSettings.Data.Actor == Data.Actor;
 	}
-};
\ No newline at end of file
+};
+
+/* Identifies a single pulse. Goes stale once the pulse finishes, is replaced or is removed. */
+USTRUCT(BlueprintType)
+struct QUARTZVISUALS_API FQuartzVisualPulseHandle
+{
+	GENERATED_USTRUCT_BODY()
+
+	UPROPERTY()
+	int32 SlotIndex = INDEX_NONE;
+
+	// Bumped every time the slot is freed so old handles can be detected.
+	UPROPERTY()
+	int32 Generation = 0;
+
+	FQuartzVisualPulseHandle() = default;
+
+	FQuartzVisualPulseHandle(const int32 InSlotIndex, const int32 InGeneration)
+		: SlotIndex(InSlotIndex)
+		, Generation(InGeneration)
+	{
+	}
+
+	// Only tells if the handle was ever assigned, ask the subsystem if the pulse is still alive.
+	bool IsSet() const
+	{
+		return SlotIndex != INDEX_NONE;
+	}
+
+	FORCEINLINE bool operator ==(const FQuartzVisualPulseHandle& Other) const
+	{
+		return Other.SlotIndex == SlotIndex && Other.Generation == Generation;
+	}
+
+	friend FORCEINLINE uint32 GetTypeHash(const FQuartzVisualPulseHandle& Handle)
+	{
+		return HashCombine(GetTypeHash(Handle.SlotIndex), GetTypeHash(Handle.Generation));
+	}
+};
+
+/* Compact per-frame state of one pulse, used for batched updates (no settings or payload). */
+USTRUCT(BlueprintType)
+struct QUARTZVISUALS_API FQuartzVisualPulseUpdate
+{
+	GENERATED_USTRUCT_BODY()
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	FQuartzVisualPulseHandle Handle;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	int32 Index = 0;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	int32 IndexFilter = 0;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	EQuartzVisualPulseState State = EQuartzVisualPulseState::Updating;
+
+	/* 0 - 1 value */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	float OutValueNormalized = 0.0f;
+
+	/* Curve or adjusted value */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	float OutValue = 0.0f;
+};
+
+// Lookup key for a pulse. Matches the same rules as FQuartzVisualPulseEntry::operator== (Actor, Index, IndexFilter)
+// Pulses written straight into a component (Sink) are keyed by the component as well so they never match the owner's own pulses.
+struct FQuartzVisualPulseKey
+{
+	TObjectKey<AActor> Actor;
+	TObjectKey<UObject> Sink;
+	int32 Index = 0;
+	int32 IndexFilter = 0;
+	// Later hits of the same Index and IndexFilter in a pattern count up from 1, so they don't replace the first.
+	int32 Repeat = 0;
+
+	FQuartzVisualPulseKey() = default;
+
+	FQuartzVisualPulseKey(const AActor* InActor, const int32 InIndex, const int32 InIndexFilter, const UObject* InSink = nullptr, const int32 InRepeat = 0)
+		: Actor(InActor)
+		, Sink(InSink)
+		, Index(InIndex)
+		, IndexFilter(InIndexFilter)
+		, Repeat(InRepeat)
+	{
+	}
+
+	explicit FQuartzVisualPulseKey(const FQuartzVisualPulseEntry& Entry, const UObject* InSink = nullptr, const int32 InRepeat = 0)
+		: FQuartzVisualPulseKey(Entry.Data.Actor, Entry.Settings.Index, Entry.Settings.IndexFilter, InSink, InRepeat)
+	{
+	}
+
+	FORCEINLINE bool operator ==(const FQuartzVisualPulseKey& Other) const
+	{
+		return Other.Actor == Actor && Other.Sink == Sink && Other.Index == Index && Other.IndexFilter == IndexFilter && Other.Repeat == Repeat;
+	}
+
+	friend FORCEINLINE uint32 GetTypeHash(const FQuartzVisualPulseKey& Key)
+	{
+		return HashCombine(HashCombine(GetTypeHash(Key.Actor), GetTypeHash(Key.Sink)), HashCombine(GetTypeHash(Key.Index), HashCombine(GetTypeHash(Key.IndexFilter), GetTypeHash(Key.Repeat))));
+	}
+};
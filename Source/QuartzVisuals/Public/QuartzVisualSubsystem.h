@@ -4,19 +4,186 @@
 
 #include "CoreMinimal.h"
 #include "Subsystems/WorldSubsystem.h"
+#include "Containers/Queue.h"
 #include "Quartz/AudioMixerClockHandle.h"
 #include "QuartzVisualSharedTypes.h"
+#include "QuartzVisualPulseStore.h"
+#include "QuartzVisualBeatPhase.h"
+#include "QuartzVisualAudioBeatFeed.h"
+#include "QuartzVisualPulsePattern.h"
+#include "QuartzVisualRecorder.h"
+#include "QuartzVisualPulseTrack.h"
 #include "QuartzVisualSubsystem.generated.h"
 
-inline int32 GQuartzVisualsEnableLogs = 0;
-inline FAutoConsoleVariableRef CVarQuartzVisualsEnableLogs(
-	TEXT("QuartzVisuals.EnableLogs"),
-	GQuartzVisualsEnableLogs,
-	TEXT("Enable logs for the visuals. These can be pretty verbose"),
-	ECVF_Default);
+#if UE_BUILD_SHIPPING
+// Constant in shipping so every verbose log and the strings built for it compile away.
+constexpr int32 GQuartzVisualsEnableLogs = 0;
+#else
+extern QUARTZVISUALS_API int32 GQuartzVisualsEnableLogs;
+#endif
+
+// Console variables, defined with their descriptions in QuartzVisualSubsystem.cpp.
+extern QUARTZVISUALS_API int32 GQuartzVisualsValidateLookup;
+extern QUARTZVISUALS_API int32 GQuartzVisualsParallelUpdateThreshold;
+extern QUARTZVISUALS_API int32 GQuartzVisualsSubBeatPhase;
+extern QUARTZVISUALS_API int32 GQuartzVisualsSignificance;
+extern QUARTZVISUALS_API float GQuartzVisualsSignificanceReducedDistance;
+extern QUARTZVISUALS_API float GQuartzVisualsSignificanceEventsOnlyDistance;
+extern QUARTZVISUALS_API int32 GQuartzVisualsSignificanceReducedInterval;
+extern QUARTZVISUALS_API float GQuartzVisualsSignificanceRenderTimeout;
+extern QUARTZVISUALS_API int32 GQuartzVisualsSignificanceEvaluateInterval;
+extern QUARTZVISUALS_API int32 GQuartzVisualsFrameBudgetUs;
+extern QUARTZVISUALS_API int32 GQuartzVisualsTrackLookaheadSteps;
+extern QUARTZVISUALS_API int32 GQuartzVisualsIdleBarEvents;
+extern QUARTZVISUALS_API float GQuartzVisualsAudioFeedMaxDrift;
 
 DECLARE_LOG_CATEGORY_EXTERN(LogQuartzVisuals, Log, Log);
 
+class UInstancedStaticMeshComponent;
+class FAudioDeviceHandle;
+
+// Instanced mesh written to by instance pulses, dirtied once per frame no matter how many instances changed.
+struct FQuartzVisualInstanceSink
+{
+	TWeakObjectPtr<UInstancedStaticMeshComponent> Component;
+	// Finds the lookup entry once the component is gone, null for a released sink.
+	TObjectKey<UInstancedStaticMeshComponent> ComponentKey;
+	// Pulses writing to it, released with the last one.
+	int32 NumPulses = 0;
+	bool bDirty = false;
+};
+
+// A pulse change queued from another thread, applied on the game thread by the subsystem.
+struct FQuartzVisualPulseCommand
+{
+	enum class EType : uint8
+	{
+		Add,
+		// By actor, Index and IndexFilter.
+		Remove,
+		// Every pulse of the actor except ExcludeIndexFilters.
+		RemoveAll,
+		// By handle.
+		Cancel
+	};
+
+	EType Type = EType::Add;
+	TWeakObjectPtr<AActor> Actor;
+	FQuartzVisualPulseSettings Settings;
+	int32 BeatDuration = 0;
+	int32 BeatOffset = 0;
+	bool bStopIfExists = false;
+	int32 Index = 0;
+	int32 IndexFilter = 0;
+	TArray<int32> ExcludeIndexFilters;
+	FQuartzVisualPulseHandle Handle;
+};
+
+// Actors sharing one pulse, its value is evaluated once and sent to each of them.
+struct FQuartzVisualPulseGroup
+{
+	TArray<TWeakObjectPtr<AActor>> Members;
+	// Same order as Members, null when the update has to go through reflection.
+	TArray<IQuartzVisualsInterface*> NativeInterfaces;
+	FQuartzVisualPulseHandle Handle;
+	// Non zero while members are being sent an update. Members removed meanwhile are only nulled, the list is compacted once it's done.
+	int32 DispatchDepth = 0;
+	// The whole group is finishing, members leaving now get that finish instead of one of their own.
+	bool bFinishing = false;
+};
+
+// A pulse track playing on a set of actors, streamed into group pulses a window at a time.
+struct FQuartzVisualPulseTrackPlayback
+{
+	FQuartzVisualMappedPulseTrack Track;
+	TArray<TWeakObjectPtr<AActor>> Actors;
+	// Everything but Index, IndexFilter and the payload, which come from the track.
+	FQuartzVisualPulseSettings Settings;
+	int32 ClockIndex = 0;
+	int32 BeatOffset = 0;
+	// Clock step the track's first step falls on. INDEX_NONE until the clock runs.
+	int32 StartStep = INDEX_NONE;
+	// Next pulse of the track to add.
+	int32 Cursor = 0;
+};
+
+/* A subscribed quartz clock and the beat it is on. Pulses following the clock only advance on its events. */
+USTRUCT()
+struct FQuartzVisualClockState
+{
+	GENERATED_BODY()
+
+	// None until a clock claims the default slot.
+	UPROPERTY()
+	FName ClockName = NAME_None;
+
+	UPROPERTY()
+	UQuartzClockHandle* ClockHandle = nullptr;
+
+	UPROPERTY()
+	FOnQuartzMetronomeEventBP MetronomeEvent;
+
+	UPROPERTY()
+	int32 CurrentBeatCount = 0;
+
+	UPROPERTY()
+	int32 CurrentBeatCountFull = -1;
+
+	// Length of one pulse beat.
+	UPROPERTY()
+	EQuartzCommandQuantization Quantization = EQuartzCommandQuantization::ThirtySecondNote;
+
+	// Adaptive mode subscribes at this coarser rate and extrapolates the steps in between. None when not adaptive.
+	UPROPERTY()
+	EQuartzCommandQuantization CoarseQuantization = EQuartzCommandQuantization::None;
+
+	// What the clock is subscribed to right now, Quantization, CoarseQuantization or Bar while idle.
+	UPROPERTY()
+	EQuartzCommandQuantization EventQuantization = EQuartzCommandQuantization::ThirtySecondNote;
+
+	// Musical position of the last step processed, in steps. INDEX_NONE before the first event.
+	int32 LastStep = INDEX_NONE;
+
+	float StepsPerSecond = 0.0f;
+	float StepsPerBeat = 8.0f;
+	float BeatsPerBar = 4.0f;
+	int32 StepsPerCoarseEvent = 1;
+
+	// Delta time multiplier for interp usage based on BPM.
+	float DeltaTimeMultiplier = 1.0f;
+
+	// The timing above is asked from quartz again only when this is set or the tempo moved off TimingBeatsPerMinute.
+	bool bTimingDirty = true;
+	float TimingBeatsPerMinute = 0.0f;
+
+	bool IsExtrapolating() const
+	{
+		return EventQuantization != Quantization;
+	}
+
+	// No pulses follow the clock, it is on bar events until one is added.
+	bool bIdle = false;
+
+	// Position between events, fed by the events and advanced every frame.
+	FQuartzVisualBeatPhaseEstimator Phase;
+
+	// Tempo of the stand-in clock driving this one when there is no quartz clock. 0 when not simulated.
+	UPROPERTY()
+	float SimulatedBeatsPerMinute = 0.0f;
+
+	// Time the stand-in clock has run for and the last step it sent.
+	double SimulatedSeconds = 0.0;
+	int32 SimulatedStep = INDEX_NONE;
+
+	bool IsSimulated() const
+	{
+		return SimulatedBeatsPerMinute > 0.0f;
+	}
+
+	// Steps the clock from the rendered audio when set, see SetQuartzVisualAudioBeatFeedEnabled.
+	TSharedPtr<FQuartzVisualAudioBeatFeed, ESPMode::ThreadSafe> AudioBeatFeed;
+};
+
 /**
  * 
  */
@@ -39,6 +206,8 @@ public:
 	// Largely ignored so we can boot these up in-game
 	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
 	virtual void Deinitialize() override;
+
+	static void AddReferencedObjects(UObject* InThis, FReferenceCollector& Collector);
 	
 	UFUNCTION(BlueprintCallable)
 	void ForceTick(float DeltaTime);
@@ -52,49 +221,317 @@ public:
 	UPROPERTY(BlueprintReadWrite, EditAnywhere)
 	bool UseForcedTick = false;
 	
-	/*Subscribe to the quantization you'd like to align your visuals to. 32nd note will be most accurate*/
+	/*Subscribe to the quantization you'd like to align your visuals to. 32nd note will be most accurate. Pulse beats are one Quantization long.
+	 * Can be called for several clocks, pulses pick theirs with ClockName. The first clock subscribed is the default one.
+	 * AdaptiveQuantization (beat or bar) only subscribes at that coarser rate and extrapolates the steps in between from the BPM,
+	 * switching to Quantization events while pulses shorter than one coarse event are active.*/
 	UFUNCTION(BlueprintCallable, Category="Setup", meta=(WorldContext = "WorldContextObject"))
-	void SubscribeToQuantization(UObject* WorldContextObject, UQuartzClockHandle* QuartzClockHandle, EQuartzCommandQuantization Quantization);
+	void SubscribeToQuantization(UObject* WorldContextObject, UQuartzClockHandle* QuartzClockHandle, EQuartzCommandQuantization Quantization, EQuartzCommandQuantization AdaptiveQuantization = EQuartzCommandQuantization::None);
+
+	/*Drives the clock from a stand-in running at BeatsPerMinute instead of a quartz clock, sending the same events OnQuantizationEvent gets.
+	 * Advances with the subsystem tick so it is deterministic under ForceTick with a fixed delta time. Works without audio (-nullrhi, -nosound).
+	 * Subscribing a quartz clock with the same name replaces it.*/
+	UFUNCTION(BlueprintCallable, Category="Setup")
+	void StartSimulatedQuartzVisualClock(FName ClockName, float BeatsPerMinute = 120.0f, EQuartzCommandQuantization Quantization = EQuartzCommandQuantization::ThirtySecondNote, int32 BeatsPerBar = 4);
+
+	UFUNCTION(BlueprintCallable, Category="Setup")
+	void StopSimulatedQuartzVisualClock(FName ClockName);
+
+	/*Steps the clock from boundaries found in the rendered audio instead of the metronome delegate, which lands up to a frame late.
+	 * The boundaries are placed in the render clock. Quartz events number them and keep their phase within about one audio buffer, see FQuartzVisualAudioBeatFeed.
+	 * Adaptive clocks stay on their coarse events. Returns false if the clock or the audio device doesn't exist.*/
+	UFUNCTION(BlueprintCallable, Category="Setup")
+	bool SetQuartzVisualAudioBeatFeedEnabled(FName ClockName, bool bEnabled);
+
+	/*Appends quantization events, clock changes and pulse adds and removes to FileName until stopped. Relative names go in Saved/Profiling/QuartzVisuals.
+	 * Also QuartzVisuals.Record <FileName> from the console.*/
+	UFUNCTION(BlueprintCallable, Category="Debug")
+	bool StartQuartzVisualRecording(const FString& FileName);
+
+	UFUNCTION(BlueprintCallable, Category="Debug")
+	void StopQuartzVisualRecording();
+
+	/*Plays a recording back through this subsystem in place of the tick. Actors that can't be found get a stand-in, clocks take the recorded timing.
+	 * Full speed plays every frame before returning, real time plays along with the tick (the subsystem has to be initialized).
+	 * Meant for a world without subscribed clocks or other pulses. Also QuartzVisuals.Replay <FileName> [RealTime] from the console.*/
+	UFUNCTION(BlueprintCallable, Category="Debug")
+	bool StartQuartzVisualReplay(const FString& FileName, bool bRealTime = false);
+
+	UFUNCTION(BlueprintCallable, Category="Debug")
+	void StopQuartzVisualReplay();
+
+	// Written to while recording, see StartQuartzVisualRecording.
+	FQuartzVisualRecorder Recorder;
+
+	// Drives the update while a real time replay plays.
+	TUniquePtr<FQuartzVisualReplayer> Replayer;
+
+	// Relative names go in the profiling directory, .qvrec is added if there is no extension.
+	static FString GetQuartzVisualRecordingPath(const FString& FileName);
+
+	/*Converts a standard MIDI file into a pulse track for PlayQuartzVisualPulseTrack. Note numbers become Index, channels IndexFilter and velocities the payload
+	 * (IntData 1 - 127, FloatData 0 - 1). Notes are quantized to StepsPerBeat, use the clock's quantization (8 for 32nd notes). Relative track names go in
+	 * Content/PulseTracks, add it to DirectoriesToAlwaysStageAsNonUFS in the packaging settings so packaged builds can map it. Also QuartzVisuals.ImportMidi <MidiFile> <TrackFile> [StepsPerBeat] from the console.*/
+	UFUNCTION(BlueprintCallable, Category="Tracks")
+	static bool ImportQuartzVisualMidiTrack(const FString& MidiFile, const FString& TrackFile, int32 StepsPerBeat = 8);
+
+	/*Plays a pulse track on the actors, every note a group pulse shared by all of them. Starts BeatOffset steps after the clock's next step.
+	 * The track is memory mapped and only the pulses within QuartzVisuals.TrackLookaheadSteps of the clock are added, so length doesn't matter.
+	 * Settings supply everything the track doesn't, including the clock. Returns an id for StopQuartzVisualPulseTrack, INDEX_NONE if the track can't be opened.*/
+	UFUNCTION(BlueprintCallable, Category="Tracks")
+	int32 PlayQuartzVisualPulseTrack(const TArray<AActor*>& Actors, const FString& TrackFile, const FQuartzVisualPulseSettings& QuantizedVisualPulseSettings, int32 BeatOffset = 0);
+
+	/* Stops adding the track's pulses. Pulses already added play out. */
+	UFUNCTION(BlueprintCallable, Category="Tracks")
+	void StopQuartzVisualPulseTrack(int32 TrackId);
+
+	// Relative names go in Content/PulseTracks, .qvtrack is added if there is no extension.
+	static FString GetQuartzVisualPulseTrackPath(const FString& FileName);
+
+	// Tracks playing, by id.
+	TSparseArray<FQuartzVisualPulseTrackPlayback> PulseTracks;
+
+	// Adds the pulses of every playing track that came within the lookahead of their clock, and drops finished tracks.
+	void StreamQuartzVisualPulseTracks();
 
 	UPROPERTY(BlueprintReadOnly)
 	UWorld* OwningWorld;
 
+	// Every clock pulses follow, index 0 is the default clock. Indices are stored per pulse so clocks are never removed.
 	UPROPERTY()
-	UQuartzClockHandle* CachedQuartzClockHandle;
-	
-	UPROPERTY()
-	FOnQuartzMetronomeEventBP QuartzMetronomeEvent;
+	TArray<FQuartzVisualClockState> Clocks;
 
-	UPROPERTY()
-	int32 CurrentBeatCount = 0;
-	
-	UPROPERTY()
-	int32 CurrentBeatCountFull = -1;
+	// Returns the index of the clock, adding a placeholder for clocks that haven't been subscribed to yet.
+	int32 FindOrAddQuartzVisualClock(FName ClockName);
 
-	UPROPERTY()
-	TArray<FQuartzVisualPulseEntry> QuartzVisualEntries;
+	// Index of the clock being subscribed, the first one takes the default slot.
+	int32 ClaimQuartzVisualClock(FName ClockName);
+
+	// Re-reads tempo and time signature dependent values from quartz.
+	void UpdateQuartzVisualClockTiming(int32 ClockIndex);
+
+	// Moves the clock's subscription between its fine and coarse quantization.
+	void SetQuartzVisualClockEventQuantization(int32 ClockIndex, EQuartzCommandQuantization EventQuantization);
+
+	// Drops the clock to bar events once nothing follows it and brings it back when something does.
+	void UpdateQuartzVisualClockIdle(int32 ClockIndex);
+
+	// Advances every clock's phase and runs the steps adaptive clocks extrapolate between coarse events.
+	void ExtrapolateQuartzVisualClocks(float DeltaTime);
+
+	// Sends the events simulated clocks reached this frame.
+	void AdvanceSimulatedQuartzVisualClocks(float DeltaTime);
+
+	// Steps the clock up to EventStep. AgeSeconds is how long ago EventStep's boundary was.
+	void AdvanceQuartzVisualClockTo(int32 ClockIndex, int32 EventStep, float AgeSeconds);
+
+	// Steps clocks with an audio feed through the boundaries that are due.
+	void ConsumeQuartzVisualAudioBeats();
+
+	void ReleaseQuartzVisualAudioBeatFeed(FAudioDeviceHandle& AudioDevice, TSharedPtr<FQuartzVisualAudioBeatFeed, ESPMode::ThreadSafe>& AudioBeatFeed);
+
+	// One pulse beat on the clock: starts and finishes the pulses due on it.
+	void StepQuartzVisualClock(int32 ClockIndex, int32 Step);
+
+	// True if an active pulse on the clock is shorter than one coarse event and needs the fine events.
+	bool HasShortQuartzVisualPulses(int32 ClockIndex) const;
+
+	// All active pulses. Referenced through AddReferencedObjects.
+	FQuartzVisualPulseStore QuartzVisualEntries;
 	
 	// How much of a delay before playing this pulse
 	UPROPERTY(BlueprintReadWrite, EditAnywhere)
 	int32 BeatDelayCount = 4;
 
-	float DeltaTimeMultiplier = 1.0f;
+	// How far the audible output lags behind the quantization events. Pulse values are held back by this much (sub beat phase only).
+	UPROPERTY(BlueprintReadWrite, EditAnywhere)
+	float OutputLatencyMs = 0.0f;
+
+	// Indexed by the hot data, released sinks are handed out again by FindOrAddQuartzVisualInstanceSink.
+	TArray<FQuartzVisualInstanceSink> InstanceSinks;
+	TMap<TObjectKey<UInstancedStaticMeshComponent>, int32> InstanceSinkLookup;
+	TArray<int32> FreeInstanceSinks;
+
+	// Baked value curves shared by every pulse using the same curve.
+	FQuartzVisualCurveCache CurveCache;
+
+	// After every garbage collection, removes the pulses of destroyed instanced meshes and releases the curve tables no pulse uses anymore.
+	void OnQuartzVisualPostGarbageCollect();
+	void PruneQuartzVisualInstanceSinks();
+	void PruneQuartzVisualCurveTables();
+	FDelegateHandle PostGarbageCollectHandle;
+
+	// Scratch output of the batched value evaluation, reused every frame.
+	TArray<float> BatchOutValueNormalized;
+	TArray<float> BatchOutValue;
+	TArray<float> BatchDeltaSeconds;
+	TArray<float> BatchSubStep;
+	TArray<int32> BatchCurrentStep;
+
+	// Scratch for batched dispatch, reused every frame.
+	TArray<AActor*> BatchedActorScratch;
+	TArray<FQuartzVisualPulseUpdate> BatchedUpdateScratch;
 
 	
 	void UpdateQuartzVisualPulseEntries(float DeltaTime);
 
+	// The part of the update after the clocks have stepped: phase, significance, values and dispatch. Replays call it for every recorded frame.
+	void UpdateQuartzVisualPulseFrame(float DeltaTime);
+
+	// Computes progress and values for every entry, split over worker threads past the parallel threshold. Does not touch actors.
+	void ComputeQuartzVisualPulseValues(float DeltaTime);
+
+	// Sends the computed values to the actors on the game thread.
+	void DispatchQuartzVisualPulseUpdates();
+
+	// One OnQuartzVisualUpdateBatch per actor that asked for batched updates.
+	void DispatchBatchedQuartzVisualUpdates();
+
+	// Re-rates every listening actor by distance to the local views and recent rendering, every few frames.
+	void UpdateQuartzVisualSignificance();
+
+	EQuartzVisualSignificance EvaluateQuartzVisualSignificance(const AActor* Actor, const TArray<FVector, TInlineAllocator<4>>& ViewLocations) const;
+
+	// False on the frames a reduced actor is skipped, values keep being computed so it is current again once it gets an update.
+	bool IsQuartzVisualUpdateDue(EQuartzVisualSignificance Significance, const AActor* Actor) const
+	{
+		switch(Significance)
+		{
+		case EQuartzVisualSignificance::Reduced:
+			return (GetTypeHash(Actor) + SignificanceFrame) % static_cast<uint32>(FMath::Max(GQuartzVisualsSignificanceReducedInterval, 1)) == 0;
+		case EQuartzVisualSignificance::EventsOnly:
+			return false;
+		default:
+			return true;
+		}
+	}
+
+	uint32 SignificanceFrame = 0;
+	bool bSignificanceApplied = false;
+
+	// Mid-pulse updates that didn't fit in the frame budget last frame.
+	UPROPERTY(BlueprintReadOnly)
+	int32 DeferredUpdateCount = 0;
+
+	// Frames that went over the budget, either on work that can't be deferred or on the last update checked.
+	UPROPERTY(BlueprintReadOnly)
+	int32 BudgetOverrunCount = 0;
+
+	// Start of this frame's update, the budget covers steps and compute as well so they take priority.
+	uint64 UpdateStartCycles = 0;
+
+	// Dense index the budgeted dispatch continues from.
+	int32 DispatchCursor = 0;
+
+	// Handles in the order dispatch visits them, taken before the first update goes out. Reused every frame.
+	TArray<FQuartzVisualPulseHandle> DispatchHandleScratch;
+
+	// Batched updates were cut off last frame and go first this frame.
+	bool bBatchedUpdatesDeferred = false;
+
+	bool IsOverQuartzVisualFrameBudget() const
+	{
+		return GQuartzVisualsFrameBudgetUs > 0 && FPlatformTime::ToSeconds64(FPlatformTime::Cycles64() - UpdateStartCycles) * 1000000.0 > static_cast<double>(GQuartzVisualsFrameBudgetUs);
+	}
+
+	// Entries per parallel compute task. Multiple of the kernel lane count.
+	static constexpr int32 QuartzVisualComputeChunkSize = 1024;
+
+	/* Returns a handle to the new pulse, or to the existing one when StopIfExists finds a match. Unset if the actor can't receive pulses. */
+	UFUNCTION(BlueprintCallable)
+	FQuartzVisualPulseHandle AddNewQuartzVisualPulse(AActor* InActor, const FQuartzVisualPulseSettings& QuantizedVisualPulseSettings, int32 BeatDuration, int32 BeatOffset, bool StopIfExists = false);
+
+	/* One pulse shared by every actor, evaluated once per frame and sent to each. Actors get the same events as with their own pulse,
+	 * but never batched. Index and IndexFilter only reach the actors, group pulses never replace each other or single actor pulses. */
+	UFUNCTION(BlueprintCallable)
+	FQuartzVisualPulseHandle AddNewQuartzVisualGroupPulse(const TArray<AActor*>& Actors, const FQuartzVisualPulseSettings& QuantizedVisualPulseSettings, int32 BeatDuration, int32 BeatOffset);
+
+	/* Finishes the group pulse for one actor, the rest keep going. The pulse is removed with its last actor. */
+	UFUNCTION(BlueprintCallable)
+	bool RemoveQuartzVisualGroupMember(FQuartzVisualPulseHandle Handle, AActor* Actor);
+
+	/* Schedules every pulse of the pattern on every actor, BeatOffset is added to each pulse's own offset. Returns how many pulses were added. */
 	UFUNCTION(BlueprintCallable)
-	void AddNewQuartzVisualPulse(AActor* InActor, FQuartzVisualPulseSettings QuantizedVisualPulseSettings, int32 BeatDuration, int32 BeatOffset, bool StopIfExists = false);
+	int32 AddQuartzVisualPulsePattern(const TArray<AActor*>& Actors, UQuartzVisualPulsePattern* Pattern, int32 BeatOffset = 0, bool StopIfExists = false);
+
+	/* Same as AddQuartzVisualPulsePattern for pulses that aren't in an asset. Storage is reserved once and each actor is checked once.
+	 * Pulses sharing an Index and IndexFilter are all played, each later one as a repeat of the first. */
+	UFUNCTION(BlueprintCallable)
+	int32 AddNewQuartzVisualPulses(const TArray<AActor*>& Actors, const TArray<FQuartzVisualPatternPulse>& Pulses, int32 BeatOffset = 0, bool StopIfExists = false);
+
+	/* Pulses a custom data float of a single instance, no actor or interface needed. Index and IndexFilter of the settings are replaced by InstanceIndex and CustomDataIndex. */
+	UFUNCTION(BlueprintCallable)
+	FQuartzVisualPulseHandle AddNewQuartzVisualInstancePulse(UInstancedStaticMeshComponent* Component, int32 InstanceIndex, int32 CustomDataIndex, FQuartzVisualPulseSettings QuantizedVisualPulseSettings, int32 BeatDuration, int32 BeatOffset, bool StopIfExists = false);
+
+	UFUNCTION(BlueprintCallable)
+	void RemoveQuartzVisualInstancePulse(UInstancedStaticMeshComponent* Component, int32 InstanceIndex, int32 CustomDataIndex);
+
+	/* Finishes and removes the pulse. Returns false if the handle is stale. */
+	UFUNCTION(BlueprintCallable)
+	bool RemoveQuartzVisualPulse(FQuartzVisualPulseHandle Handle);
+
+	/* True while the pulse the handle points to has not finished or been removed. */
+	UFUNCTION(BlueprintPure)
+	bool IsQuartzVisualPulseActive(FQuartzVisualPulseHandle Handle) const;
 
 	void RemoveQuartzVisualPulseFromActor(int32 Index, int32 IndexFilter, AActor* InActor);
 
 	void RemoveAllQuartzVisualPulsesFromActor(AActor* Device, TArray<int32> ExcludeIndexFilters = TArray<int32>());
 
 	void RemoveAllQuartzVisualPulses();
+
+	/* Thread safe versions of the add and remove calls. Commands are applied in order on the game thread at the start of the next tick or quantization event.
+	 * The value curve in the settings is not referenced while queued, it has to be kept alive by the caller (assets always are). */
+	void EnqueueQuartzVisualPulse(AActor* InActor, const FQuartzVisualPulseSettings& QuantizedVisualPulseSettings, int32 BeatDuration, int32 BeatOffset, bool StopIfExists = false);
+	void EnqueueRemoveQuartzVisualPulseFromActor(int32 Index, int32 IndexFilter, AActor* InActor);
+	void EnqueueRemoveAllQuartzVisualPulsesFromActor(AActor* InActor, TArray<int32> ExcludeIndexFilters = TArray<int32>());
+	void EnqueueCancelQuartzVisualPulse(FQuartzVisualPulseHandle Handle);
+
+	// Applies every queued command. Game thread only.
+	void ProcessQuartzVisualCommands();
+
+	// Filled from any thread, drained on the game thread.
+	TQueue<FQuartzVisualPulseCommand, EQueueMode::Mpsc> CommandQueue;
 	
-	void CancelAndFinishQuartzVisualEntry(FQuartzVisualPulseEntry& QuartzVisualPulseEntry);
-	
-	
+	// NativeInterface skips reflection when the actor's listener allows it.
+	void CancelAndFinishQuartzVisualEntry(FQuartzVisualPulseEntry& QuartzVisualPulseEntry, IQuartzVisualsInterface* NativeInterface = nullptr);
+
+	// False (with a warning) if the actor doesn't implement the interface.
+	bool CanReceiveQuartzVisualPulses(AActor* InActor) const;
+
+	// AddNewQuartzVisualPulse without the interface check. Repeat numbers later hits of the same Index and IndexFilter in a pattern.
+	FQuartzVisualPulseHandle AddCheckedQuartzVisualPulse(AActor* InActor, const FQuartzVisualPulseSettings& QuantizedVisualPulseSettings, int32 BeatDuration, int32 BeatOffset, bool StopIfExists, int32 Repeat = 0);
+
+	// Caches the interface checks and update preferences for an actor about to get its first pulse.
+	void InitializeQuartzVisualListener(AActor* InActor);
+
+	// Finishes the entry through its event, or its instance sink. Does not remove it.
+	void FinishQuartzVisualEntryAt(int32 DenseIndex);
+
+	// Removes the entry from the store, releasing its instance sink with the last pulse. False if the handle is stale.
+	bool RemoveQuartzVisualEntry(const FQuartzVisualPulseHandle& Handle);
+
+	// Adds to the store and fills in the hot data the store can't know about. Duplicates must be removed first.
+	FQuartzVisualPulseHandle AddQuartzVisualEntry(const FQuartzVisualPulseEntry& NewEntry, UInstancedStaticMeshComponent* InstanceComponent, int32 GroupIndex = INDEX_NONE, int32 Repeat = 0);
+
+	// Group pulses by index, freed when the pulse finishes.
+	TSparseArray<FQuartzVisualPulseGroup> PulseGroups;
+
+	// Sends the group pulse's current value to every member, dropping destroyed ones. Members may leave from inside their update.
+	void SendQuartzVisualGroupUpdate(int32 DenseIndex, int32 GroupIndex);
+
+	// Returns the component's sink and counts one more pulse on it.
+	int32 FindOrAddQuartzVisualInstanceSink(UInstancedStaticMeshComponent* Component);
+
+	// Counts one pulse less, on the last the component's final values are flushed and the sink is freed.
+	void ReleaseQuartzVisualInstanceSink(int32 SinkIndex);
+
+	// Writes OutValue into the entry's instance custom data without touching the render state.
+	void WriteQuartzVisualInstanceValue(int32 DenseIndex);
+
+	// Marks every component written to since the last flush render state dirty, once each.
+	void FlushQuartzVisualInstanceSinks();
+
 	// Quantization event.
 	UFUNCTION()
 	void OnQuantizationEvent(FName ClockName, EQuartzCommandQuantization QuantizationType, int32 NumBars, int32 Beat, float BeatFraction);
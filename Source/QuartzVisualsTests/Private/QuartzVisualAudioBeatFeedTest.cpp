@@ -0,0 +1,155 @@
+// Copyright Zuko Media 2023 all rights reserved.
+
+#include "CoreMinimal.h"
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+#include "QuartzVisualAudioBeatFeed.h"
+
+namespace QuartzVisualAudioBeatFeedTest
+{
+	static constexpr int32 SampleRate = 48000;
+	static constexpr int32 NumChannels = 2;
+	static constexpr int32 NumFrames = 480;
+	static constexpr double BufferSeconds = static_cast<double>(NumFrames) / static_cast<double>(SampleRate);
+	// The clocks are built from whole buffers, this only covers rounding.
+	static constexpr double Tolerance = 1.0e-6;
+
+	/**
+	 * Plays the render thread with a synthetic AudioClock, one buffer per call, and keeps which buffer each step came out of.
+	 * The test thread plays both sides, commands sent before a buffer are applied at its start like they would be on a device.
+	 */
+	struct FFeedDriver
+	{
+		FQuartzVisualAudioBeatFeed Feed;
+		int32 NumBuffers = 0;
+		// Start of the buffer each step was found in, by step.
+		TMap<int32, double> StepBufferStarts;
+		TArray<FQuartzVisualAudioBeat> Received;
+
+		double GetClock() const
+		{
+			return static_cast<double>(NumBuffers) * BufferSeconds;
+		}
+
+		void Render(int32 Num)
+		{
+			for(int32 Index = 0; Index < Num; Index++)
+			{
+				const double BufferStart = GetClock();
+				Feed.OnNewSubmixBuffer(nullptr, nullptr, NumFrames * NumChannels, NumChannels, SampleRate, BufferStart);
+				NumBuffers++;
+				FQuartzVisualAudioBeat Beat;
+				while(Feed.DequeueDue(TNumericLimits<double>::Max(), Beat))
+				{
+					Received.Add(Beat);
+					StepBufferStarts.Add(Beat.Step, BufferStart);
+				}
+			}
+		}
+
+		// Renders without taking any boundaries off the queue.
+		void RenderWithoutDequeue(int32 Num)
+		{
+			for(int32 Index = 0; Index < Num; Index++)
+			{
+				Feed.OnNewSubmixBuffer(nullptr, nullptr, NumFrames * NumChannels, NumChannels, SampleRate, GetClock());
+				NumBuffers++;
+			}
+		}
+	};
+
+	// Each step one more than the last, nothing skipped or sent twice.
+	void TestContinuous(FAutomationTestBase& Test, const FFeedDriver& Driver)
+	{
+		for(int32 Index = 1; Index < Driver.Received.Num(); Index++)
+		{
+			if(Driver.Received[Index].Step != Driver.Received[Index - 1].Step + 1)
+			{
+				Test.AddError(FString::Printf(TEXT("Step %d followed by %d"), Driver.Received[Index - 1].Step, Driver.Received[Index].Step));
+			}
+		}
+	}
+
+	// Every step in [FirstStep, LastStep] came out once, of the buffer its boundary at StepClock(Step) falls in.
+	template<typename StepClockType>
+	void TestSteps(FAutomationTestBase& Test, const FFeedDriver& Driver, const TCHAR* What, int32 FirstStep, int32 LastStep, StepClockType&& StepClock)
+	{
+		for(int32 Step = FirstStep; Step <= LastStep; Step++)
+		{
+			const double* BufferStart = Driver.StepBufferStarts.Find(Step);
+			if(BufferStart == nullptr)
+			{
+				Test.AddError(FString::Printf(TEXT("%s: step %d never arrived"), What, Step));
+				continue;
+			}
+			const double Clock = StepClock(Step);
+			if(Clock < *BufferStart - Tolerance || Clock > *BufferStart + BufferSeconds + Tolerance)
+			{
+				Test.AddError(FString::Printf(TEXT("%s: step %d at %.5f came out of the buffer at %.5f"), What, Step, Clock, *BufferStart));
+			}
+		}
+	}
+}
+
+/**
+ * The grid is placed at the start of the buffer after an anchor, keeps its position over a tempo change, moves when an
+ * event shows it late without counting a correction twice before it was rendered, and boundaries of an earlier anchor
+ * never reach the game thread.
+ */
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FQuartzVisualAudioBeatFeedTest, "QuartzVisuals.AudioBeatFeed.Grid", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+
+bool FQuartzVisualAudioBeatFeedTest::RunTest(const FString& Parameters)
+{
+	using namespace QuartzVisualAudioBeatFeedTest;
+	FFeedDriver Driver;
+	FQuartzVisualAudioBeatFeed& Feed = Driver.Feed;
+
+	// Nothing before an anchor.
+	Feed.SetStepsPerSecond(16.0f);
+	Driver.Render(10);
+	TestEqual(TEXT("No boundaries before the anchor"), Driver.Received.Num(), 0);
+
+	// Step 10 is placed at the start of the next buffer, 0.1, and isn't sent again.
+	Feed.Anchor(10);
+	Driver.Render(100);
+	const double AnchorClock = 10 * BufferSeconds;
+	TestFalse(TEXT("Anchor step not sent"), Driver.StepBufferStarts.Contains(10));
+	TestSteps(*this, Driver, TEXT("Anchor"), 11, 25, [AnchorClock](int32 Step) { return AnchorClock + (Step - 10) / 16.0; });
+
+	// Doubling the tempo at 1.1 keeps the grid at step 26 there, the steps after it come twice as fast.
+	const int32 LastStepBeforeChange = Driver.Received.Last().Step;
+	const double ChangeClock = Driver.GetClock();
+	const double PositionAtChange = 10.0 + (ChangeClock - AnchorClock) * 16.0;
+	Feed.SetStepsPerSecond(32.0f);
+	Driver.Render(100);
+	TestSteps(*this, Driver, TEXT("Tempo change"), LastStepBeforeChange + 1, LastStepBeforeChange + 30, [ChangeClock, PositionAtChange](int32 Step) { return ChangeClock + (Step - PositionAtChange) / 32.0; });
+
+	// Quartz has rendered two steps past the grid, the grid is moved at once and the two are sent late in the next buffer.
+	const double CorrectClock = Driver.GetClock();
+	const double PositionAtCorrect = PositionAtChange + (CorrectClock - ChangeClock) * 32.0;
+	const int32 QuartzStep = FMath::RoundToInt(PositionAtCorrect) + 2;
+	Feed.Correct(QuartzStep, 0.25f);
+	// The grid hasn't rendered the first correction yet, this one is ignored rather than moving it by two more.
+	Feed.Correct(QuartzStep, 0.25f);
+	Driver.Render(1);
+	TestTrue(TEXT("Steps moved past sent late"), Driver.StepBufferStarts.Contains(QuartzStep) && Driver.StepBufferStarts[QuartzStep] == CorrectClock);
+	Driver.Render(100);
+	TestSteps(*this, Driver, TEXT("Correction"), QuartzStep + 1, QuartzStep + 30, [CorrectClock, QuartzStep](int32 Step) { return CorrectClock + (Step - QuartzStep) / 32.0; });
+	TestContinuous(*this, Driver);
+
+	// Boundaries already queued for the old anchor are dropped, the new one counts from its own step.
+	Driver.RenderWithoutDequeue(20);
+	Feed.Anchor(1000);
+	const int32 NumBeforeAnchor = Driver.Received.Num();
+	Driver.Render(20);
+	if(TestTrue(TEXT("Boundaries after the new anchor"), Driver.Received.Num() > NumBeforeAnchor))
+	{
+		TestEqual(TEXT("Stale boundaries dropped"), Driver.Received[NumBeforeAnchor].Step, 1001);
+	}
+	TestEqual(TEXT("Nothing lost from the queue"), Feed.GetNumDropped(), 0);
+	return true;
+}
+
+#endif
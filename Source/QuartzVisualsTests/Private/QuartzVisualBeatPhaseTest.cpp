@@ -0,0 +1,105 @@
+// Copyright Zuko Media 2023 all rights reserved.
+
+#include "CoreMinimal.h"
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+#include "QuartzVisualBeatPhase.h"
+
+namespace QuartzVisualBeatPhaseTest
+{
+	// Thirty second notes at 120 BPM.
+	static constexpr double StepsPerSecond = 16.0;
+	static constexpr double FrameSeconds = 1.0 / 60.0;
+	static constexpr int32 NumFrames = 3600;
+	// The first events lock the estimate, errors are measured after.
+	static constexpr int32 NumSettleFrames = 120;
+
+	struct FPhaseError
+	{
+		double Max = 0.0;
+		double Mean = 0.0;
+		int32 NumBackwards = 0;
+	};
+
+	/**
+	 * A clock stepping exactly on time whose events reach the game thread up to EventJitterSeconds late, on frames
+	 * which are up to 20% longer or shorter than 60 Hz. Events are handled at the start of a frame and the estimate
+	 * advanced by it, the way the subsystem ticks. With bTimestamped the events carry their age, measured to within
+	 * a millisecond. Returns the distance to the true clock position at the end of each frame, in steps.
+	 */
+	FPhaseError Simulate(const int32 Seed, const float EventJitterSeconds, const bool bTimestamped)
+	{
+		FRandomStream Random(Seed);
+		FQuartzVisualBeatPhaseEstimator Phase;
+		FPhaseError Error;
+		double Time = 0.0;
+		int32 NextStep = 0;
+		double NextDelivery = Random.FRandRange(0.0f, EventJitterSeconds);
+		double PreviousPosition = 0.0;
+		for(int32 Frame = 0; Frame < NumFrames; Frame++)
+		{
+			while(NextDelivery <= Time)
+			{
+				const double StepTime = NextStep / StepsPerSecond;
+				const float AgeSeconds = bTimestamped ? static_cast<float>(Time - StepTime + Random.FRandRange(-0.001f, 0.001f)) : 0.0f;
+				Phase.OnStep(NextStep, static_cast<float>(StepsPerSecond), AgeSeconds);
+				NextStep++;
+				NextDelivery = NextStep / StepsPerSecond + Random.FRandRange(0.0f, EventJitterSeconds);
+			}
+
+			const double DeltaSeconds = FrameSeconds * Random.FRandRange(0.8f, 1.2f);
+			Phase.Advance(static_cast<float>(DeltaSeconds));
+			Time += DeltaSeconds;
+
+			const double Position = Phase.GetPosition();
+			if(Frame >= NumSettleFrames)
+			{
+				const double FrameError = FMath::Abs(Position - Time * StepsPerSecond);
+				Error.Max = FMath::Max(Error.Max, FrameError);
+				Error.Mean += FrameError / (NumFrames - NumSettleFrames);
+				Error.NumBackwards += Position < PreviousPosition ? 1 : 0;
+			}
+			PreviousPosition = Position;
+		}
+		return Error;
+	}
+}
+
+/**
+ * The estimate against a jittery simulated clock over a minute, for several seeds. Without timestamps it can only lag
+ * by how late events arrive, up to a frame and the jitter. With them it stays within the timestamp noise. Neither may
+ * ever run backwards.
+ */
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FQuartzVisualBeatPhaseJitterTest, "QuartzVisuals.BeatPhase.JitterBounds", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+
+bool FQuartzVisualBeatPhaseJitterTest::RunTest(const FString& Parameters)
+{
+	using namespace QuartzVisualBeatPhaseTest;
+	for(int32 Seed = 1; Seed <= 8; Seed++)
+	{
+		// Up to 8 ms late on 20 ms frames is about 0.45 steps at the most.
+		const FPhaseError Untimed = Simulate(Seed, 0.008f, false);
+		TestTrue(FString::Printf(TEXT("Seed %d: max error %.3f steps under 0.6"), Seed, Untimed.Max), Untimed.Max < 0.6);
+		TestTrue(FString::Printf(TEXT("Seed %d: mean error %.3f steps under 0.25"), Seed, Untimed.Mean), Untimed.Mean < 0.25);
+		TestEqual(FString::Printf(TEXT("Seed %d: never backwards"), Seed), Untimed.NumBackwards, 0);
+
+		// A millisecond of timestamp noise is 0.016 steps.
+		const FPhaseError Timestamped = Simulate(Seed, 0.008f, true);
+		TestTrue(FString::Printf(TEXT("Seed %d: timestamped max error %.3f steps under 0.05"), Seed, Timestamped.Max), Timestamped.Max < 0.05);
+		TestTrue(FString::Printf(TEXT("Seed %d: timestamped mean error %.3f steps under 0.02"), Seed, Timestamped.Mean), Timestamped.Mean < 0.02);
+		TestEqual(FString::Printf(TEXT("Seed %d: timestamped never backwards"), Seed), Timestamped.NumBackwards, 0);
+	}
+
+	// The phase handed to the kernels is clamped, an estimate held at the limit can't push progress further.
+	FQuartzVisualBeatPhaseEstimator Phase;
+	TestEqual(TEXT("No phase before the first event"), Phase.GetStepPhase(0), 0.0f);
+	Phase.OnStep(10, static_cast<float>(StepsPerSecond));
+	Phase.Advance(10.0f);
+	TestEqual(TEXT("Held at the slack past the next step"), Phase.GetPosition(), static_cast<double>(11 + FQuartzVisualBeatPhaseEstimator::LateStepSlack));
+	TestEqual(TEXT("Phase clamped"), Phase.GetStepPhase(10), 1.0f + FQuartzVisualBeatPhaseEstimator::LateStepSlack);
+	return true;
+}
+
+#endif
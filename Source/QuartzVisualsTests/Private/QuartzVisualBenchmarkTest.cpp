@@ -0,0 +1,639 @@
+// Copyright Zuko Media 2023 all rights reserved.
+
+#include "CoreMinimal.h"
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+#include "QuartzVisualSubsystem.h"
+#include "QuartzVisualTestListener.h"
+#include "QuartzVisualTestUtils.h"
+#include "HAL/FileManager.h"
+#include "Misc/Paths.h"
+
+namespace QuartzVisualBenchmarkTest
+{
+	static constexpr float FrameSeconds = 1.0f / 60.0f;
+	static constexpr int32 NumFrames = 600;
+	static const FName ClockName(TEXT("QuartzVisualsBenchmark"));
+	static constexpr int32 NumLayoutEntries = 10000;
+	static constexpr int32 NumLayoutSteps = 128;
+	static constexpr int32 NumDispatchActors = 256;
+	static constexpr int32 NumDispatchRuns = 200;
+	static constexpr int32 NumCaptureListeners = 1000;
+	static const TCHAR* GeneratedCapture = TEXT("Generated");
+
+	// Every pulse on every listener is sent each dispatch, nothing waits to start.
+	void StartEveryPulse(UQuartzVisualSubsystem* Subsystem)
+	{
+		for(EQuartzVisualPulseState& State : Subsystem->QuartzVisualEntries.Hot.State)
+		{
+			State = EQuartzVisualPulseState::Updating;
+		}
+	}
+
+	// Sends through the interface's UFunctions, the way blueprint listeners are called.
+	void ForceReflectedDispatch(UQuartzVisualSubsystem* Subsystem, const TArray<AQuartzVisualTestListener*>& Listeners)
+	{
+		FQuartzVisualPulseStore& Store = Subsystem->QuartzVisualEntries;
+		for(IQuartzVisualsInterface*& NativeInterface : Store.Hot.NativeInterface)
+		{
+			NativeInterface = nullptr;
+		}
+		for(AQuartzVisualTestListener* Listener : Listeners)
+		{
+			FQuartzVisualListener& StoreListener = Store.FindOrAddListener(Listener);
+			StoreListener.NativeInterface = nullptr;
+			StoreListener.NativeBatchInterface = nullptr;
+		}
+	}
+
+	// Records NumFrames of add and remove churn on a simulated clock, for when no capture of a real session is at hand.
+	bool RecordChurnCapture(const FString& FilePath)
+	{
+		QuartzVisualTests::FTestWorld TestWorld;
+		UQuartzVisualSubsystem* Subsystem = TestWorld.Subsystem;
+		const TArray<AQuartzVisualTestListener*> Listeners = TestWorld.SpawnListeners(NumCaptureListeners);
+		Subsystem->StartSimulatedQuartzVisualClock(ClockName, 120.0f, EQuartzCommandQuantization::ThirtySecondNote);
+		// Recordings append sessions to an existing file.
+		IFileManager::Get().Delete(*FilePath);
+		if(Subsystem->StartQuartzVisualRecording(FilePath) == false)
+		{
+			return false;
+		}
+
+		// Curves are left out, a transient curve has no path the replay could load it from.
+		FRandomStream Random(NumCaptureListeners);
+		auto MakeRandomSettings = [&Random]()
+		{
+			FQuartzVisualPulseSettings Settings = QuartzVisualTests::MakeSettings(Random.RandRange(0, 3), Random.RandRange(0, 1), Random.RandBool() ? EQuartzVisualValueVariant::Remap : EQuartzVisualValueVariant::Linear);
+			Settings.ClockName = ClockName;
+			return Settings;
+		};
+		for(AQuartzVisualTestListener* Listener : Listeners)
+		{
+			Subsystem->AddNewQuartzVisualPulse(Listener, MakeRandomSettings(), Random.RandRange(1, 16), Random.RandRange(0, 4));
+		}
+		for(int32 Frame = 0; Frame < NumFrames; Frame++)
+		{
+			for(int32 Churn = 0; Churn < NumCaptureListeners / 16; Churn++)
+			{
+				AQuartzVisualTestListener* Listener = Listeners[Random.RandHelper(NumCaptureListeners)];
+				if(Random.RandHelper(4) < 3)
+				{
+					Subsystem->AddNewQuartzVisualPulse(Listener, MakeRandomSettings(), Random.RandRange(1, 16), Random.RandRange(0, 4));
+				}
+				else
+				{
+					Subsystem->RemoveQuartzVisualPulseFromActor(Random.RandRange(0, 3), Random.RandRange(0, 1), Listener);
+				}
+			}
+			Subsystem->ForceTick(FrameSeconds);
+		}
+		Subsystem->StopQuartzVisualRecording();
+		return true;
+	}
+}
+
+/**
+ * Add, replace and remove churn on N listeners, driven by a simulated 120 BPM clock on thirty second notes with a fixed
+ * frame time, so every run sends the same events. Writes one row per frame to Saved/Profiling/QuartzVisuals/Benchmarks
+ * with the churn and tick cost, the steps the frame ran and the game thread's allocations.
+ */
+IMPLEMENT_COMPLEX_AUTOMATION_TEST(FQuartzVisualChurnBenchmark, "QuartzVisuals.Benchmark.Churn", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::PerfFilter)
+
+void FQuartzVisualChurnBenchmark::GetTests(TArray<FString>& OutBeautifiedNames, TArray<FString>& OutTestCommands) const
+{
+	for(const TCHAR* NumListeners : { TEXT("100"), TEXT("1000"), TEXT("5000") })
+	{
+		OutBeautifiedNames.Add(FString::Printf(TEXT("%s Listeners"), NumListeners));
+		OutTestCommands.Add(NumListeners);
+	}
+}
+
+bool FQuartzVisualChurnBenchmark::RunTest(const FString& Parameters)
+{
+	using namespace QuartzVisualBenchmarkTest;
+	const int32 NumListeners = FCString::Atoi(*Parameters);
+	QuartzVisualTests::FTestWorld TestWorld;
+	UQuartzVisualSubsystem* Subsystem = TestWorld.Subsystem;
+	const TArray<AQuartzVisualTestListener*> Listeners = TestWorld.SpawnListeners(NumListeners);
+	UCurveFloat* Curve = QuartzVisualTests::MakeCurve();
+	Subsystem->StartSimulatedQuartzVisualClock(ClockName, 120.0f, EQuartzCommandQuantization::ThirtySecondNote);
+	const int32 ClockIndex = Subsystem->FindOrAddQuartzVisualClock(ClockName);
+
+	// Same seed every run, the rows of two builds line up.
+	FRandomStream Random(NumListeners);
+	const int32 ChurnPerFrame = FMath::Max(NumListeners / 16, 1);
+	auto MakeRandomSettings = [&Random, Curve]()
+	{
+		const EQuartzVisualValueVariant Variant = static_cast<EQuartzVisualValueVariant>(Random.RandRange(0, static_cast<int32>(EQuartzVisualValueVariant::Num) - 1));
+		FQuartzVisualPulseSettings Settings = QuartzVisualTests::MakeSettings(Random.RandRange(0, 3), Random.RandRange(0, 1), Variant, Curve);
+		Settings.ClockName = ClockName;
+		return Settings;
+	};
+
+	// Every listener starts with a pulse so the first frames aren't empty.
+	for(AQuartzVisualTestListener* Listener : Listeners)
+	{
+		Subsystem->AddNewQuartzVisualPulse(Listener, MakeRandomSettings(), Random.RandRange(1, 16), Random.RandRange(0, 4));
+	}
+
+	TArray<FString> Rows;
+	Rows.Reserve(NumFrames);
+	double TotalChurnUs = 0.0;
+	double TotalTickUs = 0.0;
+	double StepFrameTickUs = 0.0;
+	int32 NumStepFrames = 0;
+	int32 TotalSteps = 0;
+	int64 TotalAllocations = 0;
+	for(int32 Frame = 0; Frame < NumFrames; Frame++)
+	{
+		const int32 StepBefore = Subsystem->Clocks[ClockIndex].LastStep;
+		QuartzVisualTests::FScopedAllocationCounter Allocations;
+
+		const uint64 ChurnStart = FPlatformTime::Cycles64();
+		for(int32 Churn = 0; Churn < ChurnPerFrame; Churn++)
+		{
+			AQuartzVisualTestListener* Listener = Listeners[Random.RandHelper(NumListeners)];
+			const int32 Action = Random.RandHelper(8);
+			if(Action < 3)
+			{
+				Subsystem->AddNewQuartzVisualPulse(Listener, MakeRandomSettings(), Random.RandRange(1, 16), Random.RandRange(0, 4));
+			}
+			else if(Action < 5)
+			{
+				// Same key as a pulse the listener may already have, which replaces it.
+				FQuartzVisualPulseSettings Settings = MakeRandomSettings();
+				Settings.Index = 0;
+				Subsystem->AddNewQuartzVisualPulse(Listener, Settings, Random.RandRange(1, 16), 0);
+			}
+			else if(Action < 7)
+			{
+				Subsystem->RemoveQuartzVisualPulseFromActor(Random.RandRange(0, 3), Random.RandRange(0, 1), Listener);
+			}
+			else
+			{
+				Subsystem->RemoveAllQuartzVisualPulsesFromActor(Listener);
+			}
+		}
+		const double ChurnUs = QuartzVisualTests::MicrosecondsSince(ChurnStart);
+
+		const uint64 TickStart = FPlatformTime::Cycles64();
+		Subsystem->ForceTick(FrameSeconds);
+		const double TickUs = QuartzVisualTests::MicrosecondsSince(TickStart);
+
+		const int64 FrameAllocations = Allocations.GetNum();
+		// The clock starts on step 0 from INDEX_NONE.
+		const int32 Steps = Subsystem->Clocks[ClockIndex].LastStep - StepBefore;
+		TotalChurnUs += ChurnUs;
+		TotalTickUs += TickUs;
+		TotalSteps += Steps;
+		TotalAllocations += FrameAllocations;
+		if(Steps > 0)
+		{
+			StepFrameTickUs += TickUs;
+			NumStepFrames++;
+		}
+		Rows.Add(FString::Printf(TEXT("%d,%d,%d,%.2f,%.2f,%lld"), Frame, Subsystem->QuartzVisualEntries.Num(), Steps, ChurnUs, TickUs, FrameAllocations));
+	}
+
+	const FString CsvPath = QuartzVisualTests::WriteCsv(FString::Printf(TEXT("Churn_%d"), NumListeners), TEXT("Frame,Pulses,Steps,ChurnUs,TickUs,Allocations"), Rows);
+	TestFalse(TEXT("CSV written"), CsvPath.IsEmpty());
+	TestTrue(TEXT("Store valid after churn"), Subsystem->QuartzVisualEntries.Validate());
+	TestTrue(TEXT("Clock stepped"), TotalSteps > 0);
+
+	// Frames without a step only compute and dispatch, the difference to frames with one is the cost of the step.
+	const double FrameTickUs = TotalTickUs / NumFrames;
+	const double NoStepFrameTickUs = NumFrames > NumStepFrames ? (TotalTickUs - StepFrameTickUs) / (NumFrames - NumStepFrames) : 0.0;
+	const double BeatUs = NumStepFrames > 0 ? (StepFrameTickUs / NumStepFrames - NoStepFrameTickUs) : 0.0;
+	AddInfo(FString::Printf(TEXT("%d listeners: %.1f us churn and %.1f us tick per frame, %.1f us per step, %.1f allocations per frame. %s"),
+		NumListeners, TotalChurnUs / NumFrames, FrameTickUs, BeatUs, static_cast<double>(TotalAllocations) / NumFrames, *CsvPath));
+
+	Subsystem->RemoveAllQuartzVisualPulses();
+	TestEqual(TEXT("Every pulse removed"), Subsystem->QuartzVisualEntries.Num(), 0);
+	TestEqual(TEXT("No listeners left"), Subsystem->QuartzVisualEntries.GetListeners().Num(), 0);
+	return true;
+}
+
+/**
+ * Per-frame value compute and per-step scheduling at 10k pulses, the old array of whole entries against the store.
+ * The old side runs FQuartzVisualPulseEntry::UpdateValue on every entry and counts the beats of every entry on each step,
+ * the store runs ComputeQuartzVisualPulseValues on the game thread and takes the due pulses off the timing wheel.
+ */
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FQuartzVisualPulseLayoutBenchmark, "QuartzVisuals.Benchmark.PulseLayout", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::PerfFilter)
+
+bool FQuartzVisualPulseLayoutBenchmark::RunTest(const FString& Parameters)
+{
+	using namespace QuartzVisualBenchmarkTest;
+	QuartzVisualTests::FTestWorld TestWorld;
+	UQuartzVisualSubsystem* Subsystem = TestWorld.Subsystem;
+	const TArray<AQuartzVisualTestListener*> Listeners = TestWorld.SpawnListeners(NumLayoutEntries / 10);
+	UCurveFloat* Curve = QuartzVisualTests::MakeCurve();
+
+	// Ten pulses per listener over every variant, the same settings on both sides.
+	FRandomStream Random(NumLayoutEntries);
+	TArray<FQuartzVisualPulseEntry> Entries;
+	Entries.Reserve(NumLayoutEntries);
+	for(int32 EntryIndex = 0; EntryIndex < NumLayoutEntries; EntryIndex++)
+	{
+		const EQuartzVisualValueVariant Variant = static_cast<EQuartzVisualValueVariant>(Random.RandRange(0, static_cast<int32>(EQuartzVisualValueVariant::Num) - 1));
+		FQuartzVisualPulseEntry& Entry = Entries.AddDefaulted_GetRef();
+		Entry.Settings = QuartzVisualTests::MakeSettings(EntryIndex / Listeners.Num(), 0, Variant, Curve);
+		Entry.Settings.ClockName = ClockName;
+		Entry.Data.Actor = Listeners[EntryIndex % Listeners.Num()];
+		Entry.Data.BeatDuration = Random.RandRange(16, 512);
+		Entry.Data.BeatOffset = Random.RandRange(0, 64);
+		Entry.Data.CurrentBeatCount = Random.RandRange(0, 64);
+		Entry.State = EQuartzVisualPulseState::ReadyToStart;
+		Subsystem->AddNewQuartzVisualPulse(Entry.Data.Actor, Entry.Settings, Entry.Data.BeatDuration, Entry.Data.BeatOffset);
+	}
+	TestEqual(TEXT("Every pulse added"), Subsystem->QuartzVisualEntries.Num(), NumLayoutEntries);
+
+	double EntryFrameUs = 0.0;
+	double StoreFrameUs = 0.0;
+	{
+		// Game thread only, the layout is what is measured here.
+		TGuardValue<int32> SerialCompute(GQuartzVisualsParallelUpdateThreshold, 0);
+		uint64 Start = FPlatformTime::Cycles64();
+		for(int32 Frame = 0; Frame < NumFrames; Frame++)
+		{
+			for(FQuartzVisualPulseEntry& Entry : Entries)
+			{
+				Entry.UpdateValue(FrameSeconds);
+			}
+		}
+		EntryFrameUs = QuartzVisualTests::MicrosecondsSince(Start) / NumFrames;
+
+		Start = FPlatformTime::Cycles64();
+		for(int32 Frame = 0; Frame < NumFrames; Frame++)
+		{
+			Subsystem->ComputeQuartzVisualPulseValues(FrameSeconds);
+		}
+		StoreFrameUs = QuartzVisualTests::MicrosecondsSince(Start) / NumFrames;
+	}
+
+	// Steps from the first beat, each side starts and finishes the same pulses on the same step.
+	int32 EntryStarts = 0;
+	int32 EntryFinishes = 0;
+	const uint64 EntryStepStart = FPlatformTime::Cycles64();
+	for(FQuartzVisualPulseEntry& Entry : Entries)
+	{
+		Entry.Data.CurrentBeatCount = 0;
+	}
+	for(int32 Step = 0; Step < NumLayoutSteps; Step++)
+	{
+		for(int32 EntryIndex = Entries.Num() - 1; EntryIndex >= 0; EntryIndex--)
+		{
+			FQuartzVisualPulseEntry& Entry = Entries[EntryIndex];
+			Entry.Data.CurrentBeatCount++;
+			if(Entry.Data.CurrentBeatCount == Entry.Data.BeatOffset + 1)
+			{
+				Entry.State = EQuartzVisualPulseState::Start;
+				EntryStarts++;
+			}
+			else if(Entry.Data.CurrentBeatCount - Entry.Data.BeatOffset > Entry.Data.BeatDuration)
+			{
+				Entries.RemoveAtSwap(EntryIndex, 1, false);
+				EntryFinishes++;
+			}
+		}
+	}
+	const double EntryStepUs = QuartzVisualTests::MicrosecondsSince(EntryStepStart) / NumLayoutSteps;
+
+	FQuartzVisualPulseStore& Store = Subsystem->QuartzVisualEntries;
+	const int32 ClockIndex = Subsystem->FindOrAddQuartzVisualClock(ClockName);
+	int32 StoreStarts = 0;
+	int32 StoreFinishes = 0;
+	FQuartzVisualDuePulses Starting;
+	FQuartzVisualDuePulses Finishing;
+	const uint64 StoreStepStart = FPlatformTime::Cycles64();
+	for(int32 StepIndex = 0; StepIndex < NumLayoutSteps; StepIndex++)
+	{
+		const int32 Step = Store.GetClockStep(ClockIndex) + 1;
+		Starting.Reset();
+		Finishing.Reset();
+		Store.CollectDuePulses(ClockIndex, Step, Starting, Finishing);
+		for(const FQuartzVisualPulseHandle& Handle : Starting)
+		{
+			Store.Hot.State[Store.GetDenseIndex(Handle)] = EQuartzVisualPulseState::Start;
+		}
+		for(const FQuartzVisualPulseHandle& Handle : Finishing)
+		{
+			Store.Remove(Handle);
+		}
+		Store.SetClockStep(ClockIndex, Step);
+		StoreStarts += Starting.Num();
+		StoreFinishes += Finishing.Num();
+	}
+	const double StoreStepUs = QuartzVisualTests::MicrosecondsSince(StoreStepStart) / NumLayoutSteps;
+
+	TestEqual(TEXT("Same pulses started"), StoreStarts, EntryStarts);
+	TestEqual(TEXT("Same pulses finished"), StoreFinishes, EntryFinishes);
+	TestTrue(TEXT("Store valid after stepping"), Store.Validate());
+
+	const TArray<FString> Rows = {
+		FString::Printf(TEXT("Frame,%.2f,%.2f"), EntryFrameUs, StoreFrameUs),
+		FString::Printf(TEXT("Step,%.2f,%.2f"), EntryStepUs, StoreStepUs)
+	};
+	const FString CsvPath = QuartzVisualTests::WriteCsv(TEXT("PulseLayout"), TEXT("Pass,EntriesUs,StoreUs"), Rows);
+	TestFalse(TEXT("CSV written"), CsvPath.IsEmpty());
+	AddInfo(FString::Printf(TEXT("%d pulses: %.1f us per frame as entries, %.1f us in the store. %.1f us per step counting beats, %.1f us on the wheel. %s"),
+		NumLayoutEntries, EntryFrameUs, StoreFrameUs, EntryStepUs, StoreStepUs, *CsvPath));
+
+	Subsystem->RemoveAllQuartzVisualPulses();
+	return true;
+}
+
+/**
+ * Dispatch cost per actor with 1, 8 and 32 pulses each, one event per pulse against one batch per actor, each through
+ * reflection and through the native interface.
+ */
+IMPLEMENT_COMPLEX_AUTOMATION_TEST(FQuartzVisualDispatchBenchmark, "QuartzVisuals.Benchmark.BatchedDispatch", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::PerfFilter)
+
+void FQuartzVisualDispatchBenchmark::GetTests(TArray<FString>& OutBeautifiedNames, TArray<FString>& OutTestCommands) const
+{
+	for(const TCHAR* PulsesPerActor : { TEXT("1"), TEXT("8"), TEXT("32") })
+	{
+		OutBeautifiedNames.Add(FString::Printf(TEXT("%s Pulses Per Actor"), PulsesPerActor));
+		OutTestCommands.Add(PulsesPerActor);
+	}
+}
+
+bool FQuartzVisualDispatchBenchmark::RunTest(const FString& Parameters)
+{
+	using namespace QuartzVisualBenchmarkTest;
+	const int32 PulsesPerActor = FCString::Atoi(*Parameters);
+	TArray<FString> Rows;
+	for(const bool bBatched : { false, true })
+	{
+		QuartzVisualTests::FTestWorld TestWorld;
+		UQuartzVisualSubsystem* Subsystem = TestWorld.Subsystem;
+		const TArray<AQuartzVisualTestListener*> Listeners = TestWorld.SpawnListeners(NumDispatchActors, bBatched);
+		for(AQuartzVisualTestListener* Listener : Listeners)
+		{
+			for(int32 PulseIndex = 0; PulseIndex < PulsesPerActor; PulseIndex++)
+			{
+				FQuartzVisualPulseSettings Settings = QuartzVisualTests::MakeSettings(PulseIndex, 0, EQuartzVisualValueVariant::Linear);
+				Settings.ClockName = ClockName;
+				Subsystem->AddNewQuartzVisualPulse(Listener, Settings, 1000, 0);
+			}
+		}
+		StartEveryPulse(Subsystem);
+
+		for(const bool bReflected : { false, true })
+		{
+			if(bReflected)
+			{
+				ForceReflectedDispatch(Subsystem, Listeners);
+			}
+			for(AQuartzVisualTestListener* Listener : Listeners)
+			{
+				Listener->NumUpdates = 0;
+				Listener->NumBatches = 0;
+				Listener->NumBatchedUpdates = 0;
+			}
+
+			const uint64 Start = FPlatformTime::Cycles64();
+			for(int32 Run = 0; Run < NumDispatchRuns; Run++)
+			{
+				Subsystem->DispatchQuartzVisualPulseUpdates();
+			}
+			const double ActorUs = QuartzVisualTests::MicrosecondsSince(Start) / (NumDispatchRuns * NumDispatchActors);
+
+			const AQuartzVisualTestListener* Listener = Listeners[0];
+			TestEqual(TEXT("Every pulse sent each run"), bBatched ? Listener->NumBatchedUpdates : Listener->NumUpdates, PulsesPerActor * NumDispatchRuns);
+			TestEqual(TEXT("One batch per run"), Listener->NumBatches, bBatched ? NumDispatchRuns : 0);
+
+			const TCHAR* Mode = bBatched ? (bReflected ? TEXT("BatchedReflected") : TEXT("BatchedNative")) : (bReflected ? TEXT("PerPulseReflected") : TEXT("PerPulseNative"));
+			Rows.Add(FString::Printf(TEXT("%s,%.3f,%.3f"), Mode, ActorUs, ActorUs / PulsesPerActor));
+			AddInfo(FString::Printf(TEXT("%s: %.2f us per actor with %d pulses"), Mode, ActorUs, PulsesPerActor));
+		}
+	}
+	TestFalse(TEXT("CSV written"), QuartzVisualTests::WriteCsv(FString::Printf(TEXT("BatchedDispatch_%d"), PulsesPerActor), TEXT("Mode,UsPerActor,UsPerPulse"), Rows).IsEmpty());
+	return true;
+}
+
+/* One pulse on each of 5k native listeners, sent through the cached interface pointer and through the UFunction. */
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FQuartzVisualNativeDispatchBenchmark, "QuartzVisuals.Benchmark.NativeDispatch", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::PerfFilter)
+
+bool FQuartzVisualNativeDispatchBenchmark::RunTest(const FString& Parameters)
+{
+	using namespace QuartzVisualBenchmarkTest;
+	static constexpr int32 NumListeners = 5000;
+	QuartzVisualTests::FTestWorld TestWorld;
+	UQuartzVisualSubsystem* Subsystem = TestWorld.Subsystem;
+	const TArray<AQuartzVisualTestListener*> Listeners = TestWorld.SpawnListeners(NumListeners);
+
+	// Adding looks the interface up once per actor, the second pulse of each finds it on the listener.
+	uint64 Start = FPlatformTime::Cycles64();
+	for(int32 PulseIndex = 0; PulseIndex < 2; PulseIndex++)
+	{
+		for(AQuartzVisualTestListener* Listener : Listeners)
+		{
+			FQuartzVisualPulseSettings Settings = QuartzVisualTests::MakeSettings(PulseIndex, 0, EQuartzVisualValueVariant::Linear);
+			Settings.ClockName = ClockName;
+			Subsystem->AddNewQuartzVisualPulse(Listener, Settings, 1000, 0);
+		}
+	}
+	const double AddUs = QuartzVisualTests::MicrosecondsSince(Start) / (2 * NumListeners);
+	TestTrue(TEXT("Listeners found native"), Subsystem->QuartzVisualEntries.FindListener(Listeners[0])->NativeInterface != nullptr);
+	StartEveryPulse(Subsystem);
+
+	double DispatchUs[2] = {};
+	for(const bool bReflected : { false, true })
+	{
+		if(bReflected)
+		{
+			ForceReflectedDispatch(Subsystem, Listeners);
+		}
+		Listeners[0]->NumUpdates = 0;
+		Start = FPlatformTime::Cycles64();
+		for(int32 Run = 0; Run < NumDispatchRuns; Run++)
+		{
+			Subsystem->DispatchQuartzVisualPulseUpdates();
+		}
+		DispatchUs[bReflected] = QuartzVisualTests::MicrosecondsSince(Start) / NumDispatchRuns;
+		TestEqual(TEXT("Every pulse sent each run"), Listeners[0]->NumUpdates, 2 * NumDispatchRuns);
+	}
+
+	const TArray<FString> Rows = { FString::Printf(TEXT("%d,%.2f,%.2f,%.3f"), NumListeners, DispatchUs[0], DispatchUs[1], AddUs) };
+	TestFalse(TEXT("CSV written"), QuartzVisualTests::WriteCsv(TEXT("NativeDispatch"), TEXT("Listeners,NativeUs,ReflectedUs,AddUs"), Rows).IsEmpty());
+	AddInfo(FString::Printf(TEXT("%d listeners: %.1f us per dispatch native, %.1f us reflected, %.2f us per add"), NumListeners, DispatchUs[0], DispatchUs[1], AddUs));
+	return true;
+}
+
+/**
+ * Quantization callbacks per second and game thread cost with fine events on every thirty second note, against adaptive
+ * mode on beat and on bar events with the steps in between extrapolated. Switching subscriptions needs a quartz clock, so
+ * the benchmark is the clock: it sends the events of each mode's grid from a 120 BPM timeline at a fixed frame time.
+ * Pulses last at least a bar so no mode has to fall back to fine events.
+ */
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FQuartzVisualQuantizationModeBenchmark, "QuartzVisuals.Benchmark.QuantizationModes", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::PerfFilter)
+
+bool FQuartzVisualQuantizationModeBenchmark::RunTest(const FString& Parameters)
+{
+	using namespace QuartzVisualBenchmarkTest;
+	static constexpr int32 NumListeners = 1000;
+	const EQuartzCommandQuantization Modes[] = { EQuartzCommandQuantization::ThirtySecondNote, EQuartzCommandQuantization::Beat, EQuartzCommandQuantization::Bar };
+	const TCHAR* ModeNames[] = { TEXT("Fine"), TEXT("AdaptiveBeat"), TEXT("AdaptiveBar") };
+	TArray<FString> Rows;
+	int32 FineLastStep = INDEX_NONE;
+	for(int32 ModeIndex = 0; ModeIndex < UE_ARRAY_COUNT(Modes); ModeIndex++)
+	{
+		QuartzVisualTests::FTestWorld TestWorld;
+		UQuartzVisualSubsystem* Subsystem = TestWorld.Subsystem;
+		const TArray<AQuartzVisualTestListener*> Listeners = TestWorld.SpawnListeners(NumListeners);
+
+		// The stand-in clock works out the timing, then stops so only the events below reach the subsystem.
+		Subsystem->StartSimulatedQuartzVisualClock(ClockName, 120.0f, EQuartzCommandQuantization::ThirtySecondNote);
+		Subsystem->StopSimulatedQuartzVisualClock(ClockName);
+		const int32 ClockIndex = Subsystem->FindOrAddQuartzVisualClock(ClockName);
+		FQuartzVisualClockState& Clock = Subsystem->Clocks[ClockIndex];
+		const float StepsPerSecond = Clock.StepsPerSecond;
+		const int32 BeatsPerBar = FMath::RoundToInt(Clock.BeatsPerBar);
+		const int32 StepsPerBeat = FMath::RoundToInt(Clock.StepsPerBeat);
+		const int32 StepsPerEvent = Modes[ModeIndex] == EQuartzCommandQuantization::Bar ? StepsPerBeat * BeatsPerBar : Modes[ModeIndex] == EQuartzCommandQuantization::Beat ? StepsPerBeat : 1;
+		Clock.CoarseQuantization = StepsPerEvent > 1 ? Modes[ModeIndex] : EQuartzCommandQuantization::None;
+		Clock.EventQuantization = Modes[ModeIndex];
+		Clock.StepsPerCoarseEvent = StepsPerEvent;
+
+		FRandomStream Random(NumListeners);
+		for(int32 PulseIndex = 0; PulseIndex < NumListeners * 2; PulseIndex++)
+		{
+			FQuartzVisualPulseSettings Settings = QuartzVisualTests::MakeSettings(PulseIndex / NumListeners, 0, EQuartzVisualValueVariant::Linear);
+			Settings.ClockName = ClockName;
+			Subsystem->AddNewQuartzVisualPulse(Listeners[PulseIndex % NumListeners], Settings, Random.RandRange(32, 128), Random.RandRange(0, 32));
+		}
+
+		int32 NumCallbacks = 0;
+		int32 SentStep = INDEX_NONE;
+		double ClockSeconds = 0.0;
+		double EventUs = 0.0;
+		double TickUs = 0.0;
+		for(int32 Frame = 0; Frame < NumFrames; Frame++)
+		{
+			// Events arrive before the tick, for the steps the clock passed during the previous frame.
+			const int32 TargetStep = FMath::FloorToInt32(ClockSeconds * StepsPerSecond);
+			const uint64 EventStart = FPlatformTime::Cycles64();
+			for(SentStep++; SentStep <= TargetStep; SentStep++)
+			{
+				if(SentStep % StepsPerEvent == 0)
+				{
+					const int32 Beats = SentStep / StepsPerBeat;
+					Subsystem->OnQuantizationEvent(ClockName, Modes[ModeIndex], Beats / BeatsPerBar, Beats % BeatsPerBar + 1, static_cast<float>(SentStep % StepsPerBeat) / StepsPerBeat);
+					NumCallbacks++;
+				}
+			}
+			SentStep = TargetStep;
+			EventUs += QuartzVisualTests::MicrosecondsSince(EventStart);
+
+			const uint64 TickStart = FPlatformTime::Cycles64();
+			Subsystem->ForceTick(FrameSeconds);
+			TickUs += QuartzVisualTests::MicrosecondsSince(TickStart);
+			ClockSeconds += FrameSeconds;
+		}
+
+		// Extrapolated steps follow the estimate instead of waiting for events, they end within one event interval of the fine clock.
+		const int32 LastStep = Subsystem->Clocks[ClockIndex].LastStep;
+		if(ModeIndex == 0)
+		{
+			FineLastStep = LastStep;
+		}
+		else
+		{
+			TestTrue(FString::Printf(TEXT("%s stepped to %d, fine to %d"), ModeNames[ModeIndex], LastStep, FineLastStep), FMath::Abs(LastStep - FineLastStep) < StepsPerEvent);
+		}
+		TestTrue(TEXT("Store valid"), Subsystem->QuartzVisualEntries.Validate());
+
+		const double Seconds = NumFrames * FrameSeconds;
+		Rows.Add(FString::Printf(TEXT("%s,%.2f,%.2f,%.2f,%d"), ModeNames[ModeIndex], NumCallbacks / Seconds, EventUs / Seconds, TickUs / Seconds, LastStep));
+		AddInfo(FString::Printf(TEXT("%s: %.1f callbacks per second, %.1f us per second in events and %.1f us in ticks"), ModeNames[ModeIndex], NumCallbacks / Seconds, EventUs / Seconds, TickUs / Seconds));
+	}
+	TestFalse(TEXT("CSV written"), QuartzVisualTests::WriteCsv(TEXT("QuantizationModes"), TEXT("Mode,CallbacksPerSecond,EventUsPerSecond,TickUsPerSecond,LastStep"), Rows).IsEmpty());
+	return true;
+}
+
+/**
+ * Replays a capture into a fresh world, with native listeners standing in for its actors, a game frame at a time.
+ * Runs every capture under Saved/Profiling/QuartzVisuals (QuartzVisuals.Record writes them there) and one recorded
+ * from generated churn. Writes one row per game frame with the recorded frames it replayed, the replay cost and the
+ * game thread's allocations.
+ */
+IMPLEMENT_COMPLEX_AUTOMATION_TEST(FQuartzVisualReplayBenchmark, "QuartzVisuals.Benchmark.Replay", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::PerfFilter)
+
+void FQuartzVisualReplayBenchmark::GetTests(TArray<FString>& OutBeautifiedNames, TArray<FString>& OutTestCommands) const
+{
+	using namespace QuartzVisualBenchmarkTest;
+	OutBeautifiedNames.Add(TEXT("Generated Churn"));
+	OutTestCommands.Add(GeneratedCapture);
+
+	const FString CaptureDir = FPaths::Combine(FPaths::ProfilingDir(), TEXT("QuartzVisuals"));
+	TArray<FString> Captures;
+	IFileManager::Get().FindFiles(Captures, *FPaths::Combine(CaptureDir, TEXT("*.qvrec")), true, false);
+	for(const FString& Capture : Captures)
+	{
+		OutBeautifiedNames.Add(FPaths::GetBaseFilename(Capture));
+		OutTestCommands.Add(FPaths::Combine(CaptureDir, Capture));
+	}
+}
+
+bool FQuartzVisualReplayBenchmark::RunTest(const FString& Parameters)
+{
+	using namespace QuartzVisualBenchmarkTest;
+	const bool bGenerated = Parameters == GeneratedCapture;
+	// Made absolute, relative recording names are put under the profiling folder.
+	const FString FilePath = bGenerated ? FPaths::ConvertRelativePathToFull(FPaths::Combine(FPaths::AutomationTransientDir(), TEXT("QuartzVisuals"), TEXT("ReplayBenchmark.qvrec"))) : Parameters;
+	if(bGenerated && TestTrue(TEXT("Capture recorded"), RecordChurnCapture(FilePath)) == false)
+	{
+		return false;
+	}
+
+	QuartzVisualTests::FTestWorld TestWorld;
+	UQuartzVisualSubsystem* Subsystem = TestWorld.Subsystem;
+	TUniquePtr<FQuartzVisualReplayer> Replayer = MakeUnique<FQuartzVisualReplayer>();
+	if(TestTrue(TEXT("Capture opened"), Replayer->Open(FilePath, TestWorld.World, AQuartzVisualTestListener::StaticClass())) == false)
+	{
+		return false;
+	}
+	Subsystem->Replayer = MoveTemp(Replayer);
+
+	TArray<FString> Rows;
+	double TotalUs = 0.0;
+	int64 TotalAllocations = 0;
+	int32 NumCalls = 0;
+	bool bPlaying = true;
+	while(bPlaying)
+	{
+		const int32 FramesBefore = Subsystem->Replayer->GetNumFrames();
+		QuartzVisualTests::FScopedAllocationCounter Allocations;
+		const uint64 Start = FPlatformTime::Cycles64();
+		bPlaying = Subsystem->Replayer->Replay(*Subsystem, FrameSeconds);
+		const double ReplayUs = QuartzVisualTests::MicrosecondsSince(Start);
+		const int64 FrameAllocations = Allocations.GetNum();
+		TotalUs += ReplayUs;
+		TotalAllocations += FrameAllocations;
+		Rows.Add(FString::Printf(TEXT("%d,%d,%d,%.2f,%lld"), NumCalls, Subsystem->Replayer->GetNumFrames() - FramesBefore, Subsystem->QuartzVisualEntries.Num(), ReplayUs, FrameAllocations));
+		NumCalls++;
+	}
+
+	const int32 NumReplayedFrames = Subsystem->Replayer->GetNumFrames();
+	const FString CsvPath = QuartzVisualTests::WriteCsv(FString::Printf(TEXT("Replay_%s"), *FPaths::GetBaseFilename(FilePath)), TEXT("Frame,RecordedFrames,Pulses,ReplayUs,Allocations"), Rows);
+	TestFalse(TEXT("CSV written"), CsvPath.IsEmpty());
+	TestTrue(TEXT("Frames replayed"), NumReplayedFrames > 0);
+	if(bGenerated)
+	{
+		TestEqual(TEXT("Every recorded frame replayed"), NumReplayedFrames, NumFrames);
+	}
+	AddInfo(FString::Printf(TEXT("%s: %d frames, %.1f us and %.1f allocations per recorded frame with %d stand-ins. %s"), *FPaths::GetBaseFilename(FilePath), NumReplayedFrames,
+		TotalUs / FMath::Max(NumReplayedFrames, 1), static_cast<double>(TotalAllocations) / FMath::Max(NumReplayedFrames, 1), Subsystem->Replayer->GetStandIns().Num(), *CsvPath));
+
+	Subsystem->StopQuartzVisualReplay();
+	if(bGenerated)
+	{
+		IFileManager::Get().Delete(*FilePath);
+	}
+	return true;
+}
+
+#endif
@@ -0,0 +1,84 @@
+// Copyright Zuko Media 2023 all rights reserved.
+
+#include "CoreMinimal.h"
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+#include "QuartzVisualCurveCache.h"
+#include "QuartzVisualTestUtils.h"
+#include "Curves/CurveFloat.h"
+
+namespace QuartzVisualCurveCacheTest
+{
+	// Largest difference to the curve pulses may see with the default resolution, well below what a visual can show.
+	static constexpr float MaxError = 1e-3f;
+	static constexpr int32 NumDenseSamples = 10000;
+
+	// Checked everywhere, not only where MeasureMaxError looks.
+	float MeasureDenseError(const FQuartzVisualCurveTable& Table, const UCurveFloat* Curve)
+	{
+		float Error = 0.0f;
+		for(int32 SampleIndex = 0; SampleIndex <= NumDenseSamples; SampleIndex++)
+		{
+			const float Time = static_cast<float>(SampleIndex) / NumDenseSamples;
+			Error = FMath::Max(Error, FMath::Abs(Table.Evaluate(Time) - Curve->GetFloatValue(Time)));
+		}
+		return Error;
+	}
+}
+
+/**
+ * Baked tables against the exact curve. At the default resolution the error stays under the bound at every time,
+ * MeasureMaxError finds the worst of it, doubling the resolution cuts it down, and the cache rebakes when the
+ * resolution setting changes.
+ */
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FQuartzVisualCurveTableErrorTest, "QuartzVisuals.CurveCache.ErrorBound", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+
+bool FQuartzVisualCurveTableErrorTest::RunTest(const FString& Parameters)
+{
+	using namespace QuartzVisualCurveCacheTest;
+	UCurveFloat* Curve = QuartzVisualTests::MakeCurve();
+
+	FQuartzVisualCurveTable Table;
+	Table.Bake(Curve, 256);
+	const float MeasuredError = Table.MeasureMaxError(Curve);
+	const float DenseError = MeasureDenseError(Table, Curve);
+	TestTrue(FString::Printf(TEXT("Error %f within %f"), DenseError, MaxError), DenseError <= MaxError);
+	// Linear interpolation of a smooth curve peaks halfway between samples, the dense check may only land a little higher.
+	TestTrue(FString::Printf(TEXT("Measured error %f close to the dense %f"), MeasuredError, DenseError), DenseError <= MeasuredError * 1.1f + 1e-6f);
+	for(int32 SampleIndex = 0; SampleIndex < Table.Samples.Num(); SampleIndex++)
+	{
+		const float Time = static_cast<float>(SampleIndex) / (Table.Samples.Num() - 1);
+		if(FMath::IsNearlyEqual(Table.Evaluate(Time), Curve->GetFloatValue(Time), 1e-5f) == false)
+		{
+			AddError(FString::Printf(TEXT("Sample %d is off the curve"), SampleIndex));
+			break;
+		}
+	}
+	TestEqual(TEXT("Clamped below"), Table.Evaluate(-1.0f), Table.Samples[0]);
+	TestEqual(TEXT("Clamped above"), Table.Evaluate(2.0f), Table.Samples.Last());
+
+	// Second order, twice the samples leave about a quarter of the error.
+	FQuartzVisualCurveTable FineTable;
+	FineTable.Bake(Curve, 511);
+	const float FineError = MeasureDenseError(FineTable, Curve);
+	TestTrue(FString::Printf(TEXT("Error %f at 511 samples well under %f at 256"), FineError, DenseError), FineError < DenseError * 0.5f);
+
+	// The cache bakes at the setting and follows it when it changes.
+	TGuardValue<int32> Resolution(GQuartzVisualsCurveTableResolution, 16);
+	FQuartzVisualCurveCache Cache;
+	const int32 TableIndex = Cache.FindOrBake(Curve);
+	TestEqual(TEXT("Baked at the setting"), Cache.GetTable(TableIndex).Samples.Num(), 16);
+	TestEqual(TEXT("Same curve, same table"), Cache.FindOrBake(Curve), TableIndex);
+	const float CoarseError = MeasureDenseError(Cache.GetTable(TableIndex), Curve);
+	GQuartzVisualsCurveTableResolution = 256;
+	Cache.Refresh();
+	TestEqual(TEXT("Rebaked at the new setting"), Cache.GetTable(TableIndex).Samples.Num(), 256);
+	TestEqual(TEXT("Rebaked table matches a fresh one"), MeasureDenseError(Cache.GetTable(TableIndex), Curve), DenseError);
+	TestTrue(TEXT("Coarse table is worse"), CoarseError > DenseError);
+	AddInfo(FString::Printf(TEXT("Max error %f at 16 samples, %f at 256, %f at 511"), CoarseError, DenseError, FineError));
+	return true;
+}
+
+#endif
@@ -0,0 +1,171 @@
+// Copyright Zuko Media 2023 all rights reserved.
+
+#include "CoreMinimal.h"
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+#include "QuartzVisualMidiImporter.h"
+
+namespace QuartzVisualMidiImporterTest
+{
+	// 12 ticks per step at 8 steps per beat.
+	static constexpr uint16 TicksPerBeat = 96;
+	static constexpr int32 StepsPerBeat = 8;
+
+	void AppendUInt32(TArray<uint8>& Bytes, uint32 Value)
+	{
+		Bytes.Append({ static_cast<uint8>(Value >> 24), static_cast<uint8>(Value >> 16), static_cast<uint8>(Value >> 8), static_cast<uint8>(Value) });
+	}
+
+	void AppendUInt16(TArray<uint8>& Bytes, uint16 Value)
+	{
+		Bytes.Append({ static_cast<uint8>(Value >> 8), static_cast<uint8>(Value) });
+	}
+
+	// A file with each of Tracks as an MTrk chunk. The track count in the header is left as given, the importer doesn't use it.
+	TArray<uint8> MakeMidi(uint16 Format, uint16 Division, const TArray<TArray<uint8>>& Tracks)
+	{
+		TArray<uint8> Bytes;
+		AppendUInt32(Bytes, 0x4D546864);
+		AppendUInt32(Bytes, 6);
+		AppendUInt16(Bytes, Format);
+		AppendUInt16(Bytes, static_cast<uint16>(Tracks.Num()));
+		AppendUInt16(Bytes, Division);
+		for(const TArray<uint8>& Track : Tracks)
+		{
+			AppendUInt32(Bytes, 0x4D54726B);
+			AppendUInt32(Bytes, Track.Num());
+			Bytes.Append(Track);
+		}
+		return Bytes;
+	}
+
+	// A note on at 0 and its note off a beat later.
+	TArray<uint8> MakeOneNoteTrack()
+	{
+		return { 0x00, 0x90, 0x3C, 0x64, 0x60, 0x80, 0x3C, 0x00, 0x00, 0xFF, 0x2F, 0x00 };
+	}
+
+	void TestPulse(FAutomationTestBase& Test, const TArray<FQuartzVisualTrackPulse>& Pulses, int32 PulseIndex, int32 StartStep, int32 DurationSteps, uint8 Note, uint8 Channel, uint8 Velocity)
+	{
+		if(Pulses.IsValidIndex(PulseIndex) == false)
+		{
+			Test.AddError(FString::Printf(TEXT("No pulse %d"), PulseIndex));
+			return;
+		}
+		const FQuartzVisualTrackPulse& Pulse = Pulses[PulseIndex];
+		if(Pulse.StartStep != StartStep || Pulse.DurationSteps != DurationSteps || Pulse.Note != Note || Pulse.Channel != Channel || Pulse.Velocity != Velocity)
+		{
+			Test.AddError(FString::Printf(TEXT("Pulse %d is step %d for %d, note %d channel %d velocity %d. Expected step %d for %d, note %d channel %d velocity %d"),
+				PulseIndex, Pulse.StartStep, Pulse.DurationSteps, Pulse.Note, Pulse.Channel, Pulse.Velocity, StartStep, DurationSteps, Note, Channel, Velocity));
+		}
+	}
+
+	// Has to fail with an error that mentions Reason.
+	void TestRejected(FAutomationTestBase& Test, const TCHAR* What, const TArray<uint8>& MidiData, const TCHAR* Reason)
+	{
+		TArray<FQuartzVisualTrackPulse> Pulses;
+		FString Error;
+		const bool bConverted = QuartzVisualMidiImporter::ConvertMidi(MidiData, StepsPerBeat, Pulses, Error);
+		Test.TestFalse(FString::Printf(TEXT("%s rejected"), What), bConverted);
+		Test.TestTrue(FString::Printf(TEXT("%s error '%s' mentions '%s'"), What, *Error, Reason), Error.Contains(Reason));
+	}
+}
+
+/**
+ * A format 1 file with a conductor track and a note track using running status, note ons with velocity 0 as note offs,
+ * two overlapping notes of the same key and a note that is never released.
+ */
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FQuartzVisualMidiConvertTest, "QuartzVisuals.MidiImporter.Convert", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+
+bool FQuartzVisualMidiConvertTest::RunTest(const FString& Parameters)
+{
+	using namespace QuartzVisualMidiImporterTest;
+	// Tempo and time signature, the importer skips both.
+	const TArray<uint8> ConductorTrack = {
+		0x00, 0xFF, 0x51, 0x03, 0x07, 0xA1, 0x20,
+		0x00, 0xFF, 0x58, 0x04, 0x04, 0x02, 0x18, 0x08,
+		0x00, 0xFF, 0x2F, 0x00,
+	};
+	const TArray<uint8> NoteTrack = {
+		// Tick 0, note 60 on.
+		0x00, 0x90, 0x3C, 0x64,
+		// Tick 24, running status: note 60 off as a velocity 0 note on, note 62 and note 64 on.
+		0x18, 0x3C, 0x00,
+		0x00, 0x3E, 0x50,
+		0x00, 0x40, 0x10,
+		// Tick 36, note 64 again over the first.
+		0x0C, 0x40, 0x20,
+		// Tick 48, a note off closes the first note 64.
+		0x0C, 0x80, 0x40, 0x00,
+		// Tick 72, running status note offs close the second note 64 and note 62.
+		0x18, 0x40, 0x00,
+		0x00, 0x3E, 0x00,
+		// Note 48 on channel 5, never released.
+		0x00, 0x95, 0x30, 0x40,
+		// A program change has one data byte.
+		0x00, 0xC5, 0x01,
+		// Tick 96, the track ends.
+		0x18, 0xFF, 0x2F, 0x00,
+	};
+
+	TArray<FQuartzVisualTrackPulse> Pulses;
+	FString Error;
+	AddExpectedError(TEXT("have no note off"), EAutomationExpectedErrorFlags::Contains, 1);
+	if(TestTrue(TEXT("Converted"), QuartzVisualMidiImporter::ConvertMidi(MakeMidi(1, TicksPerBeat, { ConductorTrack, NoteTrack }), StepsPerBeat, Pulses, Error)) == false)
+	{
+		AddError(Error);
+		return false;
+	}
+
+	TestEqual(TEXT("Every note a pulse"), Pulses.Num(), 5);
+	TestPulse(*this, Pulses, 0, 0, 2, 60, 0, 100);
+	// Same start, kept in the order they were closed.
+	TestPulse(*this, Pulses, 1, 2, 2, 64, 0, 16);
+	TestPulse(*this, Pulses, 2, 2, 4, 62, 0, 80);
+	TestPulse(*this, Pulses, 3, 3, 3, 64, 0, 32);
+	TestPulse(*this, Pulses, 4, 6, 2, 48, 5, 64);
+	return true;
+}
+
+/**
+ * Files the importer can't play: format 2, SMPTE timing, a chunk running past the end of the file, a variable length
+ * quantity over four bytes, data before any status and a file that isn't MIDI at all. A good file still converts
+ * after them, with a step resolution that makes a note shorter than a step last one step.
+ */
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FQuartzVisualMidiRejectTest, "QuartzVisuals.MidiImporter.Reject", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+
+bool FQuartzVisualMidiRejectTest::RunTest(const FString& Parameters)
+{
+	using namespace QuartzVisualMidiImporterTest;
+	TestRejected(*this, TEXT("Format 2"), MakeMidi(2, TicksPerBeat, { MakeOneNoteTrack() }), TEXT("Format 2"));
+	// 25 frames per second, 40 ticks per frame.
+	TestRejected(*this, TEXT("SMPTE"), MakeMidi(1, 0xE728, { MakeOneNoteTrack() }), TEXT("SMPTE"));
+	TestRejected(*this, TEXT("Zero division"), MakeMidi(1, 0, { MakeOneNoteTrack() }), TEXT("SMPTE"));
+
+	TArray<uint8> Truncated = MakeMidi(0, TicksPerBeat, { MakeOneNoteTrack() });
+	Truncated.SetNum(Truncated.Num() - 4);
+	TestRejected(*this, TEXT("Truncated chunk"), Truncated, TEXT("truncated"));
+
+	const TArray<uint8> LongDelta = { 0x81, 0x81, 0x81, 0x81, 0x00, 0x90, 0x3C, 0x64, 0x00, 0xFF, 0x2F, 0x00 };
+	TestRejected(*this, TEXT("Five byte delta"), MakeMidi(0, TicksPerBeat, { LongDelta }), TEXT("corrupt"));
+
+	const TArray<uint8> NoStatus = { 0x00, 0x3C, 0x64, 0x00, 0xFF, 0x2F, 0x00 };
+	TestRejected(*this, TEXT("Data before any status"), MakeMidi(0, TicksPerBeat, { NoStatus }), TEXT("corrupt"));
+
+	TArray<uint8> NotMidi = MakeMidi(0, TicksPerBeat, { MakeOneNoteTrack() });
+	NotMidi[0] = 'R';
+	TestRejected(*this, TEXT("Not MIDI"), NotMidi, TEXT("Not a standard MIDI file"));
+
+	// A beat is 96 ticks, at one step per beat a 10 tick note still gets a step.
+	const TArray<uint8> ShortNote = { 0x00, 0x90, 0x3C, 0x64, 0x0A, 0x80, 0x3C, 0x00, 0x00, 0xFF, 0x2F, 0x00 };
+	TArray<FQuartzVisualTrackPulse> Pulses;
+	FString Error;
+	TestTrue(TEXT("Good file after the bad ones"), QuartzVisualMidiImporter::ConvertMidi(MakeMidi(0, TicksPerBeat, { ShortNote }), 1, Pulses, Error));
+	TestPulse(*this, Pulses, 0, 0, 1, 60, 0, 100);
+	TestFalse(TEXT("Zero steps per beat rejected"), QuartzVisualMidiImporter::ConvertMidi(MakeMidi(0, TicksPerBeat, { ShortNote }), 0, Pulses, Error));
+	return true;
+}
+
+#endif
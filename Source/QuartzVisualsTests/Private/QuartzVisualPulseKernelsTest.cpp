@@ -0,0 +1,175 @@
+// Copyright Zuko Media 2023 all rights reserved.
+
+#include "CoreMinimal.h"
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+#include "QuartzVisualPulseKernels.h"
+#include "QuartzVisualTestUtils.h"
+
+namespace QuartzVisualPulseKernelsTest
+{
+	static constexpr float Tolerance = 1e-5f;
+	static const TCHAR* VariantNames[] = { TEXT("None"), TEXT("Linear"), TEXT("Remap"), TEXT("Curve"), TEXT("CurveRemap") };
+
+	// Inputs of one EvaluateValues call, filled with the awkward cases: not started, past the end, snapping speeds.
+	struct FKernelInput
+	{
+		TArray<int32> CurrentStep;
+		TArray<int32> StartStep;
+		TArray<int32> BeatDuration;
+		TArray<float> SubStep;
+		TArray<int32> CurveTable;
+		TArray<float> OutValueMin;
+		TArray<float> OutValueMax;
+		TArray<float> InterpSpeed;
+		TArray<float> CurrentValue;
+		TArray<float> DeltaSeconds;
+
+		FKernelInput(FRandomStream& Random, const int32 Num, const int32 NumTables)
+		{
+			for(int32 Index = 0; Index < Num; Index++)
+			{
+				BeatDuration.Add(Random.RandRange(1, 32));
+				StartStep.Add(Random.RandRange(0, 100));
+				CurrentStep.Add(StartStep.Last() + Random.RandRange(-4, BeatDuration.Last() + 4));
+				SubStep.Add(Random.FRand());
+				CurveTable.Add(Random.RandHelper(NumTables));
+				OutValueMin.Add(Random.FRandRange(-5.0f, 5.0f));
+				OutValueMax.Add(Random.FRandRange(-5.0f, 5.0f));
+				InterpSpeed.Add(Random.RandHelper(4) == 0 ? 0.0f : Random.FRandRange(0.5f, 80.0f));
+				CurrentValue.Add(Random.FRandRange(-5.0f, 5.0f));
+				DeltaSeconds.Add(Random.FRandRange(0.001f, 0.05f));
+			}
+		}
+
+		void Evaluate(const EQuartzVisualValueVariant Variant, const FQuartzVisualCurveTable* Tables, float* OutNormalized, float* OutValue) const
+		{
+			QuartzVisualPulseKernels::EvaluateValues(Variant, CurrentStep.GetData(), StartStep.GetData(), BeatDuration.GetData(), SubStep.GetData(),
+				CurveTable.GetData(), Tables, OutValueMin.GetData(), OutValueMax.GetData(), InterpSpeed.GetData(), CurrentValue.GetData(),
+				OutNormalized, OutValue, DeltaSeconds.GetData(), CurrentStep.Num());
+		}
+
+		// One entry at a time with the math of FQuartzVisualPulseHotData::UpdateValue, plus the sub step.
+		void EvaluateScalar(const EQuartzVisualValueVariant Variant, const FQuartzVisualCurveTable* Tables, float* OutNormalized, float* OutValue) const
+		{
+			const bool bCurve = Variant == EQuartzVisualValueVariant::Curve || Variant == EQuartzVisualValueVariant::CurveRemap;
+			const bool bRemap = Variant == EQuartzVisualValueVariant::Remap || Variant == EQuartzVisualValueVariant::CurveRemap;
+			for(int32 Index = 0; Index < CurrentStep.Num(); Index++)
+			{
+				const float Duration = static_cast<float>(BeatDuration[Index]);
+				const float Progress = FMath::Clamp(static_cast<float>(CurrentStep[Index] - StartStep[Index]) + SubStep[Index], 0.0f, Duration) / Duration;
+				float Target = bCurve ? Tables[CurveTable[Index]].Evaluate(Progress) : Progress;
+				Target = bRemap ? FMath::Lerp(OutValueMin[Index], OutValueMax[Index], Target) : Target;
+				OutNormalized[Index] = Progress;
+				OutValue[Index] = FMath::FInterpTo(CurrentValue[Index], Target, DeltaSeconds[Index], InterpSpeed[Index]);
+			}
+		}
+	};
+
+	void BakeTables(TArray<FQuartzVisualCurveTable>& OutTables)
+	{
+		UCurveFloat* Curve = QuartzVisualTests::MakeCurve();
+		OutTables.SetNum(2);
+		OutTables[0].Bake(Curve, GQuartzVisualsCurveTableResolution);
+		// Coarse on purpose, lanes pointing at different tables must not mix.
+		OutTables[1].Bake(Curve, 5);
+	}
+}
+
+/**
+ * EvaluateValues against a one entry at a time reference for every variant. The sizes cover the vector loop alone,
+ * the tail of one to three entries alone and both together, and the value may be written in place.
+ */
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FQuartzVisualPulseKernelsTest, "QuartzVisuals.PulseKernels.MatchesScalar", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+
+bool FQuartzVisualPulseKernelsTest::RunTest(const FString& Parameters)
+{
+	using namespace QuartzVisualPulseKernelsTest;
+	TArray<FQuartzVisualCurveTable> Tables;
+	BakeTables(Tables);
+	FRandomStream Random(4);
+
+	for(const int32 Num : { 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 16, 63, 1027 })
+	{
+		for(int32 Variant = static_cast<int32>(EQuartzVisualValueVariant::Linear); Variant < static_cast<int32>(EQuartzVisualValueVariant::Num); Variant++)
+		{
+			const EQuartzVisualValueVariant ValueVariant = static_cast<EQuartzVisualValueVariant>(Variant);
+			const FKernelInput Input(Random, Num, Tables.Num());
+			TArray<float> Normalized;
+			TArray<float> Value;
+			TArray<float> ExpectedNormalized;
+			TArray<float> ExpectedValue;
+			Normalized.SetNumZeroed(Num);
+			Value.SetNumZeroed(Num);
+			ExpectedNormalized.SetNumZeroed(Num);
+			ExpectedValue.SetNumZeroed(Num);
+			Input.Evaluate(ValueVariant, Tables.GetData(), Normalized.GetData(), Value.GetData());
+			Input.EvaluateScalar(ValueVariant, Tables.GetData(), ExpectedNormalized.GetData(), ExpectedValue.GetData());
+
+			// In place, the way the store runs it when nothing is waiting to start.
+			FKernelInput InPlace = Input;
+			TArray<float> InPlaceNormalized;
+			InPlaceNormalized.SetNumZeroed(Num);
+			InPlace.Evaluate(ValueVariant, Tables.GetData(), InPlaceNormalized.GetData(), InPlace.CurrentValue.GetData());
+
+			for(int32 Index = 0; Index < Num; Index++)
+			{
+				if(FMath::IsNearlyEqual(Normalized[Index], ExpectedNormalized[Index], Tolerance) == false
+					|| FMath::IsNearlyEqual(Value[Index], ExpectedValue[Index], Tolerance) == false
+					|| FMath::IsNearlyEqual(InPlace.CurrentValue[Index], ExpectedValue[Index], Tolerance) == false)
+				{
+					AddError(FString::Printf(TEXT("Variant %d, %d entries, entry %d: %f %f (in place %f), expected %f %f"), Variant, Num, Index,
+						Normalized[Index], Value[Index], InPlace.CurrentValue[Index], ExpectedNormalized[Index], ExpectedValue[Index]));
+					return false;
+				}
+			}
+		}
+	}
+	return true;
+}
+
+/* Nanoseconds per entry of EvaluateValues and of the reference, per variant over 4096 entries. */
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FQuartzVisualPulseKernelsBenchmark, "QuartzVisuals.Benchmark.PulseKernels", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::PerfFilter)
+
+bool FQuartzVisualPulseKernelsBenchmark::RunTest(const FString& Parameters)
+{
+	using namespace QuartzVisualPulseKernelsTest;
+	static constexpr int32 NumEntries = 4096;
+	static constexpr int32 NumRuns = 1000;
+	TArray<FQuartzVisualCurveTable> Tables;
+	BakeTables(Tables);
+	FRandomStream Random(NumEntries);
+	const FKernelInput Input(Random, NumEntries, Tables.Num());
+	TArray<float> Normalized;
+	TArray<float> Value;
+	Normalized.SetNumZeroed(NumEntries);
+	Value.SetNumZeroed(NumEntries);
+
+	TArray<FString> Rows;
+	for(int32 Variant = static_cast<int32>(EQuartzVisualValueVariant::Linear); Variant < static_cast<int32>(EQuartzVisualValueVariant::Num); Variant++)
+	{
+		const EQuartzVisualValueVariant ValueVariant = static_cast<EQuartzVisualValueVariant>(Variant);
+		uint64 Start = FPlatformTime::Cycles64();
+		for(int32 Run = 0; Run < NumRuns; Run++)
+		{
+			Input.Evaluate(ValueVariant, Tables.GetData(), Normalized.GetData(), Value.GetData());
+		}
+		const double KernelNs = QuartzVisualTests::MicrosecondsSince(Start) * 1000.0 / (NumRuns * NumEntries);
+
+		Start = FPlatformTime::Cycles64();
+		for(int32 Run = 0; Run < NumRuns; Run++)
+		{
+			Input.EvaluateScalar(ValueVariant, Tables.GetData(), Normalized.GetData(), Value.GetData());
+		}
+		const double ScalarNs = QuartzVisualTests::MicrosecondsSince(Start) * 1000.0 / (NumRuns * NumEntries);
+
+		Rows.Add(FString::Printf(TEXT("%s,%.3f,%.3f"), VariantNames[Variant], KernelNs, ScalarNs));
+		AddInfo(FString::Printf(TEXT("%s: %.2f ns per entry, %.2f ns one at a time"), VariantNames[Variant], KernelNs, ScalarNs));
+	}
+	TestFalse(TEXT("CSV written"), QuartzVisualTests::WriteCsv(TEXT("PulseKernels"), TEXT("Variant,KernelNs,ScalarNs"), Rows).IsEmpty());
+	return true;
+}
+
+#endif
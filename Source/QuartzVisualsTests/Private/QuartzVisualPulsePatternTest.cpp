@@ -0,0 +1,109 @@
+// Copyright Zuko Media 2023 all rights reserved.
+
+#include "CoreMinimal.h"
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+#include "QuartzVisualPulsePattern.h"
+#include "QuartzVisualSubsystem.h"
+#include "QuartzVisualTestListener.h"
+#include "QuartzVisualTestUtils.h"
+
+namespace QuartzVisualPulsePatternTest
+{
+	FQuartzVisualPatternPulse MakePulse(int32 Index, int32 IndexFilter, int32 BeatOffset, int32 BeatDuration, float MaxValue = 1.0f)
+	{
+		FQuartzVisualPatternPulse Pulse;
+		Pulse.Settings = QuartzVisualTests::MakeSettings(Index, IndexFilter, EQuartzVisualValueVariant::Remap);
+		Pulse.Settings.OutValueMinMax = FVector2D(0.0f, MaxValue);
+		Pulse.BeatOffset = BeatOffset;
+		Pulse.BeatDuration = BeatDuration;
+		return Pulse;
+	}
+}
+
+/**
+ * Compiling sorts by offset, clamps offsets and durations, keeps a key hit at several offsets and drops only the same key
+ * at the same offset, keeping the last. Changes are only picked up after MarkPulsesDirty.
+ */
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FQuartzVisualPulsePatternCompileTest, "QuartzVisuals.PulsePattern.Compile", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+
+bool FQuartzVisualPulsePatternCompileTest::RunTest(const FString& Parameters)
+{
+	using namespace QuartzVisualPulsePatternTest;
+	UQuartzVisualPulsePattern* Pattern = NewObject<UQuartzVisualPulsePattern>(GetTransientPackage());
+	Pattern->Pulses.Add(MakePulse(0, 0, 4, 2));
+	Pattern->Pulses.Add(MakePulse(1, 0, -3, 0));
+	Pattern->Pulses.Add(MakePulse(0, 0, 8, 1));
+	Pattern->Pulses.Add(MakePulse(2, 0, 4, 1));
+	Pattern->Pulses.Add(MakePulse(0, 0, 4, 3, 2.0f));
+
+	const TArray<FQuartzVisualPatternPulse>& Compiled = Pattern->GetCompiledPulses();
+	if(TestEqual(TEXT("Same key at the same offset dropped, other offsets kept"), Compiled.Num(), 4) == false)
+	{
+		return false;
+	}
+	TestEqual(TEXT("Negative offset clamped and first"), Compiled[0].BeatOffset, 0);
+	TestEqual(TEXT("Zero duration clamped"), Compiled[0].BeatDuration, 1);
+	TestEqual(TEXT("Ties keep the authored order"), Compiled[1].Settings.Index, 2);
+	TestEqual(TEXT("Last of the duplicates kept"), Compiled[2].BeatDuration, 3);
+	TestEqual(TEXT("Last of the duplicates takes its place in the order"), Compiled[2].Settings.OutValueMinMax.Y, 2.0f);
+	TestEqual(TEXT("Second hit of the key last"), Compiled[3].BeatOffset, 8);
+	TestEqual(TEXT("Length runs to the end of the last pulse"), Pattern->GetPatternLength(), 9);
+
+	// Without MarkPulsesDirty the old compile is still served.
+	Pattern->Pulses.Add(MakePulse(3, 0, 12, 4));
+	TestEqual(TEXT("Not recompiled before MarkPulsesDirty"), Pattern->GetCompiledPulses().Num(), 4);
+	TestEqual(TEXT("Length unchanged before MarkPulsesDirty"), Pattern->GetPatternLength(), 9);
+	Pattern->MarkPulsesDirty();
+	TestEqual(TEXT("Recompiled after MarkPulsesDirty"), Pattern->GetCompiledPulses().Num(), 5);
+	TestEqual(TEXT("Length after MarkPulsesDirty"), Pattern->GetPatternLength(), 16);
+	return true;
+}
+
+/**
+ * Every hit of a pattern lands in the store as a pulse of its own and is counted, replaying the pattern replaces rather
+ * than adds, and removing the key from an actor removes every hit of it.
+ */
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FQuartzVisualPulsePatternAddTest, "QuartzVisuals.PulsePattern.AddCount", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+
+bool FQuartzVisualPulsePatternAddTest::RunTest(const FString& Parameters)
+{
+	using namespace QuartzVisualPulsePatternTest;
+	static constexpr int32 NumListeners = 3;
+	QuartzVisualTests::FTestWorld TestWorld;
+	UQuartzVisualSubsystem* Subsystem = TestWorld.Subsystem;
+	const TArray<AQuartzVisualTestListener*> Listeners = TestWorld.SpawnListeners(NumListeners);
+	TArray<AActor*> Actors(Listeners);
+	Actors.Add(nullptr);
+
+	UQuartzVisualPulsePattern* Pattern = NewObject<UQuartzVisualPulsePattern>(GetTransientPackage());
+	Pattern->Pulses.Add(MakePulse(0, 0, 0, 1));
+	Pattern->Pulses.Add(MakePulse(0, 0, 2, 1));
+	Pattern->Pulses.Add(MakePulse(0, 0, 2, 1));
+	Pattern->Pulses.Add(MakePulse(1, 0, 2, 1));
+
+	TestEqual(TEXT("Each kept hit counted per valid actor"), Subsystem->AddQuartzVisualPulsePattern(Actors, Pattern), NumListeners * 3);
+	TestEqual(TEXT("Both hits of the key stored"), Subsystem->QuartzVisualEntries.Num(), NumListeners * 3);
+	TestTrue(TEXT("First hit keyed as the plain pulse"), Subsystem->QuartzVisualEntries.Find(FQuartzVisualPulseKey(Listeners[0], 0, 0)).IsSet());
+	TestTrue(TEXT("Second hit keyed as a repeat"), Subsystem->QuartzVisualEntries.Find(FQuartzVisualPulseKey(Listeners[0], 0, 0, nullptr, 1)).IsSet());
+
+	TestEqual(TEXT("Replaying counts again"), Subsystem->AddQuartzVisualPulsePattern(Actors, Pattern, 4), NumListeners * 3);
+	TestEqual(TEXT("Replaying replaces hit for hit"), Subsystem->QuartzVisualEntries.Num(), NumListeners * 3);
+	TestEqual(TEXT("StopIfExists adds nothing over live pulses"), Subsystem->AddQuartzVisualPulsePattern(Actors, Pattern, 8, true), 0);
+	TestEqual(TEXT("StopIfExists keeps the live pulses"), Subsystem->QuartzVisualEntries.Num(), NumListeners * 3);
+
+	// Uncompiled pulses through the array overload are numbered the same way.
+	const TArray<FQuartzVisualPatternPulse> Pulses = { MakePulse(5, 0, 0, 1), MakePulse(5, 0, 1, 1), MakePulse(5, 0, 3, 1) };
+	TestEqual(TEXT("Array overload counts every hit"), Subsystem->AddNewQuartzVisualPulses(Actors, Pulses), NumListeners * 3);
+	TestEqual(TEXT("Array overload stores every hit"), Subsystem->QuartzVisualEntries.Num(), NumListeners * 6);
+
+	Subsystem->RemoveQuartzVisualPulseFromActor(0, 0, Listeners[0]);
+	TestEqual(TEXT("Removing the key removes its repeats"), Subsystem->QuartzVisualEntries.Num(), NumListeners * 6 - 2);
+	TestTrue(TEXT("Other keys on the actor kept"), Subsystem->QuartzVisualEntries.Find(FQuartzVisualPulseKey(Listeners[0], 1, 0)).IsSet());
+	TestTrue(TEXT("Other actors kept"), Subsystem->QuartzVisualEntries.Find(FQuartzVisualPulseKey(Listeners[1], 0, 0, nullptr, 1)).IsSet());
+	return true;
+}
+
+#endif
@@ -0,0 +1,207 @@
+// Copyright Zuko Media 2023 all rights reserved.
+
+#include "CoreMinimal.h"
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+#include "QuartzVisualPulseStore.h"
+#include "QuartzVisualTestListener.h"
+#include "QuartzVisualTestUtils.h"
+#include "Engine/World.h"
+
+namespace QuartzVisualPulseStoreTest
+{
+	static constexpr int32 NumClocks = 3;
+
+	FQuartzVisualPulseEntry MakeEntry(FRandomStream& Random, AActor* Actor, UCurveFloat* Curve)
+	{
+		const EQuartzVisualValueVariant Variant = static_cast<EQuartzVisualValueVariant>(Random.RandRange(0, static_cast<int32>(EQuartzVisualValueVariant::Num) - 1));
+		FQuartzVisualPulseEntry Entry;
+		Entry.Settings = QuartzVisualTests::MakeSettings(Random.RandRange(0, 7), Random.RandRange(0, 1), Variant, Curve);
+		Entry.Data.BeatDuration = Random.RandRange(1, 16);
+		// Past the wheel sometimes, so pulses wait a turn.
+		Entry.Data.BeatOffset = Random.RandHelper(8) == 0 ? Random.RandRange(256, 600) : Random.RandRange(0, 8);
+		Entry.Data.Actor = Actor;
+		Entry.State = EQuartzVisualPulseState::ReadyToStart;
+		return Entry;
+	}
+}
+
+/**
+ * Seeded random adds, replaces, removes by handle and by dense index, group pulses with members coming and going and
+ * clock steps, on a store of its own. The store has to validate after every single operation and match a plain map of
+ * what should be in it.
+ */
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FQuartzVisualPulseStoreChurnTest, "QuartzVisuals.PulseStore.Churn", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+
+bool FQuartzVisualPulseStoreChurnTest::RunTest(const FString& Parameters)
+{
+	using namespace QuartzVisualPulseStoreTest;
+	QuartzVisualTests::FTestWorld TestWorld;
+	const TArray<AQuartzVisualTestListener*> Actors = TestWorld.SpawnListeners(16);
+	UCurveFloat* Curve = QuartzVisualTests::MakeCurve();
+
+	FQuartzVisualPulseStore Store;
+	TMap<FQuartzVisualPulseKey, FQuartzVisualPulseHandle> Expected;
+	TArray<FQuartzVisualPulseHandle> StaleHandles;
+	int32 NextGroupIndex = 0;
+	FRandomStream Random(1234);
+
+	auto Forget = [&Expected, &StaleHandles](const FQuartzVisualPulseHandle& Handle)
+	{
+		for(auto It = Expected.CreateIterator(); It; ++It)
+		{
+			if(It.Value() == Handle)
+			{
+				It.RemoveCurrent();
+				break;
+			}
+		}
+		StaleHandles.Add(Handle);
+	};
+
+	for(int32 Operation = 0; Operation < 4000; Operation++)
+	{
+		const int32 Action = Random.RandHelper(20);
+		FString Description;
+		if(Action < 7)
+		{
+			AActor* Actor = Actors[Random.RandHelper(Actors.Num())];
+			const FQuartzVisualPulseEntry Entry = MakeEntry(Random, Actor, Curve);
+			const FQuartzVisualPulseKey Key(Entry);
+			// Same key replaces, as the subsystem does.
+			const FQuartzVisualPulseHandle Existing = Store.Find(Key);
+			if(Existing.IsSet())
+			{
+				Store.Remove(Existing);
+				Forget(Existing);
+			}
+			Expected.Add(Key, Store.Add(Entry, Random.RandHelper(NumClocks), Key));
+			Description = TEXT("add");
+		}
+		else if(Action < 9)
+		{
+			const int32 GroupIndex = NextGroupIndex++;
+			const FQuartzVisualPulseKey Key(nullptr, GroupIndex, 0, TestWorld.World);
+			const FQuartzVisualPulseHandle Handle = Store.Add(MakeEntry(Random, nullptr, Curve), Random.RandHelper(NumClocks), Key, GroupIndex);
+			Expected.Add(Key, Handle);
+			const int32 NumMembers = Random.RandRange(1, 4);
+			for(int32 Member = 0; Member < NumMembers; Member++)
+			{
+				AActor* Actor = Actors[Random.RandHelper(Actors.Num())];
+				if(Store.FindActorGroupHandles(Actor) == nullptr || Store.FindActorGroupHandles(Actor)->Contains(Handle) == false)
+				{
+					Store.AddGroupMember(Handle, Actor);
+				}
+			}
+			Description = TEXT("add group");
+		}
+		else if(Action < 10)
+		{
+			AActor* Actor = Actors[Random.RandHelper(Actors.Num())];
+			const TArray<FQuartzVisualPulseHandle>* Groups = Store.FindActorGroupHandles(Actor);
+			if(Groups && Groups->Num() > 0)
+			{
+				Store.RemoveGroupMember((*Groups)[Random.RandHelper(Groups->Num())], Actor);
+			}
+			Description = TEXT("remove group member");
+		}
+		else if(Action < 13)
+		{
+			if(Expected.Num() > 0)
+			{
+				TArray<FQuartzVisualPulseHandle> Handles;
+				Expected.GenerateValueArray(Handles);
+				const FQuartzVisualPulseHandle Handle = Handles[Random.RandHelper(Handles.Num())];
+				TestTrue(TEXT("Live handle removed"), Store.Remove(Handle));
+				Forget(Handle);
+			}
+			Description = TEXT("remove");
+		}
+		else if(Action < 16)
+		{
+			if(Store.Num() > 0)
+			{
+				const int32 DenseIndex = Random.RandHelper(Store.Num());
+				const FQuartzVisualPulseHandle Handle = Store.GetHandle(DenseIndex);
+				Store.RemoveAt(DenseIndex);
+				Forget(Handle);
+			}
+			Description = TEXT("remove at");
+		}
+		else if(Action < 17)
+		{
+			if(StaleHandles.Num() > 0)
+			{
+				const FQuartzVisualPulseHandle Handle = StaleHandles[Random.RandHelper(StaleHandles.Num())];
+				TestFalse(TEXT("Stale handle rejected"), Store.Remove(Handle));
+				TestEqual(TEXT("Stale handle has no entry"), Store.GetDenseIndex(Handle), static_cast<int32>(INDEX_NONE));
+			}
+			Description = TEXT("remove stale");
+		}
+		else if(Action < 19)
+		{
+			// A step the way the subsystem takes it, finished pulses are removed.
+			const int32 ClockIndex = Random.RandHelper(NumClocks);
+			const int32 Step = Store.GetClockStep(ClockIndex) + 1;
+			FQuartzVisualDuePulses Starting;
+			FQuartzVisualDuePulses Finishing;
+			Store.CollectDuePulses(ClockIndex, Step, Starting, Finishing);
+			for(const FQuartzVisualPulseHandle& Handle : Finishing)
+			{
+				if(Store.Remove(Handle))
+				{
+					Forget(Handle);
+				}
+			}
+			Store.SetClockStep(ClockIndex, Step);
+			Description = TEXT("step");
+		}
+		else
+		{
+			const int32 ClockIndex = Random.RandHelper(NumClocks);
+			Store.RebaseClock(ClockIndex, Store.GetClockStep(ClockIndex) + Random.RandRange(-50, 500));
+			Description = TEXT("rebase");
+		}
+
+		if(Store.Validate() == false)
+		{
+			AddError(FString::Printf(TEXT("Store invalid after operation %d (%s)"), Operation, *Description));
+			return false;
+		}
+		if(Store.Num() != Expected.Num())
+		{
+			AddError(FString::Printf(TEXT("Store has %d entries after operation %d (%s), expected %d"), Store.Num(), Operation, *Description, Expected.Num()));
+			return false;
+		}
+		for(const TPair<FQuartzVisualPulseKey, FQuartzVisualPulseHandle>& Pair : Expected)
+		{
+			if((Store.Find(Pair.Key) == Pair.Value) == false || Store.GetDenseIndex(Pair.Value) == INDEX_NONE)
+			{
+				AddError(FString::Printf(TEXT("Entry lost after operation %d (%s)"), Operation, *Description));
+				return false;
+			}
+		}
+	}
+
+	// Draining from the front moves every later variant down.
+	while(Store.Num() > 0)
+	{
+		Store.RemoveAt(0);
+		if(Store.Validate() == false)
+		{
+			AddError(FString::Printf(TEXT("Store invalid while draining with %d entries left"), Store.Num()));
+			return false;
+		}
+	}
+	TestEqual(TEXT("No listeners left"), Store.GetListeners().Num(), 0);
+	for(AActor* Actor : Actors)
+	{
+		const TArray<FQuartzVisualPulseHandle>* Groups = Store.FindActorGroupHandles(Actor);
+		TestTrue(TEXT("No group memberships left"), Groups == nullptr || Groups->Num() == 0);
+	}
+	return true;
+}
+
+#endif
@@ -0,0 +1,118 @@
+// Copyright Zuko Media 2023 all rights reserved.
+
+#include "CoreMinimal.h"
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+#include "QuartzVisualPulseTrack.h"
+#include "HAL/FileManager.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+
+namespace QuartzVisualPulseTrackTest
+{
+	TArray<FQuartzVisualTrackPulse> MakePulses(int32 Num)
+	{
+		TArray<FQuartzVisualTrackPulse> Pulses;
+		for(int32 PulseIndex = 0; PulseIndex < Num; PulseIndex++)
+		{
+			FQuartzVisualTrackPulse& Pulse = Pulses.AddDefaulted_GetRef();
+			Pulse.StartStep = PulseIndex * 3;
+			Pulse.DurationSteps = 1 + PulseIndex % 5;
+			Pulse.Note = static_cast<uint8>(PulseIndex % 128);
+			Pulse.Channel = static_cast<uint8>(PulseIndex % 16);
+			Pulse.Velocity = static_cast<uint8>(1 + PulseIndex % 127);
+		}
+		return Pulses;
+	}
+
+	// Rewrites the header of the file at FilePath.
+	template<typename EditType>
+	bool EditHeader(const FString& FilePath, EditType&& Edit)
+	{
+		TArray<uint8> Bytes;
+		if(FFileHelper::LoadFileToArray(Bytes, *FilePath) == false || Bytes.Num() < static_cast<int32>(sizeof(FQuartzVisualTrackHeader)))
+		{
+			return false;
+		}
+		Edit(*reinterpret_cast<FQuartzVisualTrackHeader*>(Bytes.GetData()));
+		return FFileHelper::SaveArrayToFile(Bytes, *FilePath);
+	}
+}
+
+/**
+ * Tracks read back exactly as written. Opening refuses a wrong magic, a wrong version, a header claiming more pulses than
+ * the file holds, a file shorter than a header and a missing file, and leaves the track closed after each.
+ */
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FQuartzVisualPulseTrackFileTest, "QuartzVisuals.PulseTrack.WriteOpen", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+
+bool FQuartzVisualPulseTrackFileTest::RunTest(const FString& Parameters)
+{
+	using namespace QuartzVisualPulseTrackTest;
+	static constexpr int32 NumPulses = 1000;
+	const FString FilePath = FPaths::Combine(FPaths::AutomationTransientDir(), TEXT("QuartzVisuals"), TEXT("PulseTrackTest.qvpt"));
+	IFileManager::Get().MakeDirectory(*FPaths::GetPath(FilePath), true);
+	const TArray<FQuartzVisualTrackPulse> Pulses = MakePulses(NumPulses);
+
+	{
+		if(TestTrue(TEXT("Written"), FQuartzVisualMappedPulseTrack::Write(FilePath, 12, Pulses)) == false)
+		{
+			return false;
+		}
+		FQuartzVisualMappedPulseTrack Track;
+		if(TestTrue(TEXT("Opened"), Track.Open(FilePath)) == false)
+		{
+			return false;
+		}
+		TestEqual(TEXT("StepsPerBeat"), Track.GetHeader().StepsPerBeat, 12);
+		TestEqual(TEXT("NumPulses"), Track.GetHeader().NumPulses, NumPulses);
+		TestEqual(TEXT("LengthSteps runs to the end of the last pulse"), Track.GetHeader().LengthSteps, Pulses.Last().StartStep + Pulses.Last().DurationSteps);
+		const TConstArrayView<FQuartzVisualTrackPulse> ReadPulses = Track.GetPulses();
+		TestTrue(TEXT("Pulses read back as written"), ReadPulses.Num() == NumPulses && FMemory::Memcmp(ReadPulses.GetData(), Pulses.GetData(), NumPulses * sizeof(FQuartzVisualTrackPulse)) == 0);
+
+		// Moving hands the mapping over.
+		FQuartzVisualMappedPulseTrack MovedTrack(MoveTemp(Track));
+		TestTrue(TEXT("Moved track open"), MovedTrack.IsOpen() && MovedTrack.GetPulses().Num() == NumPulses);
+	}
+
+	{
+		FQuartzVisualMappedPulseTrack Track;
+		TestTrue(TEXT("Empty track written"), FQuartzVisualMappedPulseTrack::Write(FilePath, 8, TArray<FQuartzVisualTrackPulse>()));
+		TestTrue(TEXT("Empty track opened"), Track.Open(FilePath) && Track.GetPulses().Num() == 0 && Track.GetHeader().LengthSteps == 0);
+	}
+
+	AddExpectedError(TEXT("is not a pulse track"), EAutomationExpectedErrorFlags::Contains, 4);
+	AddExpectedError(TEXT("Can't open pulse track"), EAutomationExpectedErrorFlags::Contains, 1);
+	// A file shorter than a header can't be mapped either, it is loaded before it's refused.
+	AddExpectedError(TEXT("Can't map pulse track"), EAutomationExpectedErrorFlags::Contains, 1);
+	const auto TestRefused = [this, &FilePath, &Pulses](const TCHAR* What, TFunction<void(FQuartzVisualTrackHeader&)> Edit)
+	{
+		FQuartzVisualMappedPulseTrack::Write(FilePath, 8, Pulses);
+		TestTrue(FString::Printf(TEXT("%s header written"), What), EditHeader(FilePath, Edit));
+		FQuartzVisualMappedPulseTrack Track;
+		TestFalse(FString::Printf(TEXT("%s refused"), What), Track.Open(FilePath));
+		TestFalse(FString::Printf(TEXT("%s left closed"), What), Track.IsOpen());
+		TestEqual(FString::Printf(TEXT("%s has no pulses"), What), Track.GetPulses().Num(), 0);
+	};
+	TestRefused(TEXT("Wrong magic"), [](FQuartzVisualTrackHeader& Header) { Header.Magic ^= 0xFF; });
+	TestRefused(TEXT("Wrong version"), [](FQuartzVisualTrackHeader& Header) { Header.Version++; });
+	TestRefused(TEXT("More pulses than the file"), [](FQuartzVisualTrackHeader& Header) { Header.NumPulses++; });
+
+	{
+		// Shorter than a header.
+		const TArray<uint8> Bytes = { 'Q', 'V', 'P', 'T' };
+		FFileHelper::SaveArrayToFile(Bytes, *FilePath);
+		FQuartzVisualMappedPulseTrack Track;
+		TestFalse(TEXT("Short file refused"), Track.Open(FilePath));
+	}
+
+	IFileManager::Get().Delete(*FilePath);
+	{
+		FQuartzVisualMappedPulseTrack Track;
+		TestFalse(TEXT("Missing file refused"), Track.Open(FilePath));
+	}
+	return true;
+}
+
+#endif
@@ -0,0 +1,161 @@
+// Copyright Zuko Media 2023 all rights reserved.
+
+#include "CoreMinimal.h"
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+#include "QuartzVisualSubsystem.h"
+#include "QuartzVisualTestListener.h"
+#include "QuartzVisualTestUtils.h"
+#include "HAL/FileManager.h"
+#include "Misc/Paths.h"
+
+namespace QuartzVisualRecorderTest
+{
+	static constexpr float FrameSeconds = 1.0f / 60.0f;
+	static constexpr int32 NumFrames = 240;
+	static constexpr int32 NumListeners = 8;
+	static const FName ClockName(TEXT("QuartzVisualsRecorderTest"));
+
+	struct FReceived
+	{
+		int32 NumStarts = 0;
+		int32 NumUpdates = 0;
+		int32 NumFinishes = 0;
+		uint32 ReceivedHash = 0;
+	};
+
+	FReceived GetReceived(const AQuartzVisualTestListener* Listener)
+	{
+		FReceived Received;
+		Received.NumStarts = Listener->NumStarts;
+		Received.NumUpdates = Listener->NumUpdates;
+		Received.NumFinishes = Listener->NumFinishes;
+		Received.ReceivedHash = Listener->ReceivedHash;
+		return Received;
+	}
+
+	// Curves are left out, a transient curve has no path the replay could load it from.
+	FQuartzVisualPulseSettings MakeSettings(int32 Index, int32 IndexFilter, bool bRemap)
+	{
+		FQuartzVisualPulseSettings Settings = QuartzVisualTests::MakeSettings(Index, IndexFilter, bRemap ? EQuartzVisualValueVariant::Remap : EQuartzVisualValueVariant::Linear);
+		Settings.ClockName = ClockName;
+		return Settings;
+	}
+}
+
+/**
+ * A session on a simulated clock with adds, replacements, group adds, removes, a group member leaving, RemoveAll and adds
+ * after it, replayed into a fresh world. The stand-ins the replay spawns for the listeners have to be sent exactly what
+ * the listeners were, value for value.
+ */
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FQuartzVisualRecordReplayTest, "QuartzVisuals.Recorder.ReplayMatchesRecording", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+
+bool FQuartzVisualRecordReplayTest::RunTest(const FString& Parameters)
+{
+	using namespace QuartzVisualRecorderTest;
+	// Made absolute, relative recording names are put under the profiling folder.
+	const FString FilePath = FPaths::ConvertRelativePathToFull(FPaths::Combine(FPaths::AutomationTransientDir(), TEXT("QuartzVisuals"), TEXT("RecordReplayTest.qvrec")));
+	// Recordings append sessions to an existing file.
+	IFileManager::Get().Delete(*FilePath);
+
+	TArray<FReceived> Recorded;
+	{
+		QuartzVisualTests::FTestWorld RecordWorld;
+		UQuartzVisualSubsystem* Subsystem = RecordWorld.Subsystem;
+		const TArray<AQuartzVisualTestListener*> Listeners = RecordWorld.SpawnListeners(NumListeners);
+		Subsystem->StartSimulatedQuartzVisualClock(ClockName, 120.0f, EQuartzCommandQuantization::ThirtySecondNote);
+		if(TestTrue(TEXT("Recording started"), Subsystem->StartQuartzVisualRecording(FilePath)) == false)
+		{
+			return false;
+		}
+
+		// In listener order, so the replay's stand-ins are spawned in the same order.
+		TArray<FQuartzVisualPulseHandle> Handles;
+		for(int32 ListenerIndex = 0; ListenerIndex < NumListeners; ListenerIndex++)
+		{
+			Handles.Add(Subsystem->AddNewQuartzVisualPulse(Listeners[ListenerIndex], MakeSettings(0, 0, ListenerIndex % 2 == 0), 4 + ListenerIndex, ListenerIndex % 3));
+		}
+
+		FQuartzVisualPulseHandle GroupHandle;
+		for(int32 Frame = 0; Frame < NumFrames; Frame++)
+		{
+			switch(Frame)
+			{
+			case 20:
+				GroupHandle = Subsystem->AddNewQuartzVisualGroupPulse({ Listeners[0], Listeners[2], Listeners[4] }, MakeSettings(1, 0, true), 24, 1);
+				break;
+			case 30:
+				// Replaces the listener's pulse of the same key.
+				Subsystem->AddNewQuartzVisualPulse(Listeners[1], MakeSettings(0, 0, true), 16, 0);
+				break;
+			case 40:
+				Subsystem->RemoveQuartzVisualPulse(Handles[7]);
+				Subsystem->RemoveQuartzVisualGroupMember(GroupHandle, Listeners[2]);
+				break;
+			case 50:
+				Subsystem->RemoveAllQuartzVisualPulsesFromActor(Listeners[4]);
+				break;
+			case 120:
+				Subsystem->RemoveAllQuartzVisualPulses();
+				break;
+			default:
+				break;
+			}
+			// A steady trickle of new pulses, before and after RemoveAll.
+			if(Frame % 15 == 5)
+			{
+				const int32 ListenerIndex = (Frame / 15) % NumListeners;
+				Subsystem->AddNewQuartzVisualPulse(Listeners[ListenerIndex], MakeSettings(2 + Frame % 3, 1, Frame % 2 == 0), 2 + Frame % 7, Frame % 4);
+			}
+			Subsystem->ForceTick(FrameSeconds);
+		}
+		Subsystem->StopQuartzVisualRecording();
+
+		for(const AQuartzVisualTestListener* Listener : Listeners)
+		{
+			Recorded.Add(GetReceived(Listener));
+		}
+		TestTrue(TEXT("The session sent updates"), Recorded[0].NumUpdates > 0 && Recorded[0].NumFinishes > 1);
+	}
+
+	// The recording world is gone, its listeners are replaced by stand-ins of the same class.
+	QuartzVisualTests::FTestWorld ReplayWorld;
+	UQuartzVisualSubsystem* Subsystem = ReplayWorld.Subsystem;
+	TUniquePtr<FQuartzVisualReplayer> Replayer = MakeUnique<FQuartzVisualReplayer>();
+	if(TestTrue(TEXT("Recording opened"), Replayer->Open(FilePath, ReplayWorld.World, AQuartzVisualTestListener::StaticClass())) == false)
+	{
+		return false;
+	}
+	Subsystem->Replayer = MoveTemp(Replayer);
+	TestFalse(TEXT("Replayed to the end"), Subsystem->Replayer->Replay(*Subsystem, TNumericLimits<double>::Max()));
+	TestEqual(TEXT("Every frame replayed"), Subsystem->Replayer->GetNumFrames(), NumFrames);
+
+	const TArray<TWeakObjectPtr<AActor>>& StandIns = Subsystem->Replayer->GetStandIns();
+	if(TestEqual(TEXT("A stand-in per listener"), StandIns.Num(), NumListeners))
+	{
+		for(int32 ListenerIndex = 0; ListenerIndex < NumListeners; ListenerIndex++)
+		{
+			const AQuartzVisualTestListener* StandIn = Cast<AQuartzVisualTestListener>(StandIns[ListenerIndex].Get());
+			if(StandIn == nullptr)
+			{
+				AddError(FString::Printf(TEXT("Stand-in %d is missing"), ListenerIndex));
+				continue;
+			}
+			const FReceived Replayed = GetReceived(StandIn);
+			const FReceived& Expected = Recorded[ListenerIndex];
+			if(Replayed.NumStarts != Expected.NumStarts || Replayed.NumUpdates != Expected.NumUpdates || Replayed.NumFinishes != Expected.NumFinishes || Replayed.ReceivedHash != Expected.ReceivedHash)
+			{
+				AddError(FString::Printf(TEXT("Listener %d was sent %d starts, %d updates and %d finishes (hash %08x), the replay %d, %d and %d (hash %08x)"), ListenerIndex,
+					Expected.NumStarts, Expected.NumUpdates, Expected.NumFinishes, Expected.ReceivedHash, Replayed.NumStarts, Replayed.NumUpdates, Replayed.NumFinishes, Replayed.ReceivedHash));
+			}
+		}
+	}
+
+	Subsystem->StopQuartzVisualReplay();
+	IFileManager::Get().Delete(*FilePath);
+	return true;
+}
+
+#endif
@@ -0,0 +1,538 @@
+// Copyright Zuko Media 2023 all rights reserved.
+
+#include "CoreMinimal.h"
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+#include "QuartzVisualSubsystem.h"
+#include "QuartzVisualTestListener.h"
+#include "QuartzVisualTestUtils.h"
+#include "Async/Async.h"
+#include "Components/InstancedStaticMeshComponent.h"
+#include "Quartz/QuartzSubsystem.h"
+
+namespace QuartzVisualSubsystemTest
+{
+	static constexpr float FrameSeconds = 1.0f / 60.0f;
+	static const FName ClockName(TEXT("QuartzVisualsTest"));
+
+	// Bitwise, a rounding difference is a failure too.
+	template<typename ElementType>
+	bool AreIdentical(const TArray<ElementType>& A, const TArray<ElementType>& B)
+	{
+		return A.Num() == B.Num() && FMemory::Memcmp(A.GetData(), B.GetData(), A.Num() * sizeof(ElementType)) == 0;
+	}
+}
+
+/**
+ * Two worlds with the same seeded pulses on the same simulated clock, one computing on the game thread and one over
+ * the task graph. Every frame the values, states and what the listeners were sent have to be bit identical.
+ */
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FQuartzVisualParallelComputeTest, "QuartzVisuals.Subsystem.ParallelMatchesSerial", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+
+bool FQuartzVisualParallelComputeTest::RunTest(const FString& Parameters)
+{
+	using namespace QuartzVisualSubsystemTest;
+	static constexpr int32 NumListeners = 3000;
+	static constexpr int32 NumFrames = 120;
+	QuartzVisualTests::FTestWorld SerialWorld;
+	QuartzVisualTests::FTestWorld ParallelWorld;
+	UCurveFloat* Curve = QuartzVisualTests::MakeCurve();
+	TArray<AQuartzVisualTestListener*> Listeners[2];
+	UQuartzVisualSubsystem* Subsystems[2] = { SerialWorld.Subsystem, ParallelWorld.Subsystem };
+	Listeners[0] = SerialWorld.SpawnListeners(NumListeners);
+	Listeners[1] = ParallelWorld.SpawnListeners(NumListeners);
+
+	for(int32 WorldIndex = 0; WorldIndex < 2; WorldIndex++)
+	{
+		FRandomStream Random(NumListeners);
+		Subsystems[WorldIndex]->StartSimulatedQuartzVisualClock(ClockName, 120.0f, EQuartzCommandQuantization::ThirtySecondNote);
+		for(int32 PulseIndex = 0; PulseIndex < NumListeners * 3; PulseIndex++)
+		{
+			const EQuartzVisualValueVariant Variant = static_cast<EQuartzVisualValueVariant>(Random.RandRange(0, static_cast<int32>(EQuartzVisualValueVariant::Num) - 1));
+			FQuartzVisualPulseSettings Settings = QuartzVisualTests::MakeSettings(PulseIndex / NumListeners, 0, Variant, Curve);
+			Settings.ClockName = ClockName;
+			Settings.InterpSpeed = Random.FRandRange(0.0f, 30.0f);
+			const int32 BeatDuration = Random.RandRange(1, 48);
+			Subsystems[WorldIndex]->AddNewQuartzVisualPulse(Listeners[WorldIndex][PulseIndex % NumListeners], Settings, BeatDuration, Random.RandRange(0, 8));
+		}
+	}
+	TestTrue(TEXT("Enough pulses for several chunks"), Subsystems[0]->QuartzVisualEntries.Num() > 4 * 1024);
+
+	for(int32 Frame = 0; Frame < NumFrames; Frame++)
+	{
+		{
+			TGuardValue<int32> Serial(GQuartzVisualsParallelUpdateThreshold, 0);
+			Subsystems[0]->ForceTick(FrameSeconds);
+		}
+		{
+			TGuardValue<int32> Parallel(GQuartzVisualsParallelUpdateThreshold, 1);
+			Subsystems[1]->ForceTick(FrameSeconds);
+		}
+
+		const FQuartzVisualPulseHotData& SerialHot = Subsystems[0]->QuartzVisualEntries.Hot;
+		const FQuartzVisualPulseHotData& ParallelHot = Subsystems[1]->QuartzVisualEntries.Hot;
+		if(AreIdentical(SerialHot.OutValue, ParallelHot.OutValue) == false
+			|| AreIdentical(SerialHot.OutValueNormalized, ParallelHot.OutValueNormalized) == false
+			|| AreIdentical(SerialHot.State, ParallelHot.State) == false)
+		{
+			AddError(FString::Printf(TEXT("Values differ on frame %d"), Frame));
+			return false;
+		}
+		for(int32 ListenerIndex = 0; ListenerIndex < NumListeners; ListenerIndex++)
+		{
+			const AQuartzVisualTestListener* SerialListener = Listeners[0][ListenerIndex];
+			const AQuartzVisualTestListener* ParallelListener = Listeners[1][ListenerIndex];
+			if(SerialListener->NumStarts != ParallelListener->NumStarts || SerialListener->NumUpdates != ParallelListener->NumUpdates
+				|| SerialListener->NumFinishes != ParallelListener->NumFinishes
+				|| FMemory::Memcmp(&SerialListener->LastValue, &ParallelListener->LastValue, sizeof(float)) != 0)
+			{
+				AddError(FString::Printf(TEXT("Listener %d was sent something else on frame %d"), ListenerIndex, Frame));
+				return false;
+			}
+		}
+	}
+	TestTrue(TEXT("Pulses finished along the way"), Subsystems[0]->QuartzVisualEntries.Num() < NumListeners * 3);
+	return true;
+}
+
+/**
+ * Group members leaving from inside their own update or finish. Every other member still gets every update and exactly
+ * one finish, the one leaving gets its finish once, and a group emptied by removals goes with its last member.
+ */
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FQuartzVisualGroupMemberRemovalTest, "QuartzVisuals.Subsystem.GroupMemberRemoval", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+
+bool FQuartzVisualGroupMemberRemovalTest::RunTest(const FString& Parameters)
+{
+	using namespace QuartzVisualSubsystemTest;
+	static constexpr int32 NumMembers = 5;
+	// A second, the pulses last half of it.
+	static constexpr int32 NumFrames = 60;
+	QuartzVisualTests::FTestWorld TestWorld;
+	UQuartzVisualSubsystem* Subsystem = TestWorld.Subsystem;
+	Subsystem->StartSimulatedQuartzVisualClock(ClockName, 120.0f, EQuartzCommandQuantization::ThirtySecondNote);
+	FQuartzVisualPulseSettings Settings = QuartzVisualTests::MakeSettings(0, 0, EQuartzVisualValueVariant::Linear);
+	Settings.ClockName = ClockName;
+	auto Run = [Subsystem]()
+	{
+		for(int32 Frame = 0; Frame < NumFrames; Frame++)
+		{
+			Subsystem->ForceTick(FrameSeconds);
+		}
+	};
+
+	// The first member leaves on its first update. Removing it by swapping would skip the last member for that frame.
+	{
+		const TArray<AQuartzVisualTestListener*> Members = TestWorld.SpawnListeners(NumMembers);
+		FQuartzVisualPulseHandle Handle;
+		bool bLeft = false;
+		Members[0]->OnUpdate = [Subsystem, &Members, &Handle, &bLeft](const FQuartzVisualPulseEntry& PulseData)
+		{
+			if(PulseData.State == EQuartzVisualPulseState::Updating && bLeft == false)
+			{
+				bLeft = true;
+				Subsystem->RemoveQuartzVisualGroupMember(Handle, Members[0]);
+			}
+		};
+		Handle = Subsystem->AddNewQuartzVisualGroupPulse(TArray<AActor*>(Members), Settings, 8, 0);
+		Run();
+		TestTrue(TEXT("Update: member left"), bLeft);
+		TestEqual(TEXT("Update: leaving member finished once"), Members[0]->NumFinishes, 1);
+		for(int32 MemberIndex = 1; MemberIndex < NumMembers; MemberIndex++)
+		{
+			TestEqual(FString::Printf(TEXT("Update: member %d started once"), MemberIndex), Members[MemberIndex]->NumStarts, 1);
+			TestEqual(FString::Printf(TEXT("Update: member %d got every update"), MemberIndex), Members[MemberIndex]->NumUpdates, Members[1]->NumUpdates);
+			TestEqual(FString::Printf(TEXT("Update: member %d finished once"), MemberIndex), Members[MemberIndex]->NumFinishes, 1);
+		}
+		TestTrue(TEXT("Update: pulse done"), Subsystem->QuartzVisualEntries.GetDenseIndex(Handle) == INDEX_NONE);
+	}
+
+	// The first member takes itself and another member out from inside the group's finish.
+	{
+		const TArray<AQuartzVisualTestListener*> Members = TestWorld.SpawnListeners(NumMembers);
+		FQuartzVisualPulseHandle Handle;
+		Members[0]->OnUpdate = [Subsystem, &Members, &Handle](const FQuartzVisualPulseEntry& PulseData)
+		{
+			if(PulseData.State == EQuartzVisualPulseState::Finished)
+			{
+				Subsystem->RemoveAllQuartzVisualPulsesFromActor(Members[0]);
+				Subsystem->RemoveQuartzVisualGroupMember(Handle, Members[2]);
+			}
+		};
+		Handle = Subsystem->AddNewQuartzVisualGroupPulse(TArray<AActor*>(Members), Settings, 8, 0);
+		Run();
+		for(int32 MemberIndex = 0; MemberIndex < NumMembers; MemberIndex++)
+		{
+			TestEqual(FString::Printf(TEXT("Finish: member %d finished once"), MemberIndex), Members[MemberIndex]->NumFinishes, 1);
+		}
+		TestTrue(TEXT("Finish: pulse done"), Subsystem->QuartzVisualEntries.GetDenseIndex(Handle) == INDEX_NONE);
+	}
+
+	// Outside of any dispatch, the group goes with its last member.
+	{
+		const TArray<AQuartzVisualTestListener*> Members = TestWorld.SpawnListeners(2);
+		const FQuartzVisualPulseHandle Handle = Subsystem->AddNewQuartzVisualGroupPulse(TArray<AActor*>(Members), Settings, 1000, 0);
+		Subsystem->ForceTick(FrameSeconds);
+		TestTrue(TEXT("Removed first member"), Subsystem->RemoveQuartzVisualGroupMember(Handle, Members[0]));
+		TestFalse(TEXT("Removed member is no longer in the group"), Subsystem->RemoveQuartzVisualGroupMember(Handle, Members[0]));
+		TestTrue(TEXT("Pulse kept for the other member"), Subsystem->QuartzVisualEntries.GetDenseIndex(Handle) != INDEX_NONE);
+		TestTrue(TEXT("Removed last member"), Subsystem->RemoveQuartzVisualGroupMember(Handle, Members[1]));
+		TestTrue(TEXT("Pulse removed with its last member"), Subsystem->QuartzVisualEntries.GetDenseIndex(Handle) == INDEX_NONE);
+		TestEqual(TEXT("First member finished once"), Members[0]->NumFinishes, 1);
+		TestEqual(TEXT("Last member finished once"), Members[1]->NumFinishes, 1);
+	}
+	TestEqual(TEXT("No groups left"), Subsystem->PulseGroups.Num(), 0);
+	TestTrue(TEXT("Store valid"), Subsystem->QuartzVisualEntries.Validate());
+	return true;
+}
+
+/**
+ * Instance pulses write their value into the component's per instance custom data and never call the owner.
+ * Needs no mesh and no GPU, the custom data is read back from the component.
+ */
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FQuartzVisualInstancePulseTest, "QuartzVisuals.Subsystem.InstanceCustomData", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+
+bool FQuartzVisualInstancePulseTest::RunTest(const FString& Parameters)
+{
+	using namespace QuartzVisualSubsystemTest;
+	static constexpr int32 NumInstances = 64;
+	static constexpr int32 NumCustomData = 2;
+	QuartzVisualTests::FTestWorld TestWorld;
+	UQuartzVisualSubsystem* Subsystem = TestWorld.Subsystem;
+	AQuartzVisualTestListener* Owner = TestWorld.SpawnListeners(1)[0];
+	UInstancedStaticMeshComponent* Component = NewObject<UInstancedStaticMeshComponent>(Owner);
+	Owner->SetRootComponent(Component);
+	Component->RegisterComponent();
+	Component->SetNumCustomDataFloats(NumCustomData);
+	for(int32 Instance = 0; Instance < NumInstances; Instance++)
+	{
+		Component->AddInstance(FTransform(FVector(Instance * 100.0f, 0.0f, 0.0f)));
+	}
+
+	Subsystem->StartSimulatedQuartzVisualClock(ClockName, 120.0f, EQuartzCommandQuantization::ThirtySecondNote);
+	TArray<FQuartzVisualPulseHandle> Handles;
+	for(int32 Instance = 0; Instance < NumInstances; Instance++)
+	{
+		for(int32 CustomDataIndex = 0; CustomDataIndex < NumCustomData; CustomDataIndex++)
+		{
+			FQuartzVisualPulseSettings Settings = QuartzVisualTests::MakeSettings(0, 0, CustomDataIndex == 0 ? EQuartzVisualValueVariant::Linear : EQuartzVisualValueVariant::Remap);
+			Settings.ClockName = ClockName;
+			Handles.Add(Subsystem->AddNewQuartzVisualInstancePulse(Component, Instance, CustomDataIndex, Settings, 16 + Instance % 8, Instance % 4));
+		}
+	}
+	TestEqual(TEXT("Every instance pulse added"), Subsystem->QuartzVisualEntries.Num(), NumInstances * NumCustomData);
+	TestTrue(TEXT("Store valid"), Subsystem->QuartzVisualEntries.Validate());
+	{
+		AddExpectedError(TEXT("out of range"), EAutomationExpectedErrorFlags::Contains, 2);
+		TestFalse(TEXT("Custom data past the end refused"), Subsystem->AddNewQuartzVisualInstancePulse(Component, 0, NumCustomData, FQuartzVisualPulseSettings(), 4, 0).IsSet());
+		TestFalse(TEXT("Missing instance refused"), Subsystem->AddNewQuartzVisualInstancePulse(Component, NumInstances, 0, FQuartzVisualPulseSettings(), 4, 0).IsSet());
+	}
+
+	// Sixteen steps a second, half a second in is past the start of every pulse and before the end of any.
+	for(int32 Frame = 0; Frame < 30; Frame++)
+	{
+		Subsystem->ForceTick(FrameSeconds);
+	}
+	int32 NumWritten = 0;
+	for(int32 PulseIndex = 0; PulseIndex < Handles.Num(); PulseIndex++)
+	{
+		const int32 DenseIndex = Subsystem->QuartzVisualEntries.GetDenseIndex(Handles[PulseIndex]);
+		if(DenseIndex == INDEX_NONE)
+		{
+			AddError(FString::Printf(TEXT("Pulse %d finished early"), PulseIndex));
+			continue;
+		}
+		const float Written = Component->PerInstanceSMCustomData[PulseIndex];
+		TestEqual(FString::Printf(TEXT("Custom data %d holds the pulse value"), PulseIndex), Written, Subsystem->QuartzVisualEntries.Hot.OutValue[DenseIndex]);
+		// Linear values only leave zero once the pulse has run.
+		NumWritten += PulseIndex % NumCustomData == 0 && Written > 0.0f ? 1 : 0;
+	}
+	TestEqual(TEXT("Every linear slot written"), NumWritten, NumInstances);
+	TestEqual(TEXT("Owner sent nothing"), Owner->NumStarts + Owner->NumUpdates + Owner->NumFinishes + Owner->NumBatches, 0);
+
+	Subsystem->RemoveQuartzVisualInstancePulse(Component, 0, 0);
+	TestEqual(TEXT("Removed by instance and slot"), Subsystem->QuartzVisualEntries.GetDenseIndex(Handles[0]), static_cast<int32>(INDEX_NONE));
+	Subsystem->RemoveAllQuartzVisualPulses();
+	TestEqual(TEXT("Every pulse removed"), Subsystem->QuartzVisualEntries.Num(), 0);
+	return true;
+}
+
+/**
+ * A long show with one persistent pulse, instanced meshes coming and going. Each component's sink is released with its
+ * last pulse or once the component is destroyed, and the next component reuses it, so the sinks never pile up.
+ */
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FQuartzVisualInstanceSinkReleaseTest, "QuartzVisuals.Subsystem.InstanceSinkRelease", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+
+bool FQuartzVisualInstanceSinkReleaseTest::RunTest(const FString& Parameters)
+{
+	using namespace QuartzVisualSubsystemTest;
+	static constexpr int32 NumComponents = 16;
+	static constexpr int32 NumInstances = 3;
+	QuartzVisualTests::FTestWorld TestWorld;
+	UQuartzVisualSubsystem* Subsystem = TestWorld.Subsystem;
+	AQuartzVisualTestListener* Owner = TestWorld.SpawnListeners(1)[0];
+	Subsystem->StartSimulatedQuartzVisualClock(ClockName, 120.0f, EQuartzCommandQuantization::ThirtySecondNote);
+	FQuartzVisualPulseSettings Settings = QuartzVisualTests::MakeSettings(0, 0, EQuartzVisualValueVariant::Linear);
+	Settings.ClockName = ClockName;
+	// Keeps the store from ever emptying, which would reset the sinks on its own.
+	const FQuartzVisualPulseHandle Persistent = Subsystem->AddNewQuartzVisualPulse(Owner, Settings, 100000, 0);
+
+	for(int32 ComponentIndex = 0; ComponentIndex < NumComponents; ComponentIndex++)
+	{
+		UInstancedStaticMeshComponent* Component = NewObject<UInstancedStaticMeshComponent>(Owner);
+		Component->SetupAttachment(Owner->GetRootComponent());
+		Component->RegisterComponent();
+		Component->SetNumCustomDataFloats(1);
+		for(int32 Instance = 0; Instance < NumInstances; Instance++)
+		{
+			Component->AddInstance(FTransform::Identity);
+			Subsystem->AddNewQuartzVisualInstancePulse(Component, Instance, 0, Settings, 100000, 0);
+		}
+		const int32* SinkIndex = Subsystem->InstanceSinkLookup.Find(TObjectKey<UInstancedStaticMeshComponent>(Component));
+		if(SinkIndex == nullptr)
+		{
+			AddError(FString::Printf(TEXT("Component %d has no sink"), ComponentIndex));
+			return false;
+		}
+		TestEqual(TEXT("Sink counts its pulses"), Subsystem->InstanceSinks[*SinkIndex].NumPulses, NumInstances);
+		for(int32 Frame = 0; Frame < 4; Frame++)
+		{
+			Subsystem->ForceTick(FrameSeconds);
+		}
+
+		if(ComponentIndex % 2 == 0)
+		{
+			for(int32 Instance = 0; Instance < NumInstances; Instance++)
+			{
+				Subsystem->RemoveQuartzVisualInstancePulse(Component, Instance, 0);
+			}
+			Component->DestroyComponent();
+		}
+		else
+		{
+			// Destroyed with its pulses still going, the next garbage collection prunes them.
+			Component->DestroyComponent();
+			Subsystem->PruneQuartzVisualInstanceSinks();
+		}
+		TestEqual(FString::Printf(TEXT("Component %d: only the persistent pulse left"), ComponentIndex), Subsystem->QuartzVisualEntries.Num(), 1);
+		TestEqual(FString::Printf(TEXT("Component %d: lookup empty"), ComponentIndex), Subsystem->InstanceSinkLookup.Num(), 0);
+		TestEqual(FString::Printf(TEXT("Component %d: sink reused"), ComponentIndex), Subsystem->InstanceSinks.Num(), 1);
+		TestEqual(FString::Printf(TEXT("Component %d: sink free"), ComponentIndex), Subsystem->FreeInstanceSinks.Num(), 1);
+	}
+	TestTrue(TEXT("Persistent pulse untouched"), Subsystem->QuartzVisualEntries.GetDenseIndex(Persistent) != INDEX_NONE);
+	TestTrue(TEXT("Store valid"), Subsystem->QuartzVisualEntries.Validate());
+	return true;
+}
+
+/**
+ * Producer threads queue adds, removes, remove alls and cancels for listeners of their own while the game thread keeps
+ * draining the queue. Commands of one producer are applied in order, so once everything is drained each listener has
+ * exactly the pulses its producer's own sequence leaves, and the store has to validate all along.
+ */
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FQuartzVisualCommandQueueStressTest, "QuartzVisuals.Subsystem.CommandQueueStress", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+
+bool FQuartzVisualCommandQueueStressTest::RunTest(const FString& Parameters)
+{
+	using namespace QuartzVisualSubsystemTest;
+	static constexpr int32 NumProducers = 8;
+	static constexpr int32 ListenersPerProducer = 32;
+	static constexpr int32 CommandsPerProducer = 20000;
+	static constexpr int32 NumIndices = 8;
+	// Added on the game thread first so there are handles to cancel, queued adds use the other filter.
+	static constexpr int32 CancelFilter = 1;
+	QuartzVisualTests::FTestWorld TestWorld;
+	UQuartzVisualSubsystem* Subsystem = TestWorld.Subsystem;
+	const TArray<AQuartzVisualTestListener*> Listeners = TestWorld.SpawnListeners(NumProducers * ListenersPerProducer);
+
+	TArray<FQuartzVisualPulseHandle> CancelHandles;
+	for(int32 ListenerIndex = 0; ListenerIndex < Listeners.Num(); ListenerIndex++)
+	{
+		for(int32 Index = 0; Index < NumIndices; Index++)
+		{
+			FQuartzVisualPulseSettings Settings = QuartzVisualTests::MakeSettings(Index, CancelFilter, EQuartzVisualValueVariant::Linear);
+			Settings.ClockName = ClockName;
+			CancelHandles.Add(Subsystem->AddNewQuartzVisualPulse(Listeners[ListenerIndex], Settings, 1000, 0));
+		}
+	}
+
+	// What each producer expects its listeners to end up with, keyed the same as the store.
+	TArray<TSet<FQuartzVisualPulseKey>> Expected;
+	Expected.SetNum(NumProducers);
+	TArray<TFuture<void>> Producers;
+	for(int32 Producer = 0; Producer < NumProducers; Producer++)
+	{
+		TSet<FQuartzVisualPulseKey>& ProducerExpected = Expected[Producer];
+		for(int32 Slot = 0; Slot < ListenersPerProducer * NumIndices; Slot++)
+		{
+			ProducerExpected.Add(FQuartzVisualPulseKey(Listeners[Producer * ListenersPerProducer + Slot / NumIndices], Slot % NumIndices, CancelFilter));
+		}
+		Producers.Add(Async(EAsyncExecution::Thread, [Subsystem, &Listeners, &CancelHandles, &ProducerExpected, Producer]()
+		{
+			FRandomStream Random(Producer + 1);
+			for(int32 Command = 0; Command < CommandsPerProducer; Command++)
+			{
+				const int32 Slot = Random.RandHelper(ListenersPerProducer * NumIndices);
+				AQuartzVisualTestListener* Listener = Listeners[Producer * ListenersPerProducer + Slot / NumIndices];
+				const int32 Index = Random.RandHelper(NumIndices);
+				const int32 Action = Random.RandHelper(16);
+				if(Action < 8)
+				{
+					FQuartzVisualPulseSettings Settings = QuartzVisualTests::MakeSettings(Index, 0, EQuartzVisualValueVariant::Linear);
+					Settings.ClockName = ClockName;
+					Subsystem->EnqueueQuartzVisualPulse(Listener, Settings, 1000, 0);
+					ProducerExpected.Add(FQuartzVisualPulseKey(Listener, Index, 0));
+				}
+				else if(Action < 13)
+				{
+					Subsystem->EnqueueRemoveQuartzVisualPulseFromActor(Index, 0, Listener);
+					ProducerExpected.Remove(FQuartzVisualPulseKey(Listener, Index, 0));
+				}
+				else if(Action < 14)
+				{
+					Subsystem->EnqueueRemoveAllQuartzVisualPulsesFromActor(Listener);
+					for(int32 Filter = 0; Filter <= CancelFilter; Filter++)
+					{
+						for(int32 AnyIndex = 0; AnyIndex < NumIndices; AnyIndex++)
+						{
+							ProducerExpected.Remove(FQuartzVisualPulseKey(Listener, AnyIndex, Filter));
+						}
+					}
+				}
+				else
+				{
+					// Stale by now if a remove all got to it first, which cancels nothing.
+					const int32 ListenerSlot = Slot / NumIndices;
+					Subsystem->EnqueueCancelQuartzVisualPulse(CancelHandles[(Producer * ListenersPerProducer + ListenerSlot) * NumIndices + Index]);
+					ProducerExpected.Remove(FQuartzVisualPulseKey(Listener, Index, CancelFilter));
+				}
+			}
+		}));
+	}
+
+	// Drain while the producers are still going, the way ticks and events would.
+	int32 NumDrains = 0;
+	bool bValid = true;
+	while(Producers.ContainsByPredicate([](const TFuture<void>& Future) { return Future.IsReady() == false; }))
+	{
+		Subsystem->ProcessQuartzVisualCommands();
+		bValid &= Subsystem->QuartzVisualEntries.Validate();
+		NumDrains++;
+		FPlatformProcess::Sleep(0.0f);
+	}
+	for(TFuture<void>& Future : Producers)
+	{
+		Future.Wait();
+	}
+	Subsystem->ProcessQuartzVisualCommands();
+	TestTrue(TEXT("Store valid while draining"), bValid);
+	TestTrue(TEXT("Store valid after draining"), Subsystem->QuartzVisualEntries.Validate());
+	TestTrue(TEXT("Queue empty"), Subsystem->CommandQueue.IsEmpty());
+
+	int32 NumExpected = 0;
+	for(int32 Producer = 0; Producer < NumProducers; Producer++)
+	{
+		NumExpected += Expected[Producer].Num();
+		for(const FQuartzVisualPulseKey& Key : Expected[Producer])
+		{
+			if(Subsystem->QuartzVisualEntries.Find(Key).IsSet() == false)
+			{
+				AddError(FString::Printf(TEXT("Producer %d: pulse %d / %d missing"), Producer, Key.Index, Key.IndexFilter));
+				return false;
+			}
+		}
+	}
+	TestEqual(TEXT("Exactly the expected pulses"), Subsystem->QuartzVisualEntries.Num(), NumExpected);
+	AddInfo(FString::Printf(TEXT("%d commands from %d threads in %d drains, %d pulses left"), NumProducers * CommandsPerProducer, NumProducers, NumDrains, NumExpected));
+	return true;
+}
+
+/**
+ * With nothing to update the subsystem drops out of the tick: not tickable without pulses, commands or stand-in clocks,
+ * tickable again as soon as one turns up. A forced tick with nothing to do allocates nothing. A quartz clock nothing
+ * follows is on bar events, back on its fine quantization while a pulse needs it. That part needs an audio device.
+ */
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FQuartzVisualSubsystemIdleTest, "QuartzVisuals.Subsystem.Idle", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+
+bool FQuartzVisualSubsystemIdleTest::RunTest(const FString& Parameters)
+{
+	using namespace QuartzVisualSubsystemTest;
+	QuartzVisualTests::FTestWorld TestWorld;
+	UQuartzVisualSubsystem* Subsystem = TestWorld.Subsystem;
+	AQuartzVisualTestListener* Listener = TestWorld.SpawnListeners(1)[0];
+	FQuartzVisualPulseSettings Settings = QuartzVisualTests::MakeSettings(0, 0, EQuartzVisualValueVariant::Linear);
+	Settings.ClockName = ClockName;
+
+	// Nothing to do, a forced tick may not even allocate.
+	Subsystem->ForceTick(FrameSeconds);
+	int64 NumAllocations = 0;
+	{
+		QuartzVisualTests::FScopedAllocationCounter Counter;
+		for(int32 Frame = 0; Frame < 60; Frame++)
+		{
+			Subsystem->ForceTick(FrameSeconds);
+		}
+		NumAllocations = Counter.GetNum();
+	}
+	TestEqual(TEXT("No allocations while idle"), NumAllocations, static_cast<int64>(0));
+	TestEqual(TEXT("No updates while idle"), Listener->NumUpdates, 0);
+
+	{
+		// The engine only asks IsTickable off forced ticks.
+		TGuardValue<bool> ForcedTick(Subsystem->UseForcedTick, false);
+		TestFalse(TEXT("Not tickable with nothing to update"), Subsystem->IsTickable());
+
+		Subsystem->AddNewQuartzVisualPulse(Listener, Settings, 4, 0);
+		TestTrue(TEXT("Tickable with a pulse"), Subsystem->IsTickable());
+		Subsystem->RemoveAllQuartzVisualPulses();
+		TestFalse(TEXT("Not tickable once the pulses are gone"), Subsystem->IsTickable());
+
+		Subsystem->EnqueueQuartzVisualPulse(Listener, Settings, 4, 0);
+		TestTrue(TEXT("Tickable with a queued command"), Subsystem->IsTickable());
+		Subsystem->ProcessQuartzVisualCommands();
+		Subsystem->RemoveAllQuartzVisualPulses();
+		TestFalse(TEXT("Not tickable once the queue is drained"), Subsystem->IsTickable());
+
+		Subsystem->StartSimulatedQuartzVisualClock(ClockName, 120.0f, EQuartzCommandQuantization::ThirtySecondNote);
+		TestTrue(TEXT("Tickable with a stand-in clock"), Subsystem->IsTickable());
+		Subsystem->StopSimulatedQuartzVisualClock(ClockName);
+		TestFalse(TEXT("Not tickable once the stand-in clock stops"), Subsystem->IsTickable());
+	}
+
+	UQuartzSubsystem* Quartz = UQuartzSubsystem::Get(TestWorld.World);
+	UQuartzClockHandle* ClockHandle = Quartz ? Quartz->CreateNewClock(TestWorld.World, ClockName, FQuartzClockSettings(), true) : nullptr;
+	if(ClockHandle == nullptr)
+	{
+		// Without a device no clock hands out a subscription, so none can be left fine.
+		for(const FQuartzVisualClockState& Clock : Subsystem->Clocks)
+		{
+			TestTrue(TEXT("No clock subscribed"), Clock.ClockHandle == nullptr);
+		}
+		AddInfo(TEXT("No audio device, quartz clock subscriptions not checked"));
+		return true;
+	}
+
+	TGuardValue<int32> IdleBarEvents(GQuartzVisualsIdleBarEvents, 1);
+	Subsystem->SubscribeToQuantization(TestWorld.World, ClockHandle, EQuartzCommandQuantization::ThirtySecondNote);
+	const int32 ClockIndex = Subsystem->FindOrAddQuartzVisualClock(ClockName);
+	TestTrue(TEXT("Idle right after subscribing"), Subsystem->Clocks[ClockIndex].bIdle);
+	TestTrue(TEXT("Bar events while idle"), Subsystem->Clocks[ClockIndex].EventQuantization == EQuartzCommandQuantization::Bar);
+
+	Subsystem->AddNewQuartzVisualPulse(Listener, Settings, 4, 0);
+	TestFalse(TEXT("Awake with a pulse"), Subsystem->Clocks[ClockIndex].bIdle);
+	TestTrue(TEXT("Fine events with a pulse"), Subsystem->Clocks[ClockIndex].EventQuantization == EQuartzCommandQuantization::ThirtySecondNote);
+
+	// The next event after the last pulse is gone puts the clock back to sleep.
+	Subsystem->RemoveAllQuartzVisualPulses();
+	Subsystem->OnQuantizationEvent(ClockName, EQuartzCommandQuantization::ThirtySecondNote, 0, 1, 0.0f);
+	TestTrue(TEXT("Idle again without pulses"), Subsystem->Clocks[ClockIndex].bIdle);
+	TestTrue(TEXT("Back on bar events"), Subsystem->Clocks[ClockIndex].EventQuantization == EQuartzCommandQuantization::Bar);
+	for(const FQuartzVisualClockState& Clock : Subsystem->Clocks)
+	{
+		TestTrue(TEXT("No fine subscription left"), Clock.ClockHandle == nullptr || Clock.EventQuantization == EQuartzCommandQuantization::Bar);
+	}
+	Quartz->DeleteClockByName(TestWorld.World, ClockName);
+	return true;
+}
+
+#endif
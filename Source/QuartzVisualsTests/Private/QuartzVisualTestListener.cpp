@@ -0,0 +1,49 @@
+// Copyright Zuko Media 2023 all rights reserved.
+
+#include "QuartzVisualTestListener.h"
+
+static uint32 HashReceived(int32 Index, int32 IndexFilter, EQuartzVisualPulseState State, float OutValue)
+{
+	return HashCombine(HashCombine(GetTypeHash(Index), GetTypeHash(IndexFilter)), HashCombine(static_cast<uint32>(State), GetTypeHash(OutValue)));
+}
+
+void AQuartzVisualTestListener::OnQuartzVisualUpdate_Implementation(const FQuartzVisualPulseEntry& PulseData)
+{
+	switch(PulseData.State)
+	{
+	case EQuartzVisualPulseState::Start:
+		NumStarts++;
+		break;
+	case EQuartzVisualPulseState::Finished:
+		NumFinishes++;
+		break;
+	default:
+		NumUpdates++;
+		break;
+	}
+	LastValue = PulseData.OutValue;
+	ReceivedHash = HashCombine(ReceivedHash, HashReceived(PulseData.Settings.Index, PulseData.Settings.IndexFilter, PulseData.State, PulseData.OutValue));
+	if(OnUpdate)
+	{
+		OnUpdate(PulseData);
+	}
+}
+
+bool AQuartzVisualTestListener::WantsBatchedQuartzVisualUpdates_Implementation() const
+{
+	return bWantsBatchedUpdates;
+}
+
+void AQuartzVisualTestListener::OnQuartzVisualUpdateBatch_Implementation(const TArray<FQuartzVisualPulseUpdate>& PulseUpdates)
+{
+	NumBatches++;
+	NumBatchedUpdates += PulseUpdates.Num();
+	for(const FQuartzVisualPulseUpdate& Update : PulseUpdates)
+	{
+		ReceivedHash = HashCombine(ReceivedHash, HashReceived(Update.Index, Update.IndexFilter, Update.State, Update.OutValue));
+	}
+	if(PulseUpdates.Num() > 0)
+	{
+		LastValue = PulseUpdates.Last().OutValue;
+	}
+}
@@ -0,0 +1,39 @@
+// Copyright Zuko Media 2023 all rights reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/Actor.h"
+#include "QuartzVisualInterface.h"
+#include "QuartzVisualTestListener.generated.h"
+
+/* Native listener for the automation tests and benchmarks. Counts what it is sent and does nothing else. */
+UCLASS(Transient, NotBlueprintable, NotPlaceable)
+class AQuartzVisualTestListener : public AActor, public IQuartzVisualsInterface
+{
+	GENERATED_BODY()
+
+public:
+
+	virtual void OnQuartzVisualUpdate_Implementation(const FQuartzVisualPulseEntry& PulseData) override;
+	virtual bool WantsBatchedQuartzVisualUpdates_Implementation() const override;
+	virtual void OnQuartzVisualUpdateBatch_Implementation(const TArray<FQuartzVisualPulseUpdate>& PulseUpdates) override;
+
+	// Asked when the actor gets its first pulse, set before adding any.
+	bool bWantsBatchedUpdates = false;
+
+	int32 NumStarts = 0;
+	int32 NumUpdates = 0;
+	int32 NumFinishes = 0;
+	int32 NumBatches = 0;
+	int32 NumBatchedUpdates = 0;
+
+	// Value of the last update, single or batched.
+	float LastValue = 0.0f;
+
+	// Everything it was sent hashed in order, so two runs can be compared without keeping it all.
+	uint32 ReceivedHash = 0;
+
+	// Called after each single update is counted, so tests can add or remove pulses from inside it.
+	TFunction<void(const FQuartzVisualPulseEntry& PulseData)> OnUpdate;
+};
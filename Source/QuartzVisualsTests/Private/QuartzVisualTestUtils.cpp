@@ -0,0 +1,221 @@
+// Copyright Zuko Media 2023 all rights reserved.
+
+#include "QuartzVisualTestUtils.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+#include "QuartzVisualSubsystem.h"
+#include "QuartzVisualTestListener.h"
+#include "Curves/CurveFloat.h"
+#include "Engine/Engine.h"
+#include "Engine/World.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include <atomic>
+
+namespace QuartzVisualTests
+{
+	FTestWorld::FTestWorld()
+	{
+		World = UWorld::CreateWorld(EWorldType::Game, false, TEXT("QuartzVisualsTestWorld"));
+		FWorldContext& WorldContext = GEngine->CreateNewWorldContext(EWorldType::Game);
+		WorldContext.SetCurrentWorld(World);
+		World->InitializeActorsForPlay(FURL());
+		World->BeginPlay();
+
+		Subsystem = World->GetSubsystem<UQuartzVisualSubsystem>();
+		check(Subsystem);
+		// Not through InitializeQuartzVisualSubsystem, which picks the first game world it finds.
+		Subsystem->OwningWorld = World;
+		Subsystem->IsInitialized = true;
+		Subsystem->UseForcedTick = true;
+	}
+
+	FTestWorld::~FTestWorld()
+	{
+		GEngine->DestroyWorldContext(World);
+		World->DestroyWorld(false);
+	}
+
+	TArray<AQuartzVisualTestListener*> FTestWorld::SpawnListeners(int32 Num, bool bWantsBatchedUpdates)
+	{
+		TArray<AQuartzVisualTestListener*> Listeners;
+		Listeners.Reserve(Num);
+		for(int32 ListenerIndex = 0; ListenerIndex < Num; ListenerIndex++)
+		{
+			AQuartzVisualTestListener* Listener = World->SpawnActor<AQuartzVisualTestListener>();
+			Listener->bWantsBatchedUpdates = bWantsBatchedUpdates;
+			Listeners.Add(Listener);
+		}
+		return Listeners;
+	}
+
+	FQuartzVisualPulseSettings MakeSettings(int32 Index, int32 IndexFilter, EQuartzVisualValueVariant Variant, UCurveFloat* Curve)
+	{
+		FQuartzVisualPulseSettings Settings;
+		Settings.Index = Index;
+		Settings.IndexFilter = IndexFilter;
+		Settings.UseValue = Variant != EQuartzVisualValueVariant::None;
+		Settings.ValueCurve = Variant == EQuartzVisualValueVariant::Curve || Variant == EQuartzVisualValueVariant::CurveRemap ? Curve : nullptr;
+		if(Variant == EQuartzVisualValueVariant::Remap || Variant == EQuartzVisualValueVariant::CurveRemap)
+		{
+			Settings.OutValueMinMax = FVector2D(-2.0f, 3.0f);
+		}
+		check(Settings.GetValueVariant() == Variant);
+		return Settings;
+	}
+
+	UCurveFloat* MakeCurve()
+	{
+		UCurveFloat* Curve = NewObject<UCurveFloat>(GetTransientPackage());
+		const FKeyHandle Keys[] = {
+			Curve->FloatCurve.AddKey(0.0f, 0.0f),
+			Curve->FloatCurve.AddKey(0.3f, 1.2f),
+			Curve->FloatCurve.AddKey(0.6f, 0.4f),
+			Curve->FloatCurve.AddKey(1.0f, 1.0f)
+		};
+		for(const FKeyHandle& Key : Keys)
+		{
+			Curve->FloatCurve.SetKeyInterpMode(Key, RCIM_Cubic);
+		}
+		Curve->FloatCurve.AutoSetTangents();
+		return Curve;
+	}
+
+	double MicrosecondsSince(uint64 Cycles)
+	{
+		return FPlatformTime::ToSeconds64(FPlatformTime::Cycles64() - Cycles) * 1000000.0;
+	}
+
+	/*
+	 * Forwards everything to the allocator it was put in front of and counts the allocations of the thread it is told to.
+	 * Installed once and never removed, blocks from before it are freed by the same allocator underneath.
+	 */
+	class FCountingMalloc final : public FMalloc
+	{
+	public:
+
+		explicit FCountingMalloc(FMalloc* InInner)
+			: Inner(InInner)
+		{
+		}
+
+		virtual void* Malloc(SIZE_T Count, uint32 Alignment) override
+		{
+			CountOnCountingThread();
+			return Inner->Malloc(Count, Alignment);
+		}
+
+		virtual void* Realloc(void* Original, SIZE_T Count, uint32 Alignment) override
+		{
+			// Shrinking to nothing is a free.
+			if(Count > 0)
+			{
+				CountOnCountingThread();
+			}
+			return Inner->Realloc(Original, Count, Alignment);
+		}
+
+		virtual void Free(void* Original) override
+		{
+			Inner->Free(Original);
+		}
+
+		virtual SIZE_T QuantizeSize(SIZE_T Count, uint32 Alignment) override
+		{
+			return Inner->QuantizeSize(Count, Alignment);
+		}
+
+		virtual bool GetAllocationSize(void* Original, SIZE_T& SizeOut) override
+		{
+			return Inner->GetAllocationSize(Original, SizeOut);
+		}
+
+		virtual void Trim(bool bTrimThreadCaches) override
+		{
+			Inner->Trim(bTrimThreadCaches);
+		}
+
+		virtual bool IsInternallyThreadSafe() const override
+		{
+			return Inner->IsInternallyThreadSafe();
+		}
+
+		virtual const TCHAR* GetDescriptiveName() override
+		{
+			return Inner->GetDescriptiveName();
+		}
+
+		void StartCounting(uint32 ThreadId)
+		{
+			NumAllocations.store(0, std::memory_order_relaxed);
+			CountingThreadId.store(ThreadId, std::memory_order_release);
+		}
+
+		void StopCounting()
+		{
+			CountingThreadId.store(0, std::memory_order_release);
+		}
+
+		int64 GetNum() const
+		{
+			return NumAllocations.load(std::memory_order_relaxed);
+		}
+
+	private:
+
+		void CountOnCountingThread()
+		{
+			const uint32 ThreadId = CountingThreadId.load(std::memory_order_acquire);
+			if(ThreadId != 0 && ThreadId == FPlatformTLS::GetCurrentThreadId())
+			{
+				NumAllocations.fetch_add(1, std::memory_order_relaxed);
+			}
+		}
+
+		FMalloc* Inner = nullptr;
+		std::atomic<uint32> CountingThreadId { 0 };
+		std::atomic<int64> NumAllocations { 0 };
+	};
+
+	// Put in front of GMalloc on first use and kept for the rest of the process, so GMalloc only ever changes once.
+	static FCountingMalloc& GetCountingMalloc()
+	{
+		static FCountingMalloc* CountingMalloc = []()
+		{
+			FCountingMalloc* NewCountingMalloc = new FCountingMalloc(GMalloc);
+			GMalloc = NewCountingMalloc;
+			return NewCountingMalloc;
+		}();
+		return *CountingMalloc;
+	}
+
+	FScopedAllocationCounter::FScopedAllocationCounter()
+	{
+		check(IsInGameThread());
+		GetCountingMalloc().StartCounting(FPlatformTLS::GetCurrentThreadId());
+	}
+
+	FScopedAllocationCounter::~FScopedAllocationCounter()
+	{
+		GetCountingMalloc().StopCounting();
+	}
+
+	int64 FScopedAllocationCounter::GetNum() const
+	{
+		return GetCountingMalloc().GetNum();
+	}
+
+	FString WriteCsv(const FString& Name, const FString& Header, const TArray<FString>& Rows)
+	{
+		const FString FilePath = FPaths::Combine(FPaths::ProfilingDir(), TEXT("QuartzVisuals"), TEXT("Benchmarks"), Name + TEXT(".csv"));
+		FString Contents = Header + LINE_TERMINATOR;
+		for(const FString& Row : Rows)
+		{
+			Contents += Row + LINE_TERMINATOR;
+		}
+		return FFileHelper::SaveStringToFile(Contents, *FilePath) ? FilePath : FString();
+	}
+}
+
+#endif
@@ -0,0 +1,60 @@
+// Copyright Zuko Media 2023 all rights reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+#include "QuartzVisualSharedTypes.h"
+
+class UWorld;
+class UCurveFloat;
+class UQuartzVisualSubsystem;
+class AQuartzVisualTestListener;
+
+namespace QuartzVisualTests
+{
+	/**
+	 * A game world of its own with the subsystem initialized and on forced ticks, so nothing runs unless the test ticks it.
+	 * Needs no audio or RHI, runs under -nullrhi. The world is destroyed with the scope.
+	 */
+	struct FTestWorld
+	{
+		FTestWorld();
+		~FTestWorld();
+
+		UWorld* World = nullptr;
+		UQuartzVisualSubsystem* Subsystem = nullptr;
+
+		TArray<AQuartzVisualTestListener*> SpawnListeners(int32 Num, bool bWantsBatchedUpdates = false);
+	};
+
+	// Settings that give the variant, the curve is only used by the curve variants.
+	FQuartzVisualPulseSettings MakeSettings(int32 Index, int32 IndexFilter, EQuartzVisualValueVariant Variant, UCurveFloat* Curve = nullptr);
+
+	// An ease in and out with an overshoot, so baked tables have something to get wrong.
+	UCurveFloat* MakeCurve();
+
+	// Microseconds since Cycles.
+	double MicrosecondsSince(uint64 Cycles);
+
+	/**
+	 * Counts the game thread's allocations while in scope. A single counting allocator is put in front of GMalloc the first
+	 * time one is used and stays for the rest of the process, scopes only switch its counting on and off. Don't nest them.
+	 */
+	class FScopedAllocationCounter
+	{
+	public:
+
+		FScopedAllocationCounter();
+		~FScopedAllocationCounter();
+
+		int64 GetNum() const;
+	};
+
+	// Writes the rows under Saved/Profiling/QuartzVisuals/Benchmarks and returns the path, empty if it couldn't be written.
+	FString WriteCsv(const FString& Name, const FString& Header, const TArray<FString>& Rows);
+}
+
+#endif
@@ -0,0 +1,5 @@
+// Copyright Zuko Media 2023 all rights reserved.
+
+#include "Modules/ModuleManager.h"
+
+IMPLEMENT_MODULE(FDefaultModuleImpl, QuartzVisualsTests)
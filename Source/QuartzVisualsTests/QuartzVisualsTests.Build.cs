@@ -0,0 +1,23 @@
+// Copyright Zuko Media 2023 all rights reserved.
+
+using UnrealBuildTool;
+
+// Automation tests, benchmarks and the actors they use. A developer tool module so none of it is packaged in shipping builds.
+public class QuartzVisualsTests : ModuleRules
+{
+	public QuartzVisualsTests(ReadOnlyTargetRules Target) : base(Target)
+	{
+		PCHUsage = ModuleRules.PCHUsageMode.UseExplicitOrSharedPCHs;
+
+		PrivateDependencyModuleNames.AddRange(
+			new string[]
+			{
+				"Core",
+				"CoreUObject",
+				"Engine",
+				"AudioMixer",
+				"QuartzVisuals"
+			}
+			);
+	}
+}